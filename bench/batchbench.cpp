@@ -0,0 +1,122 @@
+// Wall time and calls to move a list of windows to the scratch desktop, one
+// MoveToScratch per window against one MoveWindowsToDesktop for the list, with
+// a per-call delay on the simulated shell. A quarter of the list is already on
+// the scratch desktop, which the batch drops without a call.
+
+#include "desktopcache.h"
+#include "groups.h"
+#include "simshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	enum class Path
+	{
+		PerWindowLegacy,  // what every bulk command did originally
+		PerWindow,        // MoveToScratch with the caches on
+		Batch,
+	};
+
+	struct Result
+	{
+		double ms;
+		size_t calls;
+		size_t moved;
+	};
+
+	Result Run(UINT windows, std::chrono::microseconds latency, Path path)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = windows;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsOptions opts;
+		if (path == Path::PerWindowLegacy)
+		{
+			opts.desktopCache = false;
+			opts.snapshot = false;
+			opts.desktopRegistry = false;
+			opts.viewCache = false;
+		}
+
+		GroupsInit(&shell, &list, nullptr, nullptr, opts);
+
+		std::vector<HWND> wins;
+		for (size_t i = 0; i < shell.WindowCount(); i++)
+			wins.push_back(shell.WindowAt(i));
+
+		for (size_t i = 0; i < wins.size(); i += 4)
+			shell.MoveWindowTo(wins[i], 1);
+		shell.PumpNotifications();
+
+		// a long running instance has seen every window already, only the
+		// moves are measured
+		GUID at{};
+		for (const auto& hwnd : wins)
+			GroupsDesktopCache().GetWindowDesktopId(hwnd, &at);
+
+		std::vector<MoveOutcome> results;
+		MoveWindowsToDesktop({}, shell.DesktopId(1), results);
+
+		shell.SetCallLatency(latency);
+		shell.ResetCalls();
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (path == Path::Batch)
+		{
+			MoveWindowsToDesktop(wins, shell.DesktopId(1), results);
+		}
+		else
+		{
+			for (const auto& hwnd : wins)
+				MoveToScratch(hwnd);
+		}
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+		Result r{ elapsed.count(), shell.TotalCalls(), shell.CallCount(SimCall::MoveViewToDesktop) };
+
+		for (const auto& hwnd : wins)
+		{
+			if (shell.WindowDesktop(hwnd) != 1)
+			{
+				std::fprintf(stderr, "window left behind\n");
+				std::exit(1);
+			}
+		}
+
+		GroupsShutdown();
+		return r;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto latency = std::chrono::microseconds(argc > 1 ? std::atoi(argv[1]) : 100);
+
+	const UINT counts[] = { 10, 100, 1000 };
+
+	std::printf("per-call latency %lld us\n\n", (long long)latency.count());
+	std::printf("%8s | %22s | %22s | %22s | %8s\n",
+		"windows", "per-window legacy", "per-window", "batch", "speedup");
+	std::printf("%8s | %10s %11s | %10s %11s | %10s %11s | %8s\n",
+		"", "ms", "calls", "ms", "calls", "ms", "calls", "");
+
+	for (auto count : counts)
+	{
+		auto a = Run(count, latency, Path::PerWindowLegacy);
+		auto b = Run(count, latency, Path::PerWindow);
+		auto c = Run(count, latency, Path::Batch);
+
+		std::printf("%8u | %10.1f %11zu | %10.1f %11zu | %10.1f %11zu | %7.1fx\n",
+			count, a.ms, a.calls, b.ms, b.calls, c.ms, c.calls, a.ms / c.ms);
+	}
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+// One group switch with the groups not shown parked on the scratch desktop,
+// against a desktop per group. Parking moves the windows of both groups; with
+// a desktop per group a switch is one SwitchDesktop however many windows the
+// group has, a window it shares with the group it leaves being the only thing
+// moved. Either way the new top's windows have to be what is on screen, and
+// undoing the switch has to bring the old top back.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+	constexpr UINT Groups = 4;
+
+	struct Result
+	{
+		size_t moves = 0;
+		size_t switches = 0;
+		size_t created = 0;
+		size_t calls = 0;
+		double ms = 0;
+		bool placed = true;  // the top group's windows, and only those, on screen
+		bool undone = true;
+	};
+
+	// On screen is exactly the top group
+	bool Placed(const SimShell& shell, const VectorGroupList& list)
+	{
+		auto members = GroupMembers(list.mItems.empty() ? NoGroup : list.mItems[0]);
+		if (!members)
+			return false;
+
+		for (size_t i = 0; i < shell.WindowCount(); i++)
+		{
+			HWND hwnd = shell.WindowAt(i);
+			bool member = std::find(members->begin(), members->end(), hwnd) != members->end();
+			if ((shell.WindowDesktop(hwnd) == (int)shell.CurrentDesktop()) != member)
+				return false;
+		}
+		return true;
+	}
+
+	// shared drags a window of the next group onto the screen first, so the
+	// group shown now holds it too
+	Result Run(bool desktopPerGroup, UINT perGroup, bool shared, std::chrono::microseconds latency)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsOptions opts;
+		opts.desktopPerGroup = desktopPerGroup;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+
+		// with a desktop per group a new group is shown on a new desktop
+		NewGroup();
+		for (UINT g = 1; g < Groups; g++)
+		{
+			NewGroup();
+			if (!desktopPerGroup)
+				MoveAllToOther();
+			for (UINT i = 0; i < perGroup; i++)
+				shell.AddWindow(shell.CurrentDesktop());
+		}
+		MoveGroup(1);
+
+		if (shared && list.mItems.size() > 1)
+		{
+			auto next = GroupMembers(list.mItems[1]);
+			if (next && !next->empty())
+				shell.MoveWindowTo(next->front(), shell.CurrentDesktop());
+			shell.PumpNotifications();
+		}
+
+		auto stack = list.mItems;
+		UINT desktop = shell.CurrentDesktop();
+
+		shell.PumpNotifications();
+		shell.ResetCalls();
+		shell.SetCallLatency(latency);
+
+		Result r;
+		auto start = std::chrono::steady_clock::now();
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		shell.SetCallLatency(std::chrono::microseconds(0));
+		shell.PumpNotifications();
+		r.moves = shell.CallCount(SimCall::MoveViewToDesktop);
+		r.switches = shell.CallCount(SimCall::SwitchDesktop);
+		r.created = shell.CallCount(SimCall::CreateDesktop);
+		r.calls = shell.TotalCalls();
+		r.placed = Placed(shell, list);
+
+		UndoCommand();
+		shell.PumpNotifications();
+		r.undone = list.mItems == stack && (!desktopPerGroup || shell.CurrentDesktop() == desktop);
+
+		GroupsShutdown();
+		return r;
+	}
+}
+
+int main()
+{
+	const auto latency = std::chrono::microseconds(50);
+
+	std::printf("one group switch, %u groups, %lld us a call\n\n", Groups, (long long)latency.count());
+	std::printf("%6s %9s %6s | %6s %8s %7s %7s %9s\n", "n", "mode", "shared", "moves", "switches", "created", "calls", "ms");
+
+	int failures = 0;
+	for (UINT perGroup : { 10u, 100u, 1000u })
+	{
+		for (bool desktopPerGroup : { false, true })
+		{
+			for (bool shared : { false, true })
+			{
+				auto r = Run(desktopPerGroup, perGroup, shared, latency);
+
+				std::printf("%6u %9s %6s | %6zu %8zu %7zu %7zu %9.3f\n", perGroup, desktopPerGroup ? "desktops" : "parking",
+					shared ? "yes" : "no", r.moves, r.switches, r.created, r.calls, r.ms);
+
+				// a desktop per group moves nothing but the shared window and
+				// makes no desktop for a group it has shown before
+				bool ok = r.placed && r.undone;
+				if (desktopPerGroup)
+					ok = ok && r.moves == (shared ? 1u : 0u) && r.switches == 1 && r.created == 0;
+				if (!ok)
+				{
+					std::fprintf(stderr, "  %s, %u windows a group%s: switch or undo wrong\n",
+						desktopPerGroup ? "desktops" : "parking", perGroup, shared ? ", shared" : "");
+					++failures;
+				}
+			}
+		}
+	}
+
+	return failures ? 1 : 0;
+}
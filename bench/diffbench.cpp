@@ -0,0 +1,351 @@
+// Time per DiffGroups call for each method as the groups grow, to place the
+// size cutoffs in PickDiffMethod, and for groups kept as sets over a window
+// index the way the group commands keep them. Every method is checked against
+// Scan first, the sets in the slot order they give. Then the set algebra behind the combine commands, checked
+// against std::set_* on the same windows.
+//
+// Before any of that, fixed cases every method has to get right: empty
+// sides, the same or no windows on both, a window listed twice on screen, and
+// sizes either side of the Scan cutoff and of the two handles Merge compares
+// a step. The sets take the cases a group can be, no window listed twice.
+
+#include "groupdiff.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_set>
+
+namespace {
+	// Handles look like real ones, small even numbers scattered over a range
+	std::vector<HWND> MakeHandles(size_t count, std::mt19937_64& rng)
+	{
+		std::unordered_set<std::uintptr_t> seen;
+		std::vector<HWND> wins;
+		std::uniform_int_distribution<std::uintptr_t> dist(0x10000, 0x4000000);
+		while (wins.size() < count)
+		{
+			auto value = dist(rng) & ~std::uintptr_t(1);
+			if (seen.insert(value).second)
+				wins.push_back(reinterpret_cast<HWND>(value));
+		}
+		return wins;
+	}
+
+	// current and target of n windows each, sharing shared of them
+	void MakeGroups(size_t n, size_t shared, std::mt19937_64& rng, std::vector<HWND>& current, std::vector<HWND>& target)
+	{
+		auto pool = MakeHandles(n * 2 - shared, rng);
+		current.assign(pool.begin(), pool.begin() + n);
+		target.assign(pool.begin() + (n - shared), pool.end());
+		std::ranges::shuffle(target, rng);
+	}
+
+	bool Same(const GroupDiff& a, const GroupDiff& b)
+	{
+		return a.toHide == b.toHide && a.toShow == b.toShow && a.unchanged == b.unchanged;
+	}
+
+	double NsPerDiff(const std::vector<HWND>& current, const std::vector<HWND>& target, DiffMethod method)
+	{
+		GroupDiff diff;
+		size_t reps = std::max<size_t>(20, 2000000 / (current.size() + target.size()) / std::max<size_t>(1, std::min<size_t>(current.size(), 64)));
+
+		auto start = std::chrono::steady_clock::now();
+		size_t sink = 0;
+		for (size_t r = 0; r < reps; r++)
+		{
+			DiffGroups(current, target, diff, method);
+			sink += diff.toShow.size();
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+		if (sink == SIZE_MAX) std::printf(" ");
+		return elapsed.count() / reps;
+	}
+
+	// The diff with every list in slot order, the order the set diff gives
+	GroupDiff InSlotOrder(GroupDiff diff, const WindowIndex& index)
+	{
+		auto bySlot = [&index](HWND a, HWND b) { return index.Find(a) < index.Find(b); };
+		for (auto* list : { &diff.toHide, &diff.toShow, &diff.unchanged })
+			std::ranges::sort(*list, bySlot);
+		return diff;
+	}
+
+	double NsPerSetDiff(const WindowGroup& current, const WindowGroup& target, const WindowIndex& index)
+	{
+		GroupDiff diff;
+		size_t reps = std::max<size_t>(20, 2000000 / (current.windows.size() + target.windows.size()));
+
+		auto start = std::chrono::steady_clock::now();
+		size_t sink = 0;
+		for (size_t r = 0; r < reps; r++)
+		{
+			DiffGroups(current, target, index, diff);
+			sink += diff.toShow.size();
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+		if (sink == SIZE_MAX) std::printf(" ");
+		return elapsed.count() / reps;
+	}
+
+	// What the set algebra should give, in the order CombineWindowGroups keeps
+	std::vector<HWND> Expected(SetOp op, const std::vector<HWND>& a, const std::vector<HWND>& b)
+	{
+		std::unordered_set<HWND> inA(a.begin(), a.end());
+		std::unordered_set<HWND> inB(b.begin(), b.end());
+		std::vector<HWND> out;
+		for (auto hWin : a)
+		{
+			bool keep = op == SetOp::Intersect ? inB.count(hWin) != 0 : op == SetOp::Difference ? inB.count(hWin) == 0 : true;
+			if (keep)
+				out.push_back(hWin);
+		}
+		if (op == SetOp::Union)
+		{
+			for (auto hWin : b)
+			{
+				if (!inA.count(hWin))
+					out.push_back(hWin);
+			}
+		}
+		return out;
+	}
+
+	const char* Name(DiffMethod method)
+	{
+		switch (method)
+		{
+		case DiffMethod::Scan: return "scan";
+		case DiffMethod::Merge: return "merge";
+		case DiffMethod::Hash: return "hash";
+		default: return "auto";
+		}
+	}
+
+	// The diff worked out by looking every window up in the other side
+	GroupDiff Reference(const std::vector<HWND>& current, const std::vector<HWND>& target)
+	{
+		std::unordered_set<HWND> inCurrent(current.begin(), current.end());
+		std::unordered_set<HWND> inTarget(target.begin(), target.end());
+
+		GroupDiff diff;
+		for (auto hWin : current)
+			(inTarget.count(hWin) ? diff.unchanged : diff.toHide).push_back(hWin);
+		for (auto hWin : target)
+		{
+			if (!inCurrent.count(hWin))
+				diff.toShow.push_back(hWin);
+		}
+		return diff;
+	}
+
+	std::vector<HWND> Handles(std::initializer_list<std::uintptr_t> values)
+	{
+		std::vector<HWND> wins;
+		for (auto value : values)
+			wins.push_back(reinterpret_cast<HWND>(value));
+		return wins;
+	}
+
+	int CheckCases()
+	{
+		int failures = 0;
+		auto check = [&failures](const char* what, const std::vector<HWND>& current, const std::vector<HWND>& target) {
+			GroupDiff expected = Reference(current, target);
+			for (auto method : { DiffMethod::Scan, DiffMethod::Merge, DiffMethod::Hash, DiffMethod::Auto })
+			{
+				GroupDiff got;
+				DiffGroups(current, target, got, method);
+				if (!Same(expected, got))
+				{
+					std::fprintf(stderr, "  %s: %s, %zu/%zu windows\n", Name(method), what, current.size(), target.size());
+					++failures;
+				}
+			}
+
+			if (std::unordered_set<HWND>(current.begin(), current.end()).size() != current.size())
+				return;
+
+			WindowIndex index;
+			WindowGroup currentSet, targetSet;
+			currentSet.Assign(current, index);
+			targetSet.Assign(target, index);
+
+			GroupDiff got;
+			DiffGroups(currentSet, targetSet, index, got);
+			if (!Same(InSlotOrder(expected, index), got))
+			{
+				std::fprintf(stderr, "  sets: %s, %zu/%zu windows\n", what, current.size(), target.size());
+				++failures;
+			}
+		};
+
+		std::vector<HWND> none;
+		auto some = Handles({ 0x30, 0x10, 0x20 });
+		check("both empty", none, none);
+		check("nothing on screen", none, some);
+		check("empty group", some, none);
+		check("same windows", some, some);
+		check("same windows, other order", some, Handles({ 0x20, 0x30, 0x10 }));
+		check("no window shared", some, Handles({ 0x40, 0x50 }));
+
+		// twice on screen, next to and away from its other copy once sorted
+		check("listed twice", Handles({ 0x10, 0x10 }), Handles({ 0x10 }));
+		check("listed twice, apart", Handles({ 0x20, 0x40, 0x10, 0x20 }), Handles({ 0x30, 0x20 }));
+		check("listed twice, across blocks", Handles({ 0x08, 0x20, 0x20, 0x50 }), Handles({ 0x18, 0x20, 0x40 }));
+		check("listed twice, not in the group", Handles({ 0x60, 0x10, 0x60 }), Handles({ 0x10 }));
+
+		// odd and even counts around the two handles a step, and long sides
+		// around the cutoff where Auto goes from Scan to Hash
+		std::mt19937_64 rng(99);
+		for (size_t n : { 1, 2, 3, 4, 5 })
+		{
+			for (size_t m : { 1, 2, 3, 4, 5 })
+			{
+				auto pool = MakeHandles(n + m, rng);
+				std::vector<HWND> current(pool.begin(), pool.begin() + n);
+				std::vector<HWND> target(pool.begin() + n - std::min(n, m) / 2, pool.end());
+				check("small", current, target);
+			}
+		}
+		for (size_t n : { 11, 12 })
+		{
+			std::vector<HWND> current, target;
+			MakeGroups(n, n / 2, rng, current, target);
+			check("at the cutoff", current, target);
+			target.pop_back();
+			check("at the cutoff, one less", current, target);
+		}
+
+		if (PickDiffMethod(8, 16) != DiffMethod::Scan || PickDiffMethod(8, 17) != DiffMethod::Hash || PickDiffMethod(0, 0) != DiffMethod::Scan)
+		{
+			std::fprintf(stderr, "  cutoff not at 128 pairs\n");
+			++failures;
+		}
+
+		return failures;
+	}
+}
+
+int main()
+{
+	if (int failures = CheckCases())
+	{
+		std::fprintf(stderr, "%d fixed cases failed\n", failures);
+		return 1;
+	}
+
+	std::mt19937_64 rng(1234);
+
+	const size_t sizes[] = { 2, 4, 8, 16, 32, 48, 64, 96, 128, 256, 512, 1024, 4096 };
+	const DiffMethod methods[] = { DiffMethod::Scan, DiffMethod::Merge, DiffMethod::Hash, DiffMethod::Auto };
+
+	std::printf("merge compares with SSE2: %s\n", DiffMergeUsesSimd() ? "yes" : "no");
+	std::printf("ns per diff, both groups n windows, a quarter shared\n\n");
+	std::printf("%6s | %10s %10s %10s %10s %10s | %6s\n", "n", "scan", "merge", "hash", "auto", "sets", "picks");
+
+	for (auto n : sizes)
+	{
+		std::vector<HWND> current, target;
+		MakeGroups(n, n / 4, rng, current, target);
+
+		WindowIndex index;
+		WindowGroup currentSet, targetSet;
+		currentSet.Assign(current, index);
+		targetSet.Assign(target, index);
+
+		GroupDiff expected, got;
+		DiffGroups(current, target, expected, DiffMethod::Scan);
+		for (auto method : methods)
+		{
+			DiffGroups(current, target, got, method);
+			if (!Same(expected, got))
+			{
+				std::fprintf(stderr, "%s disagrees with scan at n=%zu\n", Name(method), n);
+				return 1;
+			}
+		}
+
+		DiffGroups(currentSet, targetSet, index, got);
+		if (!Same(InSlotOrder(expected, index), got))
+		{
+			std::fprintf(stderr, "sets disagree with scan at n=%zu\n", n);
+			return 1;
+		}
+
+		std::printf("%6zu |", n);
+		for (auto method : methods)
+		{
+			if (method == DiffMethod::Scan && n > 1024)
+				std::printf(" %10s", "-");
+			else
+				std::printf(" %10.0f", NsPerDiff(current, target, method));
+		}
+		std::printf(" %10.0f", NsPerSetDiff(currentSet, targetSet, index));
+		std::printf(" | %6s\n", Name(PickDiffMethod(n, n)));
+	}
+
+	// Lopsided, a big desktop going to a small group and back
+	std::printf("\ncurrent 512, target 4 and the reverse\n");
+	for (int flip = 0; flip < 2; flip++)
+	{
+		std::vector<HWND> current, target;
+		MakeGroups(512, 2, rng, current, target);
+		target.resize(4);
+		if (flip) std::swap(current, target);
+
+		WindowIndex index;
+		WindowGroup currentSet, targetSet;
+		currentSet.Assign(current, index);
+		targetSet.Assign(target, index);
+
+		std::printf("%6s |", flip ? "4/512" : "512/4");
+		for (auto method : methods)
+			std::printf(" %10.0f", NsPerDiff(current, target, method));
+		std::printf(" %10.0f", NsPerSetDiff(currentSet, targetSet, index));
+		std::printf(" | %6s\n", Name(PickDiffMethod(current.size(), target.size())));
+	}
+
+	// The combine commands, two groups of n sharing a quarter
+	std::printf("\nns per combine, both groups n windows, a quarter shared\n\n");
+	std::printf("%6s | %10s %10s %10s\n", "n", "union", "intersect", "difference");
+
+	const SetOp ops[] = { SetOp::Union, SetOp::Intersect, SetOp::Difference };
+	for (size_t n : { 16, 256, 4096 })
+	{
+		std::vector<HWND> a, b;
+		MakeGroups(n, n / 4, rng, a, b);
+
+		WindowIndex index;
+		WindowGroup setA, setB, out;
+		setA.Assign(a, index);
+		setB.Assign(b, index);
+
+		std::printf("%6zu |", n);
+		for (auto op : ops)
+		{
+			CombineWindowGroups(op, setA, setB, out);
+			if (out.windows != Expected(op, a, b) || out.set.Count() != out.windows.size())
+			{
+				std::fprintf(stderr, "combine %d is wrong at n=%zu\n", (int)op, n);
+				return 1;
+			}
+
+			size_t reps = std::max<size_t>(20, 4000000 / n);
+			auto start = std::chrono::steady_clock::now();
+			for (size_t r = 0; r < reps; r++)
+				CombineWindowGroups(op, setA, setB, out);
+			auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+			std::printf(" %10.0f", elapsed.count() / reps);
+		}
+		std::printf("\n");
+	}
+
+	return 0;
+}
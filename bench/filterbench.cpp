@@ -0,0 +1,273 @@
+// Group switches on the path that asks explorer window by window, among as
+// many windows no switcher shows as a desktop session has: invisible ones
+// above all, then tool, owned, cloaked, zero size and shell windows. Without
+// the window filter every one of them costs an IsWindowOnCurrentVirtualDesktop
+// call per enumeration and ends up in the groups; with it they are ruled out
+// in process and explorer is only asked about the application windows. Both
+// have to leave the same application windows on screen.
+//
+// Also: each stage counts what it took out, another desktop's windows, cloaked
+// by the shell, and tool windows marked WS_EX_APPWINDOW get through, child
+// windows don't even so, and the counts are in the trace.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+#include "trace.h"
+#include "windowfilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+namespace {
+	constexpr int Switches = 10;
+
+	// Of every noise windows, the rest are invisible
+	constexpr UINT Tools = 12;
+	constexpr UINT Owned = 8;
+	constexpr UINT Cloaked = 4;
+	constexpr UINT Empty = 4;
+	constexpr UINT Shell = 2;
+
+	WindowBasics Shown()
+	{
+		WindowBasics basics;
+		basics.visible = true;
+		basics.width = 640;
+		basics.height = 480;
+		return basics;
+	}
+
+	// Windows explorer has no view for, next to owner
+	std::vector<HWND> Plant(SimShell& shell, UINT noise, HWND owner)
+	{
+		std::vector<HWND> planted;
+		auto add = [&](UINT count, auto&& shape) {
+			for (UINT i = 0; i < count; i++)
+			{
+				HWND hwnd = shell.AddHiddenWindow();
+				shape(hwnd);
+				planted.push_back(hwnd);
+			}
+		};
+
+		add(Tools, [&](HWND hwnd) {
+			auto basics = Shown();
+			basics.exStyle = WS_EX_TOOLWINDOW;
+			shell.SetWindowBasics(hwnd, basics);
+		});
+		add(Owned, [&](HWND hwnd) {
+			auto basics = Shown();
+			basics.owner = owner;
+			shell.SetWindowBasics(hwnd, basics);
+		});
+		add(Cloaked, [&](HWND hwnd) {
+			auto basics = Shown();
+			basics.cloaked = DWM_CLOAKED_APP;
+			shell.SetWindowBasics(hwnd, basics);
+		});
+		add(Empty, [&](HWND hwnd) {
+			auto basics = Shown();
+			basics.width = 0;
+			shell.SetWindowBasics(hwnd, basics);
+		});
+		add(Shell, [&](HWND hwnd) {
+			shell.SetWindowBasics(hwnd, Shown());
+			WindowTraits traits;
+			traits.className = L"WorkerW";
+			shell.SetWindowTraits(hwnd, traits);
+		});
+		add(noise - Tools - Owned - Cloaked - Empty - Shell, [](HWND) {});
+		return planted;
+	}
+
+	struct Result
+	{
+		size_t queries = 0;  // IsWindowOnCurrentVirtualDesktop a switch
+		size_t calls = 0;    // into explorer a switch, GetWindowBasics isn't one
+		size_t basics = 0;
+		double ms = 0;
+		bool placed = true;
+		bool clean = true;   // no group holds a planted window
+		WindowFilter::Stats stats;
+	};
+
+	Result Run(UINT perGroup, UINT noise, bool filter, std::chrono::microseconds latency)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		auto planted = Plant(shell, noise, shell.WindowAt(0));
+		VectorGroupList list;
+
+		// the per window path, every query goes to the shell
+		GroupsOptions opts;
+		opts.snapshot = false;
+		opts.desktopCache = false;
+		opts.filterWindows = filter;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+
+		NewGroup();
+		NewGroup();
+		MoveAllToOther();
+		for (UINT i = 0; i < perGroup; i++)
+			shell.AddWindow(shell.CurrentDesktop());
+		MoveGroup(1);
+
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		shell.ResetCalls();
+		GroupsWindowFilter().ResetStats();
+		shell.SetCallLatency(latency);
+
+		Result r;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Switches; i++)
+			RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / Switches;
+
+		shell.SetCallLatency(std::chrono::microseconds(0));
+		r.queries = shell.CallCount(SimCall::IsWindowOnCurrentVirtualDesktop) / Switches;
+		r.basics = shell.CallCount(SimCall::GetWindowBasics) / Switches;
+		r.calls = (shell.TotalCalls() - shell.CallCount(SimCall::GetWindowBasics) - shell.CallCount(SimCall::MonitorFromWindow)) / Switches;
+		r.stats = GroupsWindowFilter().GetStats();
+
+		// the application windows of the top group on screen, the rest not
+		for (GroupId id : list.mItems)
+		{
+			auto members = GroupMembers(id);
+			if (!members)
+				continue;
+			for (HWND hwnd : *members)
+			{
+				bool noise = std::find(planted.begin(), planted.end(), hwnd) != planted.end();
+				r.clean = r.clean && !noise;
+				if (!noise)
+					r.placed = r.placed && (shell.WindowDesktop(hwnd) == (int)shell.CurrentDesktop()) == (id == list.mItems[0]);
+			}
+		}
+
+		GroupsShutdown();
+		return r;
+	}
+
+	// What gets through that shouldn't be taken for noise, and the trace
+	int CheckStages()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 4;
+
+		SimShell shell(simOpts);
+		shell.MoveWindowTo(shell.WindowAt(1), 1);
+
+		auto away = Shown();
+		away.cloaked = DWM_CLOAKED_SHELL;
+		shell.SetWindowBasics(shell.WindowAt(1), away);
+
+		auto listed = Shown();
+		listed.exStyle = WS_EX_TOOLWINDOW | WS_EX_APPWINDOW;
+		shell.SetWindowBasics(shell.WindowAt(2), listed);
+
+		auto planted = Plant(shell, 40, shell.WindowAt(0));
+
+		WindowFilter filter;
+		std::vector<HWND> wins;
+		shell.EnumTopLevelWindows(wins);
+
+		TraceEnable(true);
+		TraceClear();
+		filter.Apply(&shell, wins);
+		TraceEnable(false);
+
+		const auto& stats = filter.GetStats();
+		check(wins.size() == 4, "an application window was filtered out");
+		check(stats.checked == 44 && stats.passed == 4, "filter miscounted");
+
+		using Stage = WindowFilter::Stage;
+		UINT expected[(size_t)Stage::Count] = { 0, 40 - Tools - Owned - Cloaked - Empty - Shell, Empty, Tools, Owned, Cloaked, Shell };
+		for (size_t i = 0; i < (size_t)Stage::Count; i++)
+		{
+			if (stats.rejected[i] != expected[i])
+			{
+				std::fprintf(stderr, "  %s: %zu rejected, %u planted\n", WindowFilter::StageName((Stage)i), stats.rejected[i], expected[i]);
+				++failures;
+			}
+		}
+
+		std::ostringstream json;
+		TraceWriteChrome(json);
+		check(json.str().find("\"ph\":\"C\",\"name\":\"filtered: invisible\"") != std::string::npos, "no counters in the trace");
+
+		// a closed window is ruled out too, there is nothing to ask about
+		shell.CloseWindow(planted.front());
+		wins = { planted.front() };
+		filter.Apply(&shell, wins);
+		check(wins.empty() && filter.GetStats().rejected[(size_t)Stage::Shell] == 1, "closed window kept");
+
+		// nor is a child the hook let through, it has no owner to give it away
+		auto child = Shown();
+		child.style = WS_CHILD;
+		child.exStyle = WS_EX_APPWINDOW;
+		shell.SetWindowBasics(planted.back(), child);
+		wins = { planted.back() };
+		filter.Apply(&shell, wins);
+		check(wins.empty() && filter.GetStats().rejected[(size_t)Stage::Styles] == Tools + 1, "child window kept");
+
+		return failures;
+	}
+}
+
+int main()
+{
+	const auto latency = std::chrono::microseconds(20);
+	const UINT noise = 300;
+
+	std::printf("%d switches between two groups, %u windows no switcher shows, %lld us a call\n\n",
+		Switches, noise, (long long)latency.count());
+	std::printf("%6s %7s | %8s %12s %8s %9s\n", "n", "filter", "queries", "calls/switch", "basics", "ms/switch");
+
+	int failures = 0;
+	for (UINT perGroup : { 10u, 50u, 200u })
+	{
+		Result results[2];
+		for (bool filter : { false, true })
+		{
+			auto& r = results[filter];
+			r = Run(perGroup, noise, filter, latency);
+
+			std::printf("%6u %7s | %8zu %12zu %8zu %9.3f\n", perGroup, filter ? "yes" : "no",
+				r.queries, r.calls, r.basics, r.ms);
+
+			if (!r.placed || (filter && !r.clean))
+			{
+				std::fprintf(stderr, "  %u windows a group%s: %s\n", perGroup, filter ? ", filtered" : "",
+					r.placed ? "a group holds a window no switcher shows" : "wrong windows on screen");
+				++failures;
+			}
+		}
+
+		// explorer is only asked about the application windows
+		if (results[1].queries >= results[0].queries || results[1].queries > 2 * perGroup)
+		{
+			std::fprintf(stderr, "  %u windows a group: %zu queries filtered against %zu\n", perGroup, results[1].queries, results[0].queries);
+			++failures;
+		}
+	}
+
+	failures += CheckStages();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,442 @@
+// The group commands at scale against the simulated shell: wall time,
+// cross-process calls and heap allocations per operation, for a range of
+// window counts. Results can be written as JSON and checked against a stored
+// baseline, failing when calls or allocations (and with --time-threshold, wall
+// time) grow past the threshold.
+//
+//   groupbench [--windows 10,100,1000,10000] [--groups 4] [--desktops 2]
+//              [--latency us] [--reps n] [--ops NextGroup,ShowTopGroup,...]
+//              [--json out.json] [--baseline base.json] [--threshold pct]
+//              [--time-threshold pct]
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+	std::atomic<size_t> m_Allocs{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+	++m_Allocs;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace {
+	struct Config
+	{
+		std::vector<UINT> windows{ 10, 100, 1000, 10000 };
+		UINT groups = 4;
+		UINT desktops = 2;
+		UINT latencyUs = 0;
+		int reps = 20;
+		std::vector<std::string> ops{ "NextGroup", "ShowTopGroup", "MoveSwap", "RestoreScratched", "Undo" };
+		std::string json;
+		std::string baseline;
+		double threshold = 5;
+		double timeThreshold = -1;  // wall time is only compared when asked for
+	};
+
+	struct Result
+	{
+		std::string op;
+		UINT windows = 0;
+		UINT groups = 0;
+		UINT desktops = 0;
+		UINT latencyUs = 0;
+		double ms = 0;
+		double calls = 0;
+		double allocs = 0;
+	};
+
+	std::string Key(const Result& r)
+	{
+		std::ostringstream key;
+		key << r.op << '/' << r.windows << '/' << r.groups << '/' << r.desktops << '/' << r.latencyUs;
+		return key.str();
+	}
+
+	// The untimed part of each repetition, puts things where the op expects them
+	void Prepare(const std::string& op)
+	{
+		if (op == "ShowTopGroup" || op == "RestoreScratched")
+			MoveAllToOther();
+		else if (op == "Undo")
+			RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+	}
+
+	void RunOp(const std::string& op)
+	{
+		if (op == "NextGroup")
+			RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		else if (op == "ShowTopGroup")
+			ShowTopGroup();
+		else if (op == "MoveSwap")
+			MoveSwap();
+		else if (op == "RestoreScratched")
+			RestoreScratched();
+		else if (op == "Undo")
+			UndoCommand();
+	}
+
+	// Which desktop every window is on, to see an undo put them all back
+	std::vector<int> Placement(const SimShell& shell)
+	{
+		std::vector<int> at(shell.WindowCount());
+		for (size_t i = 0; i < at.size(); i++)
+			at[i] = shell.WindowDesktop(shell.WindowAt(i));
+		return at;
+	}
+
+	Result Run(const Config& cfg, const std::string& op, UINT windows)
+	{
+		UINT perGroup = windows / cfg.groups ? windows / cfg.groups : 1;
+
+		SimShellOptions simOpts;
+		simOpts.desktops = cfg.desktops;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t* msg) {
+			std::fprintf(stderr, "%ls\n", msg);
+		});
+
+		NewGroup();
+		for (UINT g = 1; g < cfg.groups; g++)
+		{
+			NewGroup();
+			MoveAllToOther();
+			for (UINT i = 0; i < perGroup; i++)
+				shell.AddWindow(shell.CurrentDesktop());
+		}
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		// the setup's windows showing overflow the event queue, the sweep
+		// that makes up for it belongs to the setup and not the first rep
+		GroupsTrackWindows();
+
+		shell.SetCallLatency(std::chrono::microseconds(cfg.latencyUs));
+
+		int reps = windows >= 10000 ? std::max(cfg.reps / 4, 1) : cfg.reps;
+
+		double seconds = 0;
+		size_t calls = 0;
+		size_t allocs = 0;
+
+		for (int i = 0; i < reps; i++)
+		{
+			auto placed = op == "Undo" ? Placement(shell) : std::vector<int>();
+			auto stack = list.mItems;
+
+			Prepare(op);
+			auto done = op == "Undo" ? Placement(shell) : std::vector<int>();
+			shell.PumpNotifications();
+
+			shell.ResetCalls();
+			size_t allocsBefore = m_Allocs.load();
+			auto start = std::chrono::steady_clock::now();
+
+			RunOp(op);
+
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			allocs += m_Allocs.load() - allocsBefore;
+			calls += shell.TotalCalls();
+
+			shell.PumpNotifications();
+
+			// and redo has to bring the command's result back
+			if (op == "Undo")
+			{
+				bool undone = Placement(shell) == placed && list.mItems == stack;
+				RedoCommand();
+				shell.PumpNotifications();
+				if (!undone || Placement(shell) != done)
+				{
+					std::fprintf(stderr, "undo or redo left windows elsewhere at %u windows\n", windows);
+					std::exit(1);
+				}
+			}
+		}
+
+		GroupsShutdown();
+
+		Result r;
+		r.op = op;
+		r.windows = windows;
+		r.groups = cfg.groups;
+		r.desktops = cfg.desktops;
+		r.latencyUs = cfg.latencyUs;
+		r.ms = seconds * 1000 / reps;
+		r.calls = (double)calls / reps;
+		r.allocs = (double)allocs / reps;
+		return r;
+	}
+
+	void WriteJson(std::ostream& out, const std::vector<Result>& results)
+	{
+		out << "{\n\"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			out << "  {\"op\": \"" << r.op << "\", \"windows\": " << r.windows
+				<< ", \"groups\": " << r.groups << ", \"desktops\": " << r.desktops
+				<< ", \"latency_us\": " << r.latencyUs << ", \"ms\": " << r.ms
+				<< ", \"calls\": " << r.calls << ", \"allocs\": " << r.allocs << "}"
+				<< (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		out << "]\n}\n";
+	}
+
+	// Reads back what WriteJson wrote: flat objects of strings and numbers,
+	// anything else is skipped over
+	bool ReadJson(const std::string& path, std::vector<Result>& results)
+	{
+		std::ifstream in(path);
+		if (!in)
+			return false;
+
+		std::stringstream text;
+		text << in.rdbuf();
+		const std::string s = text.str();
+
+		size_t pos = s.find("\"results\"");
+		if (pos == std::string::npos)
+			return false;
+
+		while ((pos = s.find('{', pos)) != std::string::npos)
+		{
+			size_t end = s.find('}', pos);
+			if (end == std::string::npos)
+				return false;
+
+			Result r;
+			size_t at = pos + 1;
+			while (at < end)
+			{
+				size_t keyStart = s.find('"', at);
+				if (keyStart == std::string::npos || keyStart >= end)
+					break;
+				size_t keyEnd = s.find('"', keyStart + 1);
+				size_t colon = s.find(':', keyEnd);
+				std::string key = s.substr(keyStart + 1, keyEnd - keyStart - 1);
+
+				size_t valStart = s.find_first_not_of(" \t\r\n", colon + 1);
+				size_t valEnd;
+				std::string value;
+				if (s[valStart] == '"')
+				{
+					valEnd = s.find('"', valStart + 1);
+					value = s.substr(valStart + 1, valEnd - valStart - 1);
+					++valEnd;
+				}
+				else
+				{
+					valEnd = s.find_first_of(",}", valStart);
+					value = s.substr(valStart, valEnd - valStart);
+				}
+
+				if (key == "op") r.op = value;
+				else if (key == "windows") r.windows = (UINT)std::stoul(value);
+				else if (key == "groups") r.groups = (UINT)std::stoul(value);
+				else if (key == "desktops") r.desktops = (UINT)std::stoul(value);
+				else if (key == "latency_us") r.latencyUs = (UINT)std::stoul(value);
+				else if (key == "ms") r.ms = std::stod(value);
+				else if (key == "calls") r.calls = std::stod(value);
+				else if (key == "allocs") r.allocs = std::stod(value);
+
+				at = valEnd;
+			}
+
+			if (!r.op.empty())
+				results.push_back(r);
+			pos = end + 1;
+		}
+
+		return true;
+	}
+
+	// Percent over the baseline, 0 when it got better or stayed the same
+	double Growth(double now, double base)
+	{
+		if (now <= base)
+			return 0;
+		if (base <= 0)
+			return 100;
+		return (now - base) * 100 / base;
+	}
+
+	int Compare(const Config& cfg, const std::vector<Result>& results)
+	{
+		std::vector<Result> baseline;
+		if (!ReadJson(cfg.baseline, baseline))
+		{
+			std::fprintf(stderr, "could not read baseline %s\n", cfg.baseline.c_str());
+			return 1;
+		}
+
+		std::printf("\nagainst %s, threshold %.1f%%", cfg.baseline.c_str(), cfg.threshold);
+		if (cfg.timeThreshold >= 0)
+			std::printf(", wall time %.1f%%", cfg.timeThreshold);
+		std::printf("\n");
+
+		int regressions = 0;
+		for (const auto& r : results)
+		{
+			const Result* base = nullptr;
+			for (const auto& b : baseline)
+			{
+				if (Key(b) == Key(r))
+					base = &b;
+			}
+
+			if (!base)
+			{
+				std::printf("  %-32s not in the baseline\n", Key(r).c_str());
+				continue;
+			}
+
+			auto check = [&](const char* what, double now, double was, double limit) {
+				double growth = Growth(now, was);
+				if (limit < 0 || growth <= limit)
+					return;
+				std::printf("  %-32s %s %.1f -> %.1f (+%.1f%%)\n", Key(r).c_str(), what, was, now, growth);
+				++regressions;
+			};
+
+			check("calls", r.calls, base->calls, cfg.threshold);
+			check("allocs", r.allocs, base->allocs, cfg.threshold);
+			// below a tenth of a millisecond it is all noise
+			if (base->ms >= 0.1)
+				check("ms", r.ms, base->ms, cfg.timeThreshold);
+		}
+
+		if (regressions)
+		{
+			std::printf("%d regression(s)\n", regressions);
+			return 1;
+		}
+
+		std::printf("  no regressions\n");
+		return 0;
+	}
+
+	template<typename T, typename Parse>
+	std::vector<T> SplitList(const char* text, Parse parse)
+	{
+		std::vector<T> items;
+		std::stringstream in(text);
+		std::string item;
+		while (std::getline(in, item, ','))
+		{
+			if (!item.empty())
+				items.push_back(parse(item));
+		}
+		return items;
+	}
+
+	bool ParseArgs(int argc, char** argv, Config& cfg)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const char* arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (!value)
+				return false;
+			++i;
+
+			if (!std::strcmp(arg, "--windows"))
+				cfg.windows = SplitList<UINT>(value, [](const std::string& s) { return (UINT)std::stoul(s); });
+			else if (!std::strcmp(arg, "--groups"))
+				cfg.groups = std::max<UINT>(2, (UINT)std::atoi(value));
+			else if (!std::strcmp(arg, "--desktops"))
+				cfg.desktops = std::max<UINT>(2, (UINT)std::atoi(value));
+			else if (!std::strcmp(arg, "--latency"))
+				cfg.latencyUs = (UINT)std::atoi(value);
+			else if (!std::strcmp(arg, "--reps"))
+				cfg.reps = std::max(1, std::atoi(value));
+			else if (!std::strcmp(arg, "--ops"))
+				cfg.ops = SplitList<std::string>(value, [](const std::string& s) { return s; });
+			else if (!std::strcmp(arg, "--json"))
+				cfg.json = value;
+			else if (!std::strcmp(arg, "--baseline"))
+				cfg.baseline = value;
+			else if (!std::strcmp(arg, "--threshold"))
+				cfg.threshold = std::atof(value);
+			else if (!std::strcmp(arg, "--time-threshold"))
+				cfg.timeThreshold = std::atof(value);
+			else
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Config cfg;
+	if (!ParseArgs(argc, argv, cfg))
+	{
+		std::fprintf(stderr, "usage: groupbench [--windows 10,100,...] [--groups n] [--desktops n] [--latency us]\n"
+			"                  [--reps n] [--ops NextGroup,ShowTopGroup,MoveSwap,RestoreScratched,Undo]\n"
+			"                  [--json out.json] [--baseline base.json] [--threshold pct] [--time-threshold pct]\n");
+		return 2;
+	}
+
+	std::printf("%u groups, %u desktops, per-call latency %u us, per operation\n\n", cfg.groups, cfg.desktops, cfg.latencyUs);
+	std::printf("%-18s %8s | %10s %10s %10s\n", "op", "windows", "ms", "calls", "allocs");
+
+	std::vector<Result> results;
+	for (const auto& op : cfg.ops)
+	{
+		for (auto windows : cfg.windows)
+		{
+			auto r = Run(cfg, op, windows);
+			std::printf("%-18s %8u | %10.3f %10.1f %10.1f\n", op.c_str(), windows, r.ms, r.calls, r.allocs);
+			results.push_back(r);
+		}
+	}
+
+	if (!cfg.json.empty())
+	{
+		std::ofstream out(cfg.json, std::ios::trunc);
+		WriteJson(out, results);
+		if (!out)
+		{
+			std::fprintf(stderr, "could not write %s\n", cfg.json.c_str());
+			return 1;
+		}
+	}
+
+	if (!cfg.baseline.empty())
+		return Compare(cfg, results);
+
+	return 0;
+}
@@ -0,0 +1,148 @@
+// Matching saved window identities back to live windows at scale, the way
+// GroupsLoad does after every application restarted. Four mixes: titles
+// unchanged (all exact), a third of the titles changed (scored within the
+// app), every window from the same app with changed titles, the worst case
+// for scoring, and terminals whose titles differ only in one of a few
+// directories, each gone one further down since. In the last one no word
+// picks a window out, every miss walks the same postings past the windows
+// earlier misses took. Fails when a match is wrong, a window is left unmatched
+// where one is free, or the time per window grows with the window count.
+
+#include "windowidentity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	enum class Mix
+	{
+		Exact,
+		SomeRetitled,
+		OneAppRetitled,
+		Terminals,
+	};
+
+	// Terminals only tell apart by directory
+	constexpr size_t Directories = 4;
+
+	const char* MixName(Mix mix)
+	{
+		switch (mix)
+		{
+		case Mix::Exact: return "exact";
+		case Mix::SomeRetitled: return "third retitled";
+		case Mix::OneAppRetitled: return "one app, retitled";
+		case Mix::Terminals: return "terminals, cd'd";
+		default: return "?";
+		}
+	}
+
+	struct Result
+	{
+		double usPerWindow;
+		size_t matched;
+		size_t wrong;
+	};
+
+	Result Run(size_t count, Mix mix)
+	{
+		std::vector<WindowIdentity> wanted;
+		WindowIdentityIndex index;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t app = mix == Mix::OneAppRetitled ? 0 : i % 40;
+
+			WindowTraits traits;
+			traits.appId = L"Bench.App" + std::to_wstring(app);
+			traits.image = L"C:\\Program Files\\App" + std::to_wstring(app) + L"\\app.exe";
+			traits.className = L"BenchWindow";
+			traits.title = L"Project " + std::to_wstring(i) + L" - notes " + std::to_wstring(i * 7) + L" - App";
+			if (mix == Mix::Terminals)
+			{
+				traits.appId = L"Microsoft.WindowsTerminal";
+				traits.image = L"C:\\Windows\\System32\\WindowsPowerShell\\v1.0\\powershell.exe";
+				traits.className = L"ConsoleWindowClass";
+				traits.title = L"Windows PowerShell - C:\\Users\\dev\\repo" + std::to_wstring(i % Directories);
+			}
+			wanted.push_back(MakeWindowIdentity(traits));
+
+			bool retitled = mix == Mix::OneAppRetitled || mix == Mix::Terminals || (mix == Mix::SomeRetitled && i % 3 == 0);
+			if (mix == Mix::Terminals)
+				traits.title += L"\\src";
+			else if (retitled)
+				traits.title = L"*" + traits.title + L" (modified)";
+
+			// the live windows come up in another order than they were saved
+			index.Add((HWND)(std::uintptr_t)(0x10000 + 4 * ((i * 7919) % count)), MakeWindowIdentity(traits));
+		}
+
+		// what each wanted identity should find, for the terminals any of the
+		// same directory
+		auto live = [count](size_t i) { return (HWND)(std::uintptr_t)(0x10000 + 4 * ((i * 7919) % count)); };
+		std::unordered_map<HWND, size_t> saved;
+		for (size_t i = 0; i < count; i++)
+			saved.emplace(live(i), i);
+		auto right = [&](size_t i, HWND hwnd) {
+			return mix == Mix::Terminals ? saved[hwnd] % Directories == i % Directories : hwnd == live(i);
+		};
+
+		std::vector<HWND> found;
+		auto start = std::chrono::steady_clock::now();
+		index.Match(wanted, found);
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		Result r{ us / count, 0, 0 };
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!found[i])
+				continue;
+			++r.matched;
+			if (!right(i, found[i]))
+				++r.wrong;
+		}
+		return r;
+	}
+}
+
+int main()
+{
+	const size_t counts[] = { 1000, 10000, 50000 };
+	const Mix mixes[] = { Mix::Exact, Mix::SomeRetitled, Mix::OneAppRetitled, Mix::Terminals };
+
+	std::printf("%-20s %8s | %12s %9s %7s\n", "mix", "windows", "us/window", "matched", "wrong");
+
+	bool failed = false;
+	for (auto mix : mixes)
+	{
+		double smallest = 0;
+		for (auto count : counts)
+		{
+			auto r = Run(count, mix);
+			std::printf("%-20s %8zu | %12.3f %9zu %7zu\n", MixName(mix), count, r.usPerWindow, r.matched, r.wrong);
+
+			if (r.wrong)
+				failed = true;
+			if (mix != Mix::OneAppRetitled && r.matched != count)
+				failed = true;
+
+			// 50x the windows; quadratic would be 50x the time per window
+			if (!smallest)
+				smallest = r.usPerWindow;
+			else if (r.usPerWindow > smallest * 8)
+				failed = true;
+		}
+	}
+
+	if (failed)
+	{
+		std::fprintf(stderr, "matching was wrong or didn't scale\n");
+		return 1;
+	}
+
+	return 0;
+}
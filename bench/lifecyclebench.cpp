@@ -0,0 +1,365 @@
+// Closed windows leaving their groups as the simulated shell reports them,
+// against leaving them in until the group is captured again. A switch to a
+// group still holding closed windows asks explorer for each of their views;
+// with the windows tracked it makes no call for them. Pruning goes through
+// the window -> groups index, so its cost follows the windows that closed and
+// not the number of groups; a resync, which sweeps every group, is shown
+// against it.
+//
+// Also: the event queue keeps order across threads and owns up to what it
+// dropped, hidden windows stay in their groups, undo doesn't bring a closed
+// window back, a resync catches what no event was raised for, half of a
+// large group closing costs a constant time a window, and a window explorer
+// couldn't place is asked again once it's shown or some view moves.
+
+#include "commandqueue.h"
+#include "desktopcache.h"
+#include "groups.h"
+#include "simshell.h"
+#include "windowevents.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+	// Holds a closed window, in any group
+	bool Held(const VectorGroupList& list, const std::vector<HWND>& closed)
+	{
+		for (auto id : list.mItems)
+		{
+			auto members = GroupMembers(id);
+			for (HWND hwnd : closed)
+			{
+				if (members && std::find(members->begin(), members->end(), hwnd) != members->end())
+					return true;
+			}
+		}
+		return false;
+	}
+
+	size_t Memberships(const VectorGroupList& list)
+	{
+		size_t n = 0;
+		for (auto id : list.mItems)
+		{
+			auto members = GroupMembers(id);
+			n += members ? members->size() : 0;
+		}
+		return n;
+	}
+
+	struct Result
+	{
+		size_t lookups = 0;  // GetViewForHwnd of the switch after the closing
+		size_t pruned = 0;
+		double pruneUs = 0;
+		double resyncUs = 0;
+		bool clean = true;
+	};
+
+	// groups groups of perGroup windows, each shown once, then every group
+	// combined with the next so each window is in three groups. closing
+	// windows of the group the switch goes to close, ones not on screen.
+	Result Run(UINT groups, UINT perGroup, UINT closing, bool track, int& failures)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsOptions opts;
+		opts.snapshot = false;
+		opts.viewCache = false;
+		opts.trackWindows = track;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+
+		NewGroup();
+		for (UINT g = 1; g < groups; g++)
+		{
+			NewGroup();
+			MoveAllToOther();
+			for (UINT i = 0; i < perGroup; i++)
+				shell.AddWindow(shell.CurrentDesktop());
+			shell.PumpNotifications();
+		}
+		std::vector<GroupId> bases = list.mItems;
+		for (size_t g = 0; g < bases.size(); g++)
+			CombineGroups(SetOp::Union, bases[g], bases[(g + 1) % bases.size()]);
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		// the first closing builds the window -> groups index
+		shell.CloseWindow(GroupMembers(list.mItems.back())->back());
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+
+		auto check = [&](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s, %u groups, %s\n", what, groups, track ? "tracked" : "untracked");
+			++failures;
+		};
+
+		auto top = GroupMembers(list.mItems[0]);
+		std::vector<HWND> closed;
+		for (HWND hwnd : *GroupMembers(list.mItems[1]))
+		{
+			if (closed.size() < closing && std::find(top->begin(), top->end(), hwnd) == top->end())
+				closed.push_back(hwnd);
+		}
+		for (HWND hwnd : closed)
+			shell.CloseWindow(hwnd);
+		shell.PumpNotifications();
+
+		Result r;
+		size_t before = Memberships(list);
+		auto start = std::chrono::steady_clock::now();
+		r.pruned = GroupsTrackWindows();
+		r.pruneUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		r.clean = !Held(list, closed);
+
+		if (track)
+		{
+			check(r.clean, "a group still holds a closed window");
+			check(before - Memberships(list) == r.pruned, "pruned count off");
+			check(GroupsWindowStats().sweeps == 0, "pruning swept every group");
+		}
+
+		shell.ResetCalls();
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		r.lookups = shell.CallCount(SimCall::GetViewForHwnd);
+		shell.PumpNotifications();
+
+		// closing and showing again changed nothing more to undo into
+		if (track)
+		{
+			UndoCommand();
+			UndoCommand();
+			shell.PumpNotifications();
+			check(!Held(list, closed), "undo brought a closed window back");
+		}
+
+		start = std::chrono::steady_clock::now();
+		GroupsResync();
+		r.resyncUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		GroupsShutdown();
+		return r;
+	}
+
+	// A hidden window stays, a window closed with no event raised for it
+	// leaves at the next resync
+	int CheckEdges()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 8;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+		NewGroup();
+		MoveGroup(1);
+		NewGroup();
+
+		GroupId first = list.mItems[1];
+		HWND hidden = shell.WindowAt(0);
+		HWND silent = shell.WindowAt(1);
+
+		shell.SetWindowShown(hidden, false);
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+		check(GroupMembers(first)->size() == 8, "hidden window left its group");
+
+		shell.SetNotificationsEnabled(false);
+		shell.CloseWindow(silent);
+		shell.SetNotificationsEnabled(true);
+		GroupsTrackWindows();
+		check(GroupMembers(first)->size() == 8, "closed window left without an event");
+		GroupsResync();
+		check(!Held(list, { silent }) && GroupMembers(first)->size() == 7, "resync kept a closed window");
+
+		GroupsShutdown();
+		return failures;
+	}
+
+	// A failed desktop lookup is served from the cache until the window is
+	// shown again or a view notification comes in, then asked for again
+	int CheckFailedLookup()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 8;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+
+		auto& cache = GroupsDesktopCache();
+		auto lookups = [&shell]() { return shell.CallCount(SimCall::GetWindowDesktopId); };
+		GUID at{};
+
+		HWND shown = shell.WindowAt(0);
+		shell.ResetCalls();
+		shell.FailCall(SimCall::GetWindowDesktopId, 0);
+		check(FAILED(cache.GetWindowDesktopId(shown, &at)), "failed lookup reported as found");
+		check(FAILED(cache.GetWindowDesktopId(shown, &at)) && lookups() == 1, "failed lookup not cached");
+
+		shell.SetWindowShown(shown, false);
+		shell.SetWindowShown(shown, true);
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+		check(SUCCEEDED(cache.GetWindowDesktopId(shown, &at)) && lookups() == 2, "shown window not asked again");
+
+		HWND other = shell.WindowAt(1);
+		shell.FailCall(SimCall::GetWindowDesktopId, 2);
+		check(FAILED(cache.GetWindowDesktopId(other, &at)), "second failed lookup reported as found");
+		shell.MoveWindowTo(shell.WindowAt(2), 1);
+		shell.PumpNotifications();
+		check(SUCCEEDED(cache.GetWindowDesktopId(other, &at)) && lookups() == 4, "failure outlived a view notification");
+		check(SUCCEEDED(cache.GetWindowDesktopId(other, &at)) && lookups() == 4, "placed window asked again");
+
+		GroupsShutdown();
+		return failures;
+	}
+
+	// Every other window of one large group closed, each taken out in place
+	// of shifting the rest down
+	int CheckLargeGroup()
+	{
+		constexpr UINT Windows = 8000;
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = Windows;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+		NewGroup();
+		MoveGroup(1);
+		NewGroup();
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+
+		GroupId group = list.mItems[1];
+		std::vector<HWND> closed, open;
+		for (UINT i = 0; i < Windows; i++)
+			(i % 2 ? open : closed).push_back(shell.WindowAt(i));
+		for (HWND hwnd : closed)
+			shell.CloseWindow(hwnd);
+		shell.PumpNotifications();
+
+		auto start = std::chrono::steady_clock::now();
+		size_t pruned = GroupsTrackWindows();
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<HWND> members = *GroupMembers(group);
+		std::sort(members.begin(), members.end());
+		std::sort(open.begin(), open.end());
+		GroupsShutdown();
+
+		std::printf("\none group of %u windows, %zu closed: pruned in %.1f us\n", Windows, closed.size(), us);
+
+		if (pruned != closed.size() || members != open)
+		{
+			std::fprintf(stderr, "  large group: %zu pruned, %zu left of %zu open\n", pruned, members.size(), open.size());
+			return 1;
+		}
+		return 0;
+	}
+
+	// Pushed from one thread, drained from another while it pushes
+	int CheckQueue()
+	{
+		int failures = 0;
+		constexpr size_t Events = 200000;
+
+		WindowEventQueue queue(1024);
+		std::vector<WindowEventQueue::Event> got;
+		got.reserve(Events);
+
+		std::thread producer([&queue]() {
+			for (size_t i = 1; i <= Events; i++)
+				queue.WindowChanged(WindowEvent::Destroyed, (HWND)i);
+		});
+
+		bool whole = true;
+		while (got.size() + queue.Lost() < Events)
+			whole = queue.Drain(got) && whole;
+		producer.join();
+		whole = queue.Drain(got) && whole;
+
+		bool ordered = std::is_sorted(got.begin(), got.end(), [](const auto& a, const auto& b) { return a.hwnd < b.hwnd; });
+		bool accounted = got.size() + queue.Lost() == Events && whole == (queue.Lost() == 0);
+
+		std::printf("\nqueue of %zu, %zu events from another thread: %zu drained, %zu dropped\n",
+			queue.Capacity(), Events, got.size(), queue.Lost());
+
+		if (!ordered || !accounted)
+		{
+			std::fprintf(stderr, "  queue lost order or miscounted\n");
+			++failures;
+		}
+		return failures;
+	}
+}
+
+int main()
+{
+	const UINT perGroup = 20;
+	const UINT closing = 5;
+
+	std::printf("%u windows a group, %u of one closed, each window in 3 groups\n\n", perGroup, closing);
+	std::printf("%7s %9s | %8s %7s %9s %9s\n", "groups", "tracking", "lookups", "pruned", "prune us", "resync us");
+
+	int failures = 0;
+	for (UINT groups : { 4u, 32u, 256u })
+	{
+		auto kept = Run(groups, perGroup, closing, false, failures);
+		auto tracked = Run(groups, perGroup, closing, true, failures);
+		for (const auto* r : { &kept, &tracked })
+		{
+			std::printf("%7u %9s | %8zu %7zu %9.1f %9.1f\n", groups, r == &tracked ? "yes" : "no",
+				r->lookups, r->pruned, r->pruneUs, r->resyncUs);
+		}
+
+		// each closed window was in three groups, and the tracked switch
+		// asks for none of their views
+		if (tracked.pruned != 3 * closing || tracked.lookups + closing != kept.lookups)
+		{
+			std::fprintf(stderr, "  %u groups: %zu pruned, %zu lookups against %zu\n", groups, tracked.pruned, tracked.lookups, kept.lookups);
+			++failures;
+		}
+	}
+
+	failures += CheckEdges();
+	failures += CheckFailedLookup();
+	failures += CheckLargeGroup();
+	failures += CheckQueue();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+// The list view's model on its own, no window: a stack rotated by the group
+// commands has to come out as a head move, anything else as a replace, and
+// either way every row has to read back what was handed in. Then the time
+// per update for both, against the stack sizes the list shows.
+//
+// Also: the model kept up by the group commands of the simulated shell the
+// way the app does it, turned by the steps GroupsStackMarks counted while
+// only rotations happen and sent the whole stack otherwise.
+
+#include "groups.h"
+#include "listmodel.h"
+#include "simshell.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	std::vector<ListItem> MakeStack(size_t n)
+	{
+		std::vector<ListItem> items;
+		for (size_t i = 0; i < n; i++)
+			items.push_back({ (GroupId)(i + 1), L"Group " + std::to_wstring(i + 1) });
+		return items;
+	}
+
+	bool Shows(const ListModel& model, const std::vector<ListItem>& items)
+	{
+		if (model.Size() != items.size())
+			return false;
+		for (size_t row = 0; row < items.size(); row++)
+		{
+			if (!(model.At(row) == items[row]))
+				return false;
+		}
+		return true;
+	}
+
+	// Rotate by steps the way IGroupList::RotateUp does, top to the bottom
+	void RotateStack(std::vector<ListItem>& items, int steps)
+	{
+		int n = (int)items.size();
+		steps = ((steps % n) + n) % n;
+		std::rotate(items.begin(), items.begin() + steps, items.end());
+	}
+
+	double NsPerUpdate(size_t n, bool rotate)
+	{
+		auto stack = MakeStack(n);
+		ListModel model;
+		model.Update(stack);
+
+		// a handful of stacks to cycle through, made before timing
+		std::vector<std::vector<ListItem>> next;
+		for (int i = 0; i < 8; i++)
+		{
+			if (rotate)
+				RotateStack(stack, 1);
+			else
+				stack[i % n].name += L"'";
+			next.push_back(stack);
+		}
+
+		size_t reps = std::max<size_t>(100, 2000000 / n);
+		auto start = std::chrono::steady_clock::now();
+		size_t sink = 0;
+		for (size_t r = 0; r < reps; r++)
+			sink += (size_t)model.Update(next[r % next.size()]);
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+		if (sink == SIZE_MAX) std::printf(" ");
+		return elapsed.count() / reps;
+	}
+
+	double NsPerRotate(size_t n)
+	{
+		ListModel model;
+		model.Update(MakeStack(n));
+
+		size_t reps = 2000000;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t r = 0; r < reps; r++)
+			model.Rotate(r % 2 ? 1 : -2);
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+		if (model.At(0).id == 0) std::printf(" ");
+		return elapsed.count() / reps;
+	}
+
+	int CheckMarks(std::mt19937& rng)
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 4;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+
+		ListModel model;
+		GroupStackMarks sent;
+		size_t sends = 0;
+		auto sync = [&]() {
+			auto marks = GroupsStackMarks(nullptr);
+			if (marks.edits != sent.edits)
+			{
+				std::vector<ListItem> items;
+				for (auto id : list.mItems)
+					items.push_back({ id, GroupName(id) });
+				model.Update(items);
+				++sends;
+			}
+			else
+				model.Rotate((int)(marks.rotated - sent.rotated));
+			sent = marks;
+
+			bool same = model.Size() == list.mItems.size();
+			for (size_t row = 0; same && row < model.Size(); row++)
+				same = model.At(row).id == list.mItems[row] && model.At(row).name == GroupName(list.mItems[row]);
+			return same;
+		};
+
+		for (int i = 0; i < 6; i++)
+		{
+			NewGroup();
+			check(sync(), "new group not shown");
+		}
+
+		size_t before = sends;
+		for (int i = 0; i < 40; i++)
+		{
+			MoveGroup(std::uniform_int_distribution<int>(-8, 8)(rng));
+			check(sync(), "rotated stack reads back wrong");
+		}
+		check(sends == before, "a rotation sent the whole stack");
+
+		RenameGroup(list.mItems[2], L"Renamed");
+		check(sync() && sends == before + 1, "rename not sent");
+		UndoCommand();
+		check(sync(), "undone rename reads back wrong");
+		UndoCommand();
+		check(sync(), "undone rotation reads back wrong");
+		DeleteGroup();
+		check(sync(), "delete reads back wrong");
+
+		GroupsShutdown();
+		return failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(18);
+	int failures = 0;
+
+	auto check = [&](bool ok, const char* what, size_t n) {
+		if (ok)
+			return;
+		std::fprintf(stderr, "  %s, %zu groups\n", what, n);
+		++failures;
+	};
+
+	for (size_t n : { 1, 2, 3, 8, 64, 1000 })
+	{
+		auto stack = MakeStack(n);
+		ListModel model;
+		check(model.Update(stack) == ListModel::Change::Replaced, "first stack not a replace", n);
+		check(model.Update(stack) == ListModel::Change::None, "same stack not left alone", n);
+		check(Shows(model, stack), "first stack reads back wrong", n);
+
+		// rotations either way, each has to be a head move
+		for (int i = 0; i < 50; i++)
+		{
+			int steps = std::uniform_int_distribution<int>(-(int)n, (int)n)(rng);
+			RotateStack(stack, steps);
+			auto change = model.Update(stack);
+			bool moved = steps % (int)n != 0;
+			check(change == (moved ? ListModel::Change::Rotated : ListModel::Change::None), "rotation not seen as one", n);
+			check(Shows(model, stack), "rotated stack reads back wrong", n);
+
+			ListModel rotated;
+			rotated.Update(MakeStack(n));
+			rotated.Rotate(steps);
+			auto expected = MakeStack(n);
+			RotateStack(expected, steps);
+			check(Shows(rotated, expected), "Rotate disagrees with the stack", n);
+		}
+
+		// a rename, a new group on top, a delete: all replaces
+		stack[n / 2].name += L" renamed";
+		check(model.Update(stack) == ListModel::Change::Replaced, "rename not a replace", n);
+		check(Shows(model, stack), "renamed stack reads back wrong", n);
+
+		stack.insert(stack.begin(), ListItem{ (GroupId)(n + 1), L"New" });
+		check(model.Update(stack) == ListModel::Change::Replaced, "new group not a replace", n);
+		stack.erase(stack.begin() + (std::ptrdiff_t)(n / 2));
+		check(model.Update(stack) == ListModel::Change::Replaced, "delete not a replace", n);
+		check(Shows(model, stack), "stack after delete reads back wrong", n);
+
+		// names are refused when another row has them, whatever the head is
+		model.Rotate(1);
+		if (n > 1)
+			check(!model.Rename(0, model.At(1).name), "taken name allowed", n);
+		check(model.Rename(0, model.At(0).name), "own name refused", n);
+		check(model.Rename(0, L"Fresh") && model.At(0).name == L"Fresh" && model.NameTaken(L"Fresh"), "rename didn't stick", n);
+	}
+
+	failures += CheckMarks(rng);
+
+	std::printf("ns per ListModel::Update, and per Rotate by the steps\n\n");
+	std::printf("%6s | %10s %10s %10s\n", "groups", "rotated", "replaced", "rotate");
+	for (size_t n : { 4, 16, 64, 256, 1024 })
+		std::printf("%6zu | %10.0f %10.0f %10.1f\n", n, NsPerUpdate(n, true), NsPerUpdate(n, false), NsPerRotate(n));
+
+	return failures ? 1 : 0;
+}
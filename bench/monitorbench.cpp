@@ -0,0 +1,227 @@
+// Group switches with a group stack per monitor, against the one stack whose
+// groups span every monitor. A switch on one monitor has to move only the
+// windows on it, a monitor count fewer than a switch of the whole desktop,
+// and leave every other screen and stack as it was; undoing it has to put
+// them all back. A window dragged off a monitor leaves its groups there the
+// next time they are captured, and RestoreScratched brings back the windows
+// of every monitor.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+	constexpr UINT Groups = 4;
+
+	struct Result
+	{
+		size_t moves = 0;
+		size_t monitorCalls = 0;
+		double ms = 0;
+	};
+
+	std::vector<int> Placement(const SimShell& shell)
+	{
+		std::vector<int> at(shell.WindowCount());
+		for (size_t i = 0; i < at.size(); i++)
+			at[i] = shell.WindowDesktop(shell.WindowAt(i));
+		return at;
+	}
+
+	std::vector<GroupId> Stack(HMONITOR monitor)
+	{
+		std::vector<GroupId> order;
+		GetGroupStack(monitor, order);
+		return order;
+	}
+
+	Result Time(SimShell& shell, const QueuedCommand& cmd, std::chrono::microseconds latency)
+	{
+		shell.PumpNotifications();
+		shell.ResetCalls();
+		shell.SetCallLatency(latency);
+
+		Result r;
+		auto start = std::chrono::steady_clock::now();
+		RunQueuedCommand(cmd);
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		shell.SetCallLatency(std::chrono::microseconds(0));
+		shell.PumpNotifications();
+		r.moves = shell.CallCount(SimCall::MoveViewToDesktop);
+		r.monitorCalls = shell.CallCount(SimCall::MonitorFromWindow);
+		return r;
+	}
+
+	// Groups of perGroup windows on every monitor, all on the one stack
+	Result RunWhole(UINT monitors, UINT perGroup, std::chrono::microseconds latency)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.monitors = monitors;
+		simOpts.windows = perGroup * monitors;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+
+		NewGroup();
+		for (UINT g = 1; g < Groups; g++)
+		{
+			NewGroup();
+			MoveAllToOther();
+			for (UINT i = 0; i < perGroup * monitors; i++)
+				shell.AddWindow(shell.CurrentDesktop(), i % monitors);
+		}
+		MoveGroup(1);
+
+		auto r = Time(shell, QueuedCommand{ Command::Group, 1 }, latency);
+
+		GroupsShutdown();
+		return r;
+	}
+
+	// The same windows, a stack per monitor with groups of perGroup windows.
+	// Switches monitor 0 and checks everything else stayed put.
+	Result RunMonitors(UINT monitors, UINT perGroup, std::chrono::microseconds latency, int& failures)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.monitors = monitors;
+		simOpts.windows = perGroup * monitors;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		size_t reports = 0;
+		GroupsInit(&shell, &list, nullptr, [&reports](const wchar_t*) {
+			++reports;
+		});
+
+		// a new group is empty, showing it puts that monitor's windows away
+		for (UINT m = 0; m < monitors; m++)
+		{
+			HMONITOR monitor = shell.Monitor(m);
+			NewGroup(monitor);
+			for (UINT g = 1; g < Groups; g++)
+			{
+				NewGroup(monitor);
+				ShowTopGroup(monitor);
+				for (UINT i = 0; i < perGroup; i++)
+					shell.AddWindow(shell.CurrentDesktop(), m);
+			}
+			MoveGroup(1, monitor);
+		}
+
+		auto check = [&](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s, %u monitors, %u windows a group\n", what, monitors, perGroup);
+			++failures;
+		};
+
+		const HMONITOR first = shell.Monitor(0);
+		auto before = Placement(shell);
+		std::vector<std::vector<GroupId>> stacks;
+		for (UINT m = 0; m < monitors; m++)
+			stacks.push_back(Stack(shell.Monitor(m)));
+		check(list.mItems.empty(), "the whole stack got groups");
+
+		auto r = Time(shell, QueuedCommand{ Command::Group, 1, nullptr, first }, latency);
+
+		// the new top's windows on screen, monitor 0's others put away, every
+		// other monitor as it was
+		auto after = Placement(shell);
+		GroupId top = NoGroup;
+		auto stack = Stack(first);
+		if (!stack.empty())
+			top = stack[0];
+		auto members = GroupMembers(top);
+		check(members && members->size() == perGroup, "monitor 0's new top group isn't whole");
+
+		const int current = (int)shell.CurrentDesktop();
+		for (size_t i = 0; i < after.size(); i++)
+		{
+			HWND hwnd = shell.WindowAt(i);
+			if (shell.WindowMonitor(hwnd) != 0)
+			{
+				check(after[i] == before[i], "a window on another monitor moved");
+				continue;
+			}
+			bool shown = members && std::find(members->begin(), members->end(), hwnd) != members->end();
+			check((after[i] == current) == shown, "monitor 0 shows the wrong windows");
+		}
+
+		check(Stack(first) != stacks[0], "monitor 0's stack didn't rotate");
+		for (UINT m = 1; m < monitors; m++)
+			check(Stack(shell.Monitor(m)) == stacks[m], "another monitor's stack changed");
+
+		UndoCommand();
+		shell.PumpNotifications();
+		check(Placement(shell) == before, "undo left windows out of place");
+		check(Stack(first) == stacks[0], "undo didn't put monitor 0's stack back");
+
+		// a window dragged to monitor 1 is no longer monitor 0's to capture
+		if (members && !members->empty() && monitors > 1)
+		{
+			stack = Stack(first);
+			auto shownNow = GroupMembers(stack[0]);
+			HWND dragged = shownNow && !shownNow->empty() ? shownNow->front() : nullptr;
+			shell.SetWindowMonitor(dragged, 1);
+
+			MoveGroup(1, first);
+			shell.PumpNotifications();
+
+			auto captured = GroupMembers(stack[0]);
+			check(captured && std::find(captured->begin(), captured->end(), dragged) == captured->end(), "dragged window still captured on monitor 0");
+			check(shell.WindowDesktop(dragged) == current, "dragged window was put away");
+		}
+
+		// the commands that take no monitor span every screen
+		RestoreScratched();
+		shell.PumpNotifications();
+		bool restored = true;
+		for (size_t i = 0; i < shell.WindowCount(); i++)
+			restored = restored && shell.WindowDesktop(shell.WindowAt(i)) == current;
+		check(restored, "restore left windows put away");
+
+		check(reports == 0, "a command reported a failure");
+
+		GroupsShutdown();
+		return r;
+	}
+}
+
+int main()
+{
+	const auto latency = std::chrono::microseconds(50);
+
+	std::printf("one group switch, %u groups a stack, %lld us a call\n\n", Groups, (long long)latency.count());
+	std::printf("%8s %6s | %12s %10s | %12s %10s %10s\n", "monitors", "n", "whole moves", "ms", "screen moves", "ms", "monitor");
+
+	int failures = 0;
+	for (UINT monitors : { 1u, 2u, 3u })
+	{
+		for (UINT perGroup : { 4u, 50u })
+		{
+			auto whole = RunWhole(monitors, perGroup, latency);
+			auto screen = RunMonitors(monitors, perGroup, latency, failures);
+
+			std::printf("%8u %6u | %12zu %10.3f | %12zu %10.3f %10zu\n", monitors, perGroup,
+				whole.moves, whole.ms, screen.moves, screen.ms, screen.monitorCalls);
+
+			// a switch moves a group out and one in, on one screen or on all
+			if (whole.moves != 2 * perGroup * monitors || screen.moves != 2 * perGroup)
+			{
+				std::fprintf(stderr, "  wrong number of moves, %u monitors, %u windows a group\n", monitors, perGroup);
+				++failures;
+			}
+		}
+	}
+
+	return failures ? 1 : 0;
+}
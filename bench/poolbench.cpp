@@ -0,0 +1,100 @@
+// Wall time of one MoveWindowsToDesktop batch against a simulated shell with a
+// few milliseconds per call, on the command thread and spread over a move pool
+// of 1..16 threads, with explorer serving any number of calls at once and only
+// a few. The snapshot is off so the batch is nothing but the moves.
+
+#include "desktopcache.h"
+#include "groups.h"
+#include "movepool.h"
+#include "simshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	double Run(UINT windows, std::chrono::microseconds latency, UINT servers, UINT threads)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = windows;
+		simOpts.servers = servers;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsOptions opts;
+		opts.snapshot = false;
+
+		GroupsInit(&shell, &list, nullptr, nullptr, opts);
+
+		std::vector<HWND> wins;
+		for (size_t i = 0; i < shell.WindowCount(); i++)
+			wins.push_back(shell.WindowAt(i));
+
+		// the cache already knows every window, as it would after a while
+		GUID at{};
+		for (const auto& hwnd : wins)
+			GroupsDesktopCache().GetWindowDesktopId(hwnd, &at);
+
+		MovePool pool;
+		if (threads)
+		{
+			pool.Start(threads, [&shell]() -> IShellBackend* { return &shell; }, nullptr);
+			GroupsSetMovePool(&pool);
+		}
+
+		shell.SetCallLatency(latency);
+
+		std::vector<MoveOutcome> results;
+		auto start = std::chrono::steady_clock::now();
+		MoveWindowsToDesktop(wins, shell.DesktopId(1), results);
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+		pool.Stop();
+		GroupsShutdown();
+
+		for (size_t i = 0; i < wins.size(); i++)
+		{
+			if (results[i].hwnd != wins[i] || results[i].result != MoveResult::Moved || shell.WindowDesktop(wins[i]) != 1)
+			{
+				std::fprintf(stderr, "window %zu not moved\n", i);
+				std::exit(1);
+			}
+		}
+
+		return elapsed.count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT windows = argc > 1 ? (UINT)std::atoi(argv[1]) : 150;
+	auto latency = std::chrono::microseconds(argc > 2 ? std::atoi(argv[2]) : 3000);
+
+	const UINT threadCounts[] = { 0, 1, 2, 4, 8, 16 };
+	const UINT serverCounts[] = { 0, 4 };
+
+	std::printf("%u windows, per-call latency %lld us, ms per batch (speedup)\n\n", windows, (long long)latency.count());
+	std::printf("%8s | %20s | %20s\n", "threads", "explorer unlimited", "explorer serves 4");
+
+	double serial[2] = {};
+	for (auto threads : threadCounts)
+	{
+		if (threads)
+			std::printf("%8u |", threads);
+		else
+			std::printf("%8s |", "none");
+
+		for (size_t s = 0; s < 2; s++)
+		{
+			double ms = Run(windows, latency, serverCounts[s], threads);
+			if (!threads)
+				serial[s] = ms;
+			std::printf("%s %10.1f (%5.1fx)", s ? " |" : "", ms, serial[s] / ms);
+		}
+		std::printf("\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,254 @@
+// A group switch that starts from what GroupsPrefetch readied while the
+// command thread was idle, against one that asks explorer for its snapshot
+// and works out its moves itself. Both have to leave the same windows on
+// screen. A prefetch has to be dropped once a window is moved behind our back
+// or opened, and a closed window of the next group must not be moved. The
+// view cache is off, with it a warm snapshot is already down to one call.
+// Each is timed at its best of a few runs.
+//
+// Also: a stale prefetch costs the switch no call over not having one, the
+// worker stops prefetching while windows keep opening between commands and
+// starts again once one is used, and with the move pool on the pool threads
+// move the prefetched views instead of looking them up.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "movepool.h"
+#include "simshell.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+	constexpr UINT Groups = 4;
+	constexpr int Reps = 3;
+
+	enum class Change
+	{
+		None,
+		Moved,   // a window of the top group put on the other desktop
+		Opened,  // a new window on screen
+		Closed,  // a window of the next group closed before the prefetch
+	};
+
+	const char* ChangeName(Change change)
+	{
+		switch (change)
+		{
+			case Change::Moved: return "moved";
+			case Change::Opened: return "opened";
+			case Change::Closed: return "closed";
+			default: return "none";
+		}
+	}
+
+	struct Result
+	{
+		size_t calls = 0;
+		size_t moves = 0;
+		double ms = 0;
+		PrefetchStats stats;
+		std::vector<int> placement;
+	};
+
+	std::vector<int> Placement(const SimShell& shell)
+	{
+		std::vector<int> at(shell.WindowCount());
+		for (size_t i = 0; i < at.size(); i++)
+			at[i] = shell.WindowDesktop(shell.WindowAt(i));
+		return at;
+	}
+
+	Result Run(UINT perGroup, bool prefetch, Change change, std::chrono::microseconds latency)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsOptions opts;
+		opts.viewCache = false;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+
+		NewGroup();
+		for (UINT g = 1; g < Groups; g++)
+		{
+			NewGroup();
+			MoveAllToOther();
+			for (UINT i = 0; i < perGroup; i++)
+				shell.AddWindow(shell.CurrentDesktop());
+		}
+		MoveGroup(1);
+
+		if (change == Change::Closed && list.mItems.size() > 1)
+		{
+			auto next = GroupMembers(list.mItems[1]);
+			if (next && !next->empty())
+				shell.CloseWindow(next->front());
+		}
+		shell.PumpNotifications();
+
+		// what the idle worker would do after the last command
+		if (prefetch)
+			GroupsPrefetch();
+
+		if (change == Change::Moved)
+		{
+			auto top = GroupMembers(list.mItems[0]);
+			if (top && !top->empty())
+				shell.MoveWindowTo(top->front(), shell.CurrentDesktop() ? 0 : 1);
+		}
+		else if (change == Change::Opened)
+			shell.AddWindow(shell.CurrentDesktop());
+		shell.PumpNotifications();
+
+		shell.ResetCalls();
+		shell.SetCallLatency(latency);
+
+		Result r;
+		auto start = std::chrono::steady_clock::now();
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		shell.SetCallLatency(std::chrono::microseconds(0));
+		shell.PumpNotifications();
+		r.calls = shell.TotalCalls();
+		r.moves = shell.CallCount(SimCall::MoveViewToDesktop);
+		r.stats = GroupsPrefetchStats();
+		r.placement = Placement(shell);
+
+		GroupsShutdown();
+		return r;
+	}
+
+	Result Best(UINT perGroup, bool prefetch, Change change, std::chrono::microseconds latency)
+	{
+		Result best = Run(perGroup, prefetch, change, latency);
+		for (int i = 1; i < Reps; i++)
+		{
+			Result r = Run(perGroup, prefetch, change, latency);
+			if (r.ms < best.ms)
+				best = std::move(r);
+		}
+		return best;
+	}
+
+	// Windows opening before every switch, then a quiet one, on the pool
+	int CheckStaleRun()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 10;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsOptions opts;
+		opts.viewCache = false;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+
+		MovePool pool;
+		pool.Start(4, [&shell]() -> IShellBackend* { return &shell; }, nullptr);
+		GroupsSetMovePool(&pool);
+
+		NewGroup();
+		NewGroup();
+		MoveAllToOther();
+		for (UINT i = 0; i < 10; i++)
+			shell.AddWindow(shell.CurrentDesktop());
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		auto idleThenSwitch = [&shell](bool open) {
+			GroupsPrefetch();
+			if (open)
+				shell.AddWindow(shell.CurrentDesktop());
+			shell.PumpNotifications();
+			RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+			shell.PumpNotifications();
+		};
+
+		// three go stale, then two idle chances of every three are let go
+		for (int i = 0; i < 6; i++)
+			idleThenSwitch(true);
+		auto stats = GroupsPrefetchStats();
+		check(stats.taken == 4 && stats.skipped == 2 && stats.stale == 4, "stale prefetches not backed off");
+
+		// the next one taken is used, and from then on every chance is taken
+		while (GroupsPrefetchStats().taken == stats.taken)
+			GroupsPrefetch();
+		shell.ResetCalls();
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		shell.PumpNotifications();
+		check(GroupsPrefetchStats().used == 1, "prefetch not used once windows settled");
+		check(shell.CallCount(SimCall::MoveViewToDesktop) > 1 && shell.CallCount(SimCall::GetViewForHwnd) == 0,
+			"pool looked up views the prefetch had");
+
+		stats = GroupsPrefetchStats();
+		idleThenSwitch(false);
+		check(GroupsPrefetchStats().taken == stats.taken + 1 && GroupsPrefetchStats().skipped == stats.skipped, "still backing off after a used prefetch");
+
+		GroupsShutdown();
+		pool.Stop();
+		return failures;
+	}
+}
+
+int main()
+{
+	const auto latency = std::chrono::microseconds(50);
+
+	std::printf("one group switch, %u groups, %lld us a call\n\n", Groups, (long long)latency.count());
+	std::printf("%6s %7s | %7s %9s | %7s %9s %6s %6s | %9s\n", "n", "change", "calls", "ms", "calls", "ms", "used", "plans", "saved ms");
+
+	int failures = 0;
+	for (UINT perGroup : { 10u, 100u, 1000u })
+	{
+		for (Change change : { Change::None, Change::Moved, Change::Opened, Change::Closed })
+		{
+			auto cold = Best(perGroup, false, change, latency);
+			auto warm = Best(perGroup, true, change, latency);
+
+			std::printf("%6u %7s | %7zu %9.3f | %7zu %9.3f %6zu %6zu | %9.3f\n", perGroup, ChangeName(change),
+				cold.calls, cold.ms, warm.calls, warm.ms, warm.stats.used, warm.stats.plans, cold.ms - warm.ms);
+
+			auto check = [&](bool ok, const char* what) {
+				if (ok)
+					return;
+				std::fprintf(stderr, "  %s, %u windows a group, %s\n", what, perGroup, ChangeName(change));
+				++failures;
+			};
+
+			// the prefetch is an optimisation, never a different outcome
+			check(warm.placement == cold.placement, "prefetched switch placed windows differently");
+			check(warm.moves == cold.moves, "prefetched switch moved a different number of windows");
+
+			bool fresh = change == Change::None || change == Change::Closed;
+			check(warm.stats.taken == 1, "no prefetch taken");
+			check(fresh ? warm.stats.used == 1 && warm.stats.plans == 1 : warm.stats.used == 0 && warm.stats.stale == 1,
+				fresh ? "fresh prefetch not used" : "stale prefetch used");
+			if (fresh)
+				check(warm.calls < cold.calls, "prefetched switch made no fewer calls");
+			else
+				check(warm.calls <= cold.calls, "stale prefetch cost the switch a call");
+
+			// the closed window is neither moved nor asked about
+			if (change == Change::Closed)
+				check(warm.moves == 2 * perGroup - 1, "closed window moved");
+		}
+	}
+
+	failures += CheckStaleRun();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+// A burst of ALT+1 presses against a simulated shell with six groups, run one
+// switch per press the way the hotkey loop used to and folded by the command
+// queue into one rotation. Both have to end on the same group with the same
+// windows showing.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+	constexpr UINT Groups = 6;
+
+	struct Result
+	{
+		size_t moves;
+		double ms;
+		std::vector<HWND> top;      // members of the group on top
+		std::vector<HWND> showing;
+	};
+
+	Result Run(UINT perGroup, std::chrono::microseconds latency, int presses, bool coalesce)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t* msg) {
+			std::fwprintf(stderr, L"%ls\n", msg);
+		});
+
+		NewGroup();
+		for (UINT g = 1; g < Groups; g++)
+		{
+			NewGroup();
+			MoveAllToOther();
+			for (UINT i = 0; i < perGroup; i++)
+				shell.AddWindow(shell.CurrentDesktop());
+		}
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		shell.SetCallLatency(latency);
+		shell.ResetCalls();
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (coalesce)
+		{
+			CommandQueue queue;
+			for (int i = 0; i < presses; i++)
+				queue.Push(QueuedCommand{ Command::Group, 1 });
+			DrainCommands(queue);
+			shell.PumpNotifications();
+		}
+		else
+		{
+			for (int i = 0; i < presses; i++)
+			{
+				RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+				shell.PumpNotifications();
+			}
+		}
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+		Result r{ shell.CallCount(SimCall::MoveViewToDesktop), elapsed.count() };
+
+		// names differ from run to run, the handles don't
+		GroupId top = NoGroup;
+		if (list.GetTop(top) && GroupMembers(top))
+			r.top = *GroupMembers(top);
+
+		for (size_t i = 0; i < shell.WindowCount(); i++)
+		{
+			if (shell.WindowDesktop(shell.WindowAt(i)) == (int)shell.CurrentDesktop())
+				r.showing.push_back(shell.WindowAt(i));
+		}
+
+		GroupsShutdown();
+		return r;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT perGroup = argc > 1 ? (UINT)std::atoi(argv[1]) : 50;
+	auto latency = std::chrono::microseconds(argc > 2 ? std::atoi(argv[2]) : 200);
+
+	const int bursts[] = { 1, 2, 3, 5, 6, 8 };
+
+	std::printf("%u groups of %u windows, per-call latency %lld us\n\n", Groups, perGroup, (long long)latency.count());
+	std::printf("%8s | %20s | %20s\n", "presses", "switch per press", "coalesced");
+	std::printf("%8s | %8s %11s | %8s %11s\n", "", "moves", "ms", "moves", "ms");
+
+	for (auto presses : bursts)
+	{
+		auto a = Run(perGroup, latency, presses, false);
+		auto b = Run(perGroup, latency, presses, true);
+
+		if (a.top != b.top || a.showing != b.showing)
+		{
+			std::fprintf(stderr, "coalesced burst of %d ended somewhere else\n", presses);
+			return 1;
+		}
+
+		std::printf("%8d | %8zu %11.1f | %8zu %11.1f\n", presses, a.moves, a.ms, b.moves, b.ms);
+	}
+
+	return 0;
+}
@@ -0,0 +1,327 @@
+// Window rules compiled into one automaton a field, against trying every
+// rule's pattern on its own, classifying the burst of windows an IDE opens at
+// once. Both have to pick the same rule for every window.
+//
+// Also: the rule syntax, anchors, case and first-rule-wins, and new windows
+// of the simulated shell sorted into their groups as they show. The ones the
+// window filter rules out are never asked for their traits, the ones of a
+// group not on screen are parked with it and stay out of the next capture,
+// and undoing the next command leaves them where they are, as does undoing
+// one from before they were sorted in.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+#include "windowrules.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+	volatile size_t g_Sink;
+
+	// What the compiled rules replace: each pattern looked for in turn
+	size_t MatchEach(const std::vector<WindowRule>& rules, const WindowTraits& traits)
+	{
+		auto fold = [](std::wstring text) {
+			for (auto& c : text)
+				c = c >= L'A' && c <= L'Z' ? wchar_t(c - L'A' + L'a') : c;
+			return text;
+		};
+
+		for (size_t i = 0; i < rules.size(); i++)
+		{
+			const auto& rule = rules[i];
+			const std::wstring* field = &traits.image;
+			switch (rule.field)
+			{
+			case WindowRule::Field::Class: field = &traits.className; break;
+			case WindowRule::Field::AppId: field = &traits.appId; break;
+			case WindowRule::Field::Title: field = &traits.title; break;
+			default: break;
+			}
+
+			std::wstring text = fold(*field);
+			std::wstring pattern = fold(rule.pattern);
+			bool start = !pattern.empty() && pattern.front() == L'^';
+			if (start)
+				pattern.erase(0, 1);
+			bool end = !pattern.empty() && pattern.back() == L'$';
+			if (end)
+				pattern.pop_back();
+
+			bool hit = start && end ? text == pattern
+				: start ? text.starts_with(pattern)
+				: end ? text.ends_with(pattern)
+				: text.find(pattern) != std::wstring::npos;
+			if (hit)
+				return i;
+		}
+		return WindowRules::None;
+	}
+
+	// count rules, the ones that matter last so every rule is tried
+	std::vector<WindowRule> MakeRules(size_t count)
+	{
+		std::vector<WindowRule> rules;
+		for (size_t i = 0; rules.size() + 3 < count; i++)
+		{
+			auto n = std::to_wstring(i);
+			rules.push_back({ WindowRule::Field::Image, L"\\vendor" + n + L"\\tool" + n + L".exe$", L"Other" });
+			rules.push_back({ WindowRule::Field::Class, L"^Widget" + n, L"Other" });
+			rules.push_back({ WindowRule::Field::Title, L"Project " + n + L" - ", L"Other" });
+		}
+		rules.push_back({ WindowRule::Field::AppId, L"^Microsoft.WindowsTerminal", L"Shells" });
+		rules.push_back({ WindowRule::Field::Title, L" - Microsoft Visual Studio", L"Code" });
+		rules.push_back({ WindowRule::Field::Image, L"\\devenv.exe$", L"Code" });
+		return rules;
+	}
+
+	// An IDE opening its tool windows, and a terminal
+	std::vector<WindowTraits> Burst(size_t count)
+	{
+		std::vector<WindowTraits> burst;
+		for (size_t i = 0; i < count; i++)
+		{
+			WindowTraits traits;
+			traits.image = L"C:\\Program Files\\Microsoft Visual Studio\\2022\\Common7\\IDE\\devenv.exe";
+			traits.className = L"HwndWrapper[DefaultDomain;;" + std::to_wstring(i) + L"]";
+			traits.title = L"Tool Window " + std::to_wstring(i);
+			burst.push_back(std::move(traits));
+		}
+		burst.back().image = L"C:\\Program Files\\WindowsApps\\Terminal\\WindowsTerminal.exe";
+		burst.back().appId = L"Microsoft.WindowsTerminal_8wekyb3d8bbwe!App";
+		burst.back().className = L"CASCADIA_HOSTING_WINDOW_CLASS";
+		return burst;
+	}
+
+	int CheckSyntax()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		std::vector<WindowRule> rules;
+		size_t bad = 0;
+		bool parsed = ParseWindowRules(
+			L"# editors\r\n"
+			L"image  \\Code.exe$  -> Code\r\n"
+			L"\n"
+			L"title  ^Inbox - -> Mail\n"
+			L"class  Chrome_WidgetWin -> Web\n"
+			L"appid  ^Fl\u00e4che$ -> Exact\n"
+			L"title  a -> b -> Arrows\n", rules, &bad);
+		check(parsed && rules.size() == 5, "rules not parsed");
+		check(rules.size() == 5 && rules[0].pattern == L"\\Code.exe$" && rules[0].group == L"Code", "image rule misread");
+		check(rules.size() == 5 && rules[4].pattern == L"a -> b" && rules[4].group == L"Arrows", "arrow in a pattern misread");
+
+		std::vector<WindowRule> rejected;
+		check(!ParseWindowRules(L"image x -> A\nwindow y -> B\n", rejected, &bad) && bad == 2 && rejected.size() == 1, "unknown field taken");
+		check(!ParseWindowRules(L"title ^$ -> A\n", rejected, &bad) && bad == 1, "empty pattern taken");
+		check(!ParseWindowRules(L"title x ->\n", rejected, &bad) && bad == 1, "rule without a group taken");
+
+		WindowRules compiled;
+		compiled.Compile(rules);
+
+		auto match = [&compiled](const wchar_t* image, const wchar_t* className, const wchar_t* appId, const wchar_t* title) {
+			WindowTraits traits{ appId, image, className, title };
+			return compiled.Match(traits);
+		};
+
+		check(match(L"C:\\Apps\\VS Code\\CODE.EXE", L"", L"", L"") == 0, "anchored end, other case");
+		check(match(L"C:\\Apps\\Code.exe.bak", L"", L"", L"") == WindowRules::None, "end anchor ignored");
+		check(match(L"", L"", L"", L"Inbox - someone") == 1, "anchored start");
+		check(match(L"", L"", L"", L"Re: Inbox - someone") == WindowRules::None, "start anchor ignored");
+		check(match(L"", L"Chrome_WidgetWin_1", L"", L"Inbox - x") == 1, "first rule doesn't win");
+		check(match(L"", L"", L"fl\u00c4che", L"") == WindowRules::None, "non-ASCII folded");
+		check(match(L"", L"", L"Fl\u00e4che", L"") == 3, "non-ASCII exact");
+		check(match(L"", L"", L"Fl\u00e4che2", L"") == WindowRules::None, "exact matched a longer one");
+		check(match(L"", L"", L"", L"xa -> bx") == 4, "pattern with spaces");
+		check(match(L"", L"", L"", L"") == WindowRules::None, "empty traits matched");
+
+		// a pattern that is a suffix of another, in the middle of a longer one
+		WindowRules overlap;
+		std::vector<WindowRule> nested = {
+			{ WindowRule::Field::Title, L"abcd", L"A" },
+			{ WindowRule::Field::Title, L"bc", L"B" },
+		};
+		overlap.Compile(nested);
+		WindowTraits traits;
+		traits.title = L"xabcx";
+		check(overlap.Match(traits) == 1, "pattern inside a failed longer one missed");
+		traits.title = L"xabcd";
+		check(overlap.Match(traits) == 0, "longer, earlier rule lost");
+
+		return failures;
+	}
+
+	// New windows of the simulated shell sorted into the groups
+	int CheckGroups()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 4;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+
+		// Code at the bottom, Mail on screen
+		NewGroup();
+		RenameGroup(list.mItems[0], L"Code");
+		NewGroup();
+		RenameGroup(list.mItems[0], L"Mail");
+		GroupId code = FindGroup(L"Code");
+		GroupId mail = FindGroup(L"Mail");
+
+		std::vector<WindowRule> rules = {
+			{ WindowRule::Field::Image, L"\\devenv.exe$", L"Code" },
+			{ WindowRule::Field::Title, L"Inbox", L"Mail" },
+			{ WindowRule::Field::Class, L"Nowhere", L"Gone" },
+		};
+		GroupsSetRules(rules);
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+
+		auto open = [&shell](const wchar_t* image, const wchar_t* title, const wchar_t* className = L"SimWindow") {
+			HWND hwnd = shell.AddWindow(shell.CurrentDesktop());
+			WindowTraits traits{ L"", image, className, title };
+			shell.SetWindowTraits(hwnd, traits);
+			return hwnd;
+		};
+
+		std::vector<HWND> ide;
+		for (int i = 0; i < 8; i++)
+			ide.push_back(open(L"C:\\VS\\devenv.exe", L"Tool"));
+		HWND inbox = open(L"C:\\Mail\\mail.exe", L"Inbox - me");
+		HWND stray = open(L"C:\\Other\\other.exe", L"Nothing");
+		HWND nowhere = open(L"C:\\Other\\other.exe", L"Nothing", L"Nowhere");
+
+		// tool windows of the IDE that explorer has no view for
+		for (int i = 0; i < 32; i++)
+		{
+			HWND tool = shell.AddHiddenWindow();
+			WindowBasics basics;
+			basics.visible = true;
+			basics.width = 300;
+			basics.height = 200;
+			basics.exStyle = WS_EX_TOOLWINDOW;
+			shell.SetWindowBasics(tool, basics);
+		}
+		// hidden and shown again before the batch is taken in, classified once
+		shell.SetWindowShown(ide[0], false);
+		shell.SetWindowShown(ide[0], true);
+
+		shell.ResetCalls();
+		shell.PumpNotifications();
+		GroupsTrackWindows();
+
+		const auto& stats = GroupsRuleStats();
+		check(shell.CallCount(SimCall::GetWindowTraits) == 11 && stats.classified == 11, "filtered windows asked for their traits");
+		check(stats.matched == 10 && stats.assigned == 9 && stats.missing == 1, "rules miscounted");
+
+		auto has = [](GroupId id, HWND hwnd) {
+			auto members = GroupMembers(id);
+			return members && std::find(members->begin(), members->end(), hwnd) != members->end();
+		};
+		check(std::all_of(ide.begin(), ide.end(), [&](HWND h) { return has(code, h); }), "IDE windows not in Code");
+		check(has(mail, inbox) && !has(code, inbox), "inbox not in Mail");
+		check(!has(code, stray) && !has(mail, stray) && !has(code, nowhere), "unmatched window assigned");
+
+		// Code isn't on screen, its windows went with it; Mail is
+		int current = (int)shell.CurrentDesktop();
+		check(stats.parked == ide.size(), "parked count off");
+		check(std::none_of(ide.begin(), ide.end(), [&](HWND h) { return shell.WindowDesktop(h) == current; }), "Code window left on screen");
+		check(shell.WindowDesktop(inbox) == current && shell.WindowDesktop(stray) == current, "on screen window moved");
+
+		// the next capture of Mail takes the stray in, not the IDE
+		NewGroup();
+		check(has(mail, stray) && !std::any_of(ide.begin(), ide.end(), [&](HWND h) { return has(mail, h); }), "capture took parked windows");
+
+		// undoing it doesn't undo the sorting, which came before
+		UndoCommand();
+		check(std::all_of(ide.begin(), ide.end(), [&](HWND h) { return has(code, h); }) && has(mail, inbox), "undo took assignments back");
+
+		// nor does undoing Mail's rename, whose state had no inbox yet
+		UndoCommand();
+		check(has(mail, inbox) && !has(mail, stray), "undo across the sorting dropped the inbox");
+		check(std::all_of(ide.begin(), ide.end(), [&](HWND h) { return has(code, h) && shell.WindowDesktop(h) != current; }), "undo across the sorting moved Code's windows");
+		RedoCommand();
+		check(has(mail, inbox) && GroupName(mail) == L"Mail", "redo after the sorting lost the inbox");
+
+		// showing Code brings them up
+		for (size_t i = 0; i < list.mItems.size() && list.mItems[0] != code; i++)
+			MoveGroup(1);
+		check(std::all_of(ide.begin(), ide.end(), [&](HWND h) { return shell.WindowDesktop(h) == (int)shell.CurrentDesktop(); }), "Code's windows not shown");
+
+		GroupsShutdown();
+		return failures;
+	}
+}
+
+int main()
+{
+	constexpr int Rounds = 2000;
+	const size_t burst = 40;
+
+	auto windows = Burst(burst);
+
+	std::printf("%zu windows classified, best of %d rounds\n\n", burst, Rounds);
+	std::printf("%6s | %12s %12s %8s\n", "rules", "compiled us", "each us", "compile us");
+
+	int failures = 0;
+	for (size_t count : { 8u, 64u, 512u })
+	{
+		auto rules = MakeRules(count);
+
+		auto start = std::chrono::steady_clock::now();
+		WindowRules compiled;
+		compiled.Compile(rules);
+		double compileUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		double best[2] = { 1e9, 1e9 };
+		size_t sink = 0;
+		bool same = true;
+		for (int round = 0; round < Rounds; round++)
+		{
+			for (int each = 0; each < 2; each++)
+			{
+				start = std::chrono::steady_clock::now();
+				for (const auto& traits : windows)
+					sink += each ? MatchEach(rules, traits) : compiled.Match(traits);
+				best[each] = std::min(best[each], std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+			}
+		}
+		for (const auto& traits : windows)
+			same = same && compiled.Match(traits) == MatchEach(rules, traits);
+
+		g_Sink = sink;
+		std::printf("%6zu | %12.2f %12.2f %8.1f\n", rules.size(), best[0], best[1], compileUs);
+
+		if (!same || compiled.Match(windows.front()) != rules.size() - 1 || compiled.Match(windows.back()) != rules.size() - 3)
+		{
+			std::fprintf(stderr, "  %zu rules: compiled rules disagree\n", rules.size());
+			++failures;
+		}
+	}
+
+	failures += CheckSyntax();
+	failures += CheckGroups();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+// Cross-process calls per group switch and MoveSwap against the simulated
+// shell, for the per-window path, the desktop cache and the per-command
+// snapshot, as the window count grows.
+
+#include "groups.h"
+#include "simshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	struct Result
+	{
+		double callsPerSwitch;
+		double movesPerSwitch;
+		double usPerSwitch;
+	};
+
+	Result Run(UINT windows, UINT hidden, const GroupsOptions& opts, int switches, void (*op)(), size_t* breakdown = nullptr)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = windows / 2;
+		simOpts.hiddenWindows = hidden;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t* msg) {
+			std::fwprintf(stderr, L"%ls\n", msg);
+		}, opts);
+
+		// Two groups of windows/2 each, the second one showing
+		NewGroup();
+		NewGroup();
+		MoveAllToOther();
+		for (UINT i = 0; i < windows - windows / 2; i++)
+			shell.AddWindow(shell.CurrentDesktop());
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		size_t calls = 0;
+		size_t moves = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < switches; i++)
+		{
+			shell.ResetCalls();
+			op();
+			calls += shell.TotalCalls();
+			moves += shell.CallCount(SimCall::MoveViewToDesktop);
+
+			if (breakdown)
+			{
+				for (size_t c = 0; c < (size_t)SimCall::Count; c++)
+					breakdown[c] += shell.CallCount((SimCall)c);
+			}
+
+			// Notifications are delivered between hotkeys, off the switch
+			shell.PumpNotifications();
+		}
+
+		auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+
+		GroupsShutdown();
+
+		if (moves != (size_t)switches * windows)
+		{
+			std::fprintf(stderr, "unexpected move count %zu for %u windows\n", moves, windows);
+			std::exit(1);
+		}
+
+		return Result{ (double)calls / switches, (double)moves / switches, elapsed.count() / switches };
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int switches = argc > 1 ? std::atoi(argv[1]) : 10;
+	if (switches < 1) switches = 1;
+
+	// EnumWindows also returns every tool, message and hidden window on the
+	// session, a few hundred is typical
+	UINT hidden = argc > 2 ? (UINT)std::atoi(argv[2]) : 200;
+
+	const UINT counts[] = { 10, 50, 100, 250, 500, 1000, 2000 };
+
+	GroupsOptions legacy;
+	legacy.desktopCache = false;
+	legacy.snapshot = false;
+	legacy.desktopRegistry = false;
+	legacy.viewCache = false;
+
+	GroupsOptions cached;
+	cached.snapshot = false;
+
+	GroupsOptions snapshot;
+
+	std::printf("%d switches, %u windows without a view\n\n", switches, hidden);
+	struct Op
+	{
+		const char* name;
+		void (*fn)();
+	};
+
+	const Op ops[] = { { "NextGroup", NextGroup }, { "MoveSwap", MoveSwap } };
+
+	for (const auto& op : ops)
+	{
+		std::printf("%s\n", op.name);
+		std::printf("%8s %8s | %14s %14s %14s | %10s\n",
+			"windows", "moves", "calls/legacy", "calls/cache", "calls/snapshot", "us/snapshot");
+
+		for (auto count : counts)
+		{
+			auto a = Run(count, hidden, legacy, switches, op.fn);
+			auto b = Run(count, hidden, cached, switches, op.fn);
+			auto c = Run(count, hidden, snapshot, switches, op.fn);
+
+			std::printf("%8u %8.0f | %14.0f %14.0f %14.0f | %10.1f\n",
+				count, c.movesPerSwitch, a.callsPerSwitch, b.callsPerSwitch, c.callsPerSwitch, c.usPerSwitch);
+		}
+
+		std::printf("\n");
+	}
+
+	// Where the calls of one switch go with everything on
+	const UINT detail = 200;
+	size_t breakdown[(size_t)SimCall::Count] = {};
+	Run(detail, hidden, snapshot, switches, NextGroup, breakdown);
+
+	std::printf("NextGroup calls by kind, %u windows\n", detail);
+	for (size_t c = 0; c < (size_t)SimCall::Count; c++)
+	{
+		if (breakdown[c])
+			std::printf("%40ls %8.0f\n", SimShell::CallName((SimCall)c), (double)breakdown[c] / switches);
+	}
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+// Saving and loading the group stack: hundreds of groups over thousands of
+// windows written with GroupsSave, then read back through the mapping with
+// GroupsLoad. Checks that what comes back matches, that after every
+// application restarted the groups find the new windows, that closed windows
+// and reused handles are dropped and that a damaged file is refused.
+//
+//   storebench [windows] [groups] [file]
+
+#include "groups.h"
+#include "simshell.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	void Fail(const char* what)
+	{
+		std::fprintf(stderr, "%s\n", what);
+		std::exit(1);
+	}
+
+	std::uint64_t Key(HWND hWin)
+	{
+		return (std::uint64_t)(std::uintptr_t)hWin * 31 + 7;
+	}
+
+	// Every group with its members, top first
+	std::vector<std::pair<std::wstring, std::vector<HWND>>> Collect(const VectorGroupList& list)
+	{
+		std::vector<std::pair<std::wstring, std::vector<HWND>>> groups;
+		for (auto id : list.mItems)
+		{
+			auto members = GroupMembers(id);
+			groups.emplace_back(GroupName(id), members ? *members : std::vector<HWND>());
+		}
+		return groups;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT windows = argc > 1 ? (UINT)std::atoi(argv[1]) : 5000;
+	UINT groups = argc > 2 ? (UINT)std::atoi(argv[2]) : 200;
+	std::string file = argc > 3 ? argv[3] : "storebench-groups.bin";
+
+	SimShellOptions simOpts;
+	simOpts.desktops = 2;
+	simOpts.windows = windows / groups;
+
+	SimShell shell(simOpts);
+	VectorGroupList list;
+
+	GroupsInit(&shell, &list, nullptr, nullptr);
+
+	NewGroup();
+	for (UINT g = 1; g < groups; g++)
+	{
+		NewGroup();
+		MoveAllToOther();
+		for (UINT i = 0; i < windows / groups; i++)
+			shell.AddWindow(shell.CurrentDesktop());
+	}
+	MoveGroup(1);
+	shell.PumpNotifications();
+
+	auto saved = Collect(list);
+
+	// the first save asks every window what it is, the ones after don't
+	shell.ResetCalls();
+	auto start = std::chrono::steady_clock::now();
+	if (!GroupsSave(file.c_str(), list.mItems, Key))
+		Fail("save failed");
+	auto firstSaveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	size_t firstSaveCalls = shell.TotalCalls();
+
+	shell.ResetCalls();
+	start = std::chrono::steady_clock::now();
+	if (!GroupsSave(file.c_str(), list.mItems, Key))
+		Fail("save failed");
+	auto saveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (shell.TotalCalls() != 0)
+		Fail("second save asked the shell again");
+
+	GroupsShutdown();
+
+	// what a fresh start does: init, then load
+	std::vector<double> loads;
+	for (int i = 0; i < 20; i++)
+	{
+		VectorGroupList fresh;
+		GroupsInit(&shell, &fresh, nullptr, nullptr);
+		shell.ResetCalls();
+
+		start = std::chrono::steady_clock::now();
+		if (!GroupsLoad(file.c_str(), Key))
+			Fail("load failed");
+		loads.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+		if (Collect(fresh) != saved)
+			Fail("loaded groups differ from the saved ones");
+		if (shell.TotalCalls() != 1)
+			Fail("load made more than the one enumeration");
+
+		GroupsShutdown();
+	}
+
+	std::sort(loads.begin(), loads.end());
+	double loadMs = loads[loads.size() / 2];
+
+	std::printf("%u windows in %u groups, %zu bytes\n", windows, groups,
+		(size_t)std::ifstream(file, std::ios::binary | std::ios::ate).tellg());
+	std::printf("first save %.3f ms (%zu calls), save %.3f ms, load %.3f ms (median of %zu)\n",
+		firstSaveMs, firstSaveCalls, saveMs, loadMs, loads.size());
+
+	// every application restarted, a tenth of them with a changed title
+	{
+		std::unordered_map<HWND, HWND> reopened;
+		size_t n = 0;
+		for (const auto& [name, members] : saved)
+		{
+			for (auto hWin : members)
+			{
+				HWND now = shell.ReopenWindow(hWin);
+				if (n++ % 10 == 0)
+				{
+					WindowTraits traits;
+					shell.GetWindowTraits(now, traits);
+					traits.title += L" (edited)";
+					shell.SetWindowTraits(now, traits);
+				}
+				reopened[hWin] = now;
+			}
+		}
+
+		VectorGroupList fresh;
+		GroupsInit(&shell, &fresh, nullptr, nullptr);
+		shell.ResetCalls();
+
+		start = std::chrono::steady_clock::now();
+		if (!GroupsLoad(file.c_str(), Key))
+			Fail("load failed");
+		auto restartMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		for (auto& [name, members] : saved)
+		{
+			for (auto& hWin : members)
+				hWin = reopened[hWin];
+		}
+		if (Collect(fresh) != saved)
+			Fail("groups didn't find the reopened windows");
+
+		std::printf("after a restart of every window: load %.3f ms (%zu calls)\n", restartMs, shell.TotalCalls());
+
+		if (!GroupsSave(file.c_str(), fresh.mItems, Key))
+			Fail("save failed");
+		GroupsShutdown();
+	}
+
+	// a closed window and a reused handle are both dropped
+	{
+		HWND closed = saved[0].second.at(0);
+		shell.CloseWindow(closed);
+
+		// the handle went to another application's window
+		HWND reused = saved[1].second.at(0);
+		WindowTraits other;
+		other.appId = L"Other.App";
+		other.title = L"Something else";
+		shell.SetWindowTraits(reused, other);
+
+		VectorGroupList fresh;
+		GroupsInit(&shell, &fresh, nullptr, nullptr);
+		if (!GroupsLoad(file.c_str(), [reused](HWND hWin) { return hWin == reused ? 1 : Key(hWin); }))
+			Fail("load failed");
+
+		auto top = GroupMembers(FindGroup(saved[0].first));
+		auto second = GroupMembers(FindGroup(saved[1].first));
+		if (!top || std::ranges::find(*top, closed) != top->end() || top->size() != saved[0].second.size() - 1)
+			Fail("closed window came back");
+		if (!second || std::ranges::find(*second, reused) != second->end())
+			Fail("reused handle came back");
+
+		GroupsShutdown();
+	}
+
+	// a damaged file is refused as a whole
+	{
+		std::fstream f(file, std::ios::binary | std::ios::in | std::ios::out);
+		f.seekp(-3, std::ios::end);
+		f.put('!');
+	}
+	{
+		VectorGroupList fresh;
+		GroupsInit(&shell, &fresh, nullptr, nullptr);
+		if (GroupsLoad(file.c_str(), Key) || !fresh.mItems.empty())
+			Fail("damaged file was loaded");
+		GroupsShutdown();
+	}
+
+	std::remove(file.c_str());
+
+	if (loadMs > 5)
+		Fail("load over the 5 ms budget");
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+// Group switches with explorer failing part way through. A move failing once
+// has to be retried and the switch finish as if nothing happened; a window
+// that can't be moved at all has to get the switch taken back, every window
+// where it was before and the stack unrotated. Either way the windows have to
+// end up where the group stack says they should.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "simshell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+	constexpr UINT Groups = 4;
+
+	enum class Fault
+	{
+		None,
+		Once,   // the k'th move of the switch fails, the retry goes through
+		Always, // the k'th window to move can't be moved at all
+	};
+
+	const char* Name(Fault fault)
+	{
+		switch (fault)
+		{
+		case Fault::None: return "none";
+		case Fault::Once: return "once";
+		case Fault::Always: return "always";
+		default: return "?";
+		}
+	}
+
+	struct Result
+	{
+		std::vector<int> before;   // desktop of every window before the switch
+		std::vector<int> after;
+		std::vector<GroupId> stackBefore;
+		std::vector<GroupId> stackAfter;
+		SwitchReport report;
+		size_t moves = 0;
+		size_t reports = 0;
+		double ms = 0;
+	};
+
+	std::vector<int> Placement(const SimShell& shell)
+	{
+		std::vector<int> at(shell.WindowCount());
+		for (size_t i = 0; i < at.size(); i++)
+			at[i] = shell.WindowDesktop(shell.WindowAt(i));
+		return at;
+	}
+
+	Result Run(UINT perGroup, Fault fault, size_t k)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		Result r;
+		GroupsInit(&shell, &list, nullptr, [&r](const wchar_t*) {
+			++r.reports;
+		});
+
+		NewGroup();
+		for (UINT g = 1; g < Groups; g++)
+		{
+			NewGroup();
+			MoveAllToOther();
+			for (UINT i = 0; i < perGroup; i++)
+				shell.AddWindow(shell.CurrentDesktop());
+		}
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		// the group coming on screen is shown first, its k'th window is the
+		// k'th move
+		if (fault == Fault::Once)
+			shell.FailCall(SimCall::MoveViewToDesktop, k);
+		else if (fault == Fault::Always)
+		{
+			GroupId next = NoGroup;
+			list.GetAt(1, next);
+			auto members = GroupMembers(next);
+			if (!members || k >= members->size())
+			{
+				std::fprintf(stderr, "no window %zu to fail\n", k);
+				std::exit(1);
+			}
+			shell.FailMoves((*members)[k]);
+		}
+
+		r.before = Placement(shell);
+		r.stackBefore = list.mItems;
+		shell.ResetCalls();
+
+		auto start = std::chrono::steady_clock::now();
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		shell.PumpNotifications();
+		r.moves = shell.CallCount(SimCall::MoveViewToDesktop);
+		r.after = Placement(shell);
+		r.stackAfter = list.mItems;
+		r.report = GroupsLastSwitch();
+
+		GroupsShutdown();
+		return r;
+	}
+
+	size_t Count(const std::vector<MoveOutcome>& outcomes, MoveResult result)
+	{
+		size_t n = 0;
+		for (const auto& out : outcomes)
+			n += out.result == result;
+		return n;
+	}
+}
+
+int main()
+{
+	std::printf("one group switch, %u groups, failures injected into MoveViewToDesktop\n\n", Groups);
+	std::printf("%6s %7s %5s | %9s %7s %7s %9s %6s %8s\n", "n", "fault", "k", "committed", "retried", "failed", "rollback", "moves", "ms");
+
+	int failures = 0;
+	for (UINT perGroup : { 8u, 200u })
+	{
+		auto clean = Run(perGroup, Fault::None, 0);
+
+		for (auto fault : { Fault::None, Fault::Once, Fault::Always })
+		{
+			for (size_t k : { (size_t)0, (size_t)perGroup / 2, (size_t)perGroup - 1 })
+			{
+				if (fault == Fault::None && k)
+					continue;
+
+				auto r = Run(perGroup, fault, k);
+
+				std::printf("%6u %7s %5zu | %9s %7zu %7zu %9zu %6zu %8.3f\n", perGroup, Name(fault), k,
+					r.report.committed ? "yes" : "no", r.report.retried, Count(r.report.outcomes, MoveResult::Failed),
+					r.report.rollback.size(), r.moves, r.ms);
+
+				// a switch that went through looks like one that never failed,
+				// one that didn't leaves everything as it was
+				bool ok = fault == Fault::Always
+					? !r.report.committed && r.after == r.before && r.stackAfter == r.stackBefore && r.reports == 1
+					: r.report.committed && r.after == clean.after && r.stackAfter == clean.stackAfter && r.reports == 0;
+				if (!ok)
+				{
+					std::fprintf(stderr, "  windows or stack wrong after fault %s at %zu\n", Name(fault), k);
+					++failures;
+				}
+			}
+		}
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+// Cost of a TRACE_SCOPE with tracing off and on, then a traced group switch
+// against the simulated shell with a move pool, written as Chrome trace JSON
+// to the path given on the command line.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "movepool.h"
+#include "simshell.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+	double NsPerScope(int count)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++)
+		{
+			TRACE_SCOPE("bench");
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+		return elapsed.count() / count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	constexpr int Scopes = 2000000;
+
+	TraceEnable(false);
+	double off = NsPerScope(Scopes);
+	TraceEnable(true);
+	double on = NsPerScope(Scopes);
+	TraceClear();
+
+	std::printf("ns per scope: %.2f off, %.2f on, ring of %zu spans\n", off, on, TraceCapacity());
+
+	TraceThreadName("commands");
+
+	SimShellOptions simOpts;
+	simOpts.desktops = 2;
+	simOpts.windows = 40;
+	simOpts.hiddenWindows = 20;
+
+	SimShell shell(simOpts);
+	VectorGroupList list;
+	GroupsInit(&shell, &list, nullptr, nullptr);
+
+	NewGroup();
+	NewGroup();
+	MoveAllToOther();
+	for (int i = 0; i < 40; i++)
+		shell.AddWindow(shell.CurrentDesktop());
+	MoveGroup(1);
+	shell.PumpNotifications();
+
+	MovePool pool;
+	pool.Start(4, [&shell]() -> IShellBackend* {
+		TraceThreadName("move pool");
+		return &shell;
+	}, nullptr);
+	GroupsSetMovePool(&pool);
+
+	shell.SetCallLatency(std::chrono::microseconds(200));
+
+	TraceClear();
+	RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+	shell.PumpNotifications();
+
+	pool.Stop();
+	GroupsShutdown();
+
+	std::ostringstream json;
+	size_t spans = TraceWriteChrome(json);
+	std::printf("traced NextGroup: %zu spans, %zu bytes of json\n", spans, json.str().size());
+
+	if (spans == 0 || json.str().find("\"name\":\"Group\"") == std::string::npos)
+	{
+		std::fprintf(stderr, "command span missing from the trace\n");
+		return 1;
+	}
+
+	if (argc > 1 && !TraceWriteChromeFile(argv[1]))
+	{
+		std::fprintf(stderr, "could not write %s\n", argv[1]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,266 @@
+// View lookups of repeated switches between the same groups, with and without
+// the view cache, for the per-window path and the per-command snapshot. Once
+// every window was seen a switch has to resolve no view at all. A closed
+// window has to leave the cache with its destroy event, or without one at
+// the next resync, and a move that fails has to take the view with it.
+//
+// The same with the move pool on, as the app runs: the pool threads get the
+// views the cache holds and only look up the ones it doesn't, and a move
+// failing on a pool thread evicts the view too.
+//
+// A batch move outside a command only snapshots the windows when the cache
+// is missing a view.
+
+#include "commandqueue.h"
+#include "groups.h"
+#include "movepool.h"
+#include "simshell.h"
+#include "viewcache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+	constexpr int Switches = 10;
+	constexpr UINT PoolThreads = 4;
+
+	struct Result
+	{
+		size_t lookups = 0;  // after the first switch
+		size_t calls = 0;
+		double ms = 0;
+		bool placed = true;
+	};
+
+	size_t Lookups(const SimShell& shell)
+	{
+		return shell.CallCount(SimCall::GetViewForHwnd) + shell.CallCount(SimCall::ViewGetThumbnailWindow);
+	}
+
+	void Setup(SimShell& shell, UINT perGroup)
+	{
+		NewGroup();
+		NewGroup();
+		MoveAllToOther();
+		for (UINT i = 0; i < perGroup; i++)
+			shell.AddWindow(shell.CurrentDesktop());
+		MoveGroup(1);
+		shell.PumpNotifications();
+	}
+
+	Result Run(UINT perGroup, bool snapshot, bool viewCache, UINT threads, std::chrono::microseconds latency)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = perGroup;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsOptions opts;
+		opts.snapshot = snapshot;
+		opts.viewCache = viewCache;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+
+		MovePool pool;
+		if (threads)
+		{
+			pool.Start(threads, [&shell]() -> IShellBackend* { return &shell; }, nullptr);
+			GroupsSetMovePool(&pool);
+		}
+
+		Setup(shell, perGroup);
+
+		// every window's view seen once
+		RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+		shell.PumpNotifications();
+
+		shell.ResetCalls();
+		shell.SetCallLatency(latency);
+
+		Result r;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Switches; i++)
+		{
+			RunQueuedCommand(QueuedCommand{ Command::Group, 1 });
+			shell.PumpNotifications();
+		}
+		r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / Switches;
+
+		shell.SetCallLatency(std::chrono::microseconds(0));
+		r.lookups = Lookups(shell);
+		r.calls = shell.TotalCalls() / Switches;
+
+		auto members = GroupMembers(list.mItems[0]);
+		r.placed = members && members->size() == perGroup;
+		for (HWND hwnd : members ? *members : std::vector<HWND>())
+			r.placed = r.placed && shell.WindowDesktop(hwnd) == (int)shell.CurrentDesktop();
+
+		GroupsShutdown();
+		pool.Stop();
+		return r;
+	}
+
+	// Closed windows and failed moves leave the cache
+	int CheckEviction()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 8;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsOptions opts;
+		opts.snapshot = false;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {}, opts);
+		Setup(shell, 8);
+
+		auto& views = GroupsViewCache();
+		check(views.Watching(), "no destroy events");
+		check(views.Size() == 16, "not every window's view cached");
+
+		// explorer says the window is gone
+		shell.CloseWindow(shell.WindowAt(0));
+		shell.PumpNotifications();
+		check(views.Size() == 15 && views.GetStats().evicted == 1, "destroyed window kept");
+
+		// the event never comes, the resync finds it
+		shell.SetNotificationsEnabled(false);
+		shell.CloseWindow(shell.WindowAt(1));
+		shell.PumpNotifications();
+		check(views.Size() == 15, "dropped event evicted anyway");
+		GroupsResync();
+		check(views.Size() == 14 && views.GetStats().evicted == 2, "resync kept a closed window");
+		shell.SetNotificationsEnabled(true);
+
+		// a move that fails takes the view along, the next one asks again
+		HWND stuck = shell.WindowAt(2);
+		shell.FailMoves(stuck);
+		MoveToScratch(stuck, FALSE);
+		check(views.Size() == 13 && views.GetStats().evicted == 3, "failed move kept its view");
+		shell.ClearFailures();
+
+		shell.ResetCalls();
+		MoveToScratch(stuck, FALSE);
+		check(shell.CallCount(SimCall::GetViewForHwnd) == 1 && views.Size() == 14, "view not looked up again");
+
+		// on the pool, a batch of the cached windows moves without a lookup
+		// and the one that fails still takes its view along
+		MovePool pool;
+		pool.Start(PoolThreads, [&shell]() -> IShellBackend* { return &shell; }, nullptr);
+		GroupsSetMovePool(&pool);
+
+		std::vector<HWND> batch = { shell.WindowAt(3), shell.WindowAt(4), shell.WindowAt(5) };
+		shell.FailMoves(batch[1]);
+		shell.ResetCalls();
+
+		std::vector<MoveOutcome> results;
+		GUID away = shell.DesktopId(shell.WindowDesktop(batch[0]) == 0 ? 1 : 0);
+		MoveWindowsToDesktop(batch, away, results);
+		check(shell.CallCount(SimCall::GetViewForHwnd) == 0, "pool looked up cached views");
+		check(results.size() == 3 && results[1].result == MoveResult::Failed && results[0].result == MoveResult::Moved, "pool moves misreported");
+		check(views.Size() == 13 && views.GetStats().evicted == 4, "failed pool move kept its view");
+		shell.ClearFailures();
+
+		// and a window the cache didn't have comes back from the pool into it
+		views.Forget(batch[0]);
+		shell.ResetCalls();
+		MoveWindowsToDesktop(batch, shell.DesktopId(shell.CurrentDesktop()), results);
+		// the one that failed never left, only the forgotten one is looked up
+		check(shell.CallCount(SimCall::GetViewForHwnd) == 1 && views.Size() == 13, "pool's view not cached");
+
+		GroupsShutdown();
+		pool.Stop();
+		return failures;
+	}
+
+	// A batch of windows the caches know moves without a snapshot, one the
+	// view cache lost a window of takes one
+	int CheckBatchSnapshot()
+	{
+		int failures = 0;
+		auto check = [&failures](bool ok, const char* what) {
+			if (ok)
+				return;
+			std::fprintf(stderr, "  %s\n", what);
+			++failures;
+		};
+
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = 8;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t*) {});
+		Setup(shell, 8);
+
+		auto& views = GroupsViewCache();
+		std::vector<HWND> batch = *GroupMembers(list.mItems[0]);
+		GUID away = shell.DesktopId(shell.CurrentDesktop() == 0 ? 1 : 0);
+		GUID back = shell.DesktopId(shell.CurrentDesktop());
+
+		std::vector<MoveOutcome> results;
+		shell.ResetCalls();
+		MoveWindowsToDesktop(batch, away, results);
+		check(shell.CallCount(SimCall::GetViewsByZOrder) == 0 && Lookups(shell) == 0, "batch of cached windows looked them up");
+		check(shell.CallCount(SimCall::MoveViewToDesktop) == batch.size(), "batch of cached windows not moved");
+
+		views.Forget(batch[0]);
+		shell.ResetCalls();
+		MoveWindowsToDesktop(batch, back, results);
+		check(shell.CallCount(SimCall::GetViewsByZOrder) == 1, "batch missing a view took no snapshot");
+		check(shell.CallCount(SimCall::MoveViewToDesktop) == batch.size(), "batch missing a view not moved");
+
+		GroupsShutdown();
+		return failures;
+	}
+}
+
+int main()
+{
+	const auto latency = std::chrono::microseconds(50);
+
+	std::printf("%d switches between two groups, %lld us a call\n\n", Switches, (long long)latency.count());
+	std::printf("%6s %9s %6s %5s | %8s %12s %9s\n", "n", "path", "cache", "pool", "lookups", "calls/switch", "ms/switch");
+
+	int failures = 0;
+	for (UINT perGroup : { 10u, 100u, 500u })
+	{
+		for (UINT threads : { 0u, PoolThreads })
+		{
+			for (bool snapshot : { false, true })
+			{
+				for (bool viewCache : { false, true })
+				{
+					auto r = Run(perGroup, snapshot, viewCache, threads, latency);
+
+					std::printf("%6u %9s %6s %5u | %8zu %12zu %9.3f\n", perGroup, snapshot ? "snapshot" : "window",
+						viewCache ? "yes" : "no", threads, r.lookups, r.calls, r.ms);
+
+					if (!r.placed || (viewCache && r.lookups != 0))
+					{
+						std::fprintf(stderr, "  %u windows a group, %s%s%s: %s\n", perGroup, snapshot ? "snapshot" : "per window",
+							viewCache ? ", cached" : "", threads ? ", pool" : "", r.placed ? "views looked up again" : "group not on screen");
+						++failures;
+					}
+				}
+			}
+		}
+	}
+
+	failures += CheckEviction();
+	failures += CheckBatchSnapshot();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// One group switch against a simulated shell with a delay on every call, run
+// inline on the UI thread the way the hotkey loop used to and posted to the
+// command worker. Reports how long the UI thread is held, how long until the
+// first window of the new group is on screen, and until the switch is done.
+
+#include "groups.h"
+#include "simshell.h"
+#include "worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	struct Result
+	{
+		double uiMs;
+		double firstMs;
+		double doneMs;
+	};
+
+	double Ms(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+	Result Run(UINT windows, std::chrono::microseconds latency, bool worker)
+	{
+		SimShellOptions simOpts;
+		simOpts.desktops = 2;
+		simOpts.windows = windows / 2;
+
+		SimShell shell(simOpts);
+		VectorGroupList list;
+
+		GroupsInit(&shell, &list, nullptr, [](const wchar_t* msg) {
+			std::fwprintf(stderr, L"%ls\n", msg);
+		});
+
+		// Two groups of windows/2 each, the second one showing
+		NewGroup();
+		NewGroup();
+		MoveAllToOther();
+		for (UINT i = 0; i < windows - windows / 2; i++)
+			shell.AddWindow(shell.CurrentDesktop());
+		MoveGroup(1);
+		shell.PumpNotifications();
+
+		std::atomic<Clock::rep> first{ 0 };
+		shell.OnMove([&shell, &first](HWND, UINT desktop) {
+			Clock::rep none = 0;
+			if (desktop == shell.CurrentDesktop())
+				first.compare_exchange_strong(none, Clock::now().time_since_epoch().count());
+		});
+
+		shell.SetCallLatency(latency);
+		shell.ResetCalls();
+
+		CommandWorker commands;
+		commands.Start([]() { return true; }, nullptr);
+
+		std::promise<Clock::time_point> finished;
+		auto done = finished.get_future();
+
+		auto start = Clock::now();
+
+		if (worker)
+		{
+			commands.Post([&finished]() {
+				MoveGroup(1);
+				finished.set_value(Clock::now());
+			});
+		}
+		else
+		{
+			MoveGroup(1);
+			finished.set_value(Clock::now());
+		}
+
+		auto released = Clock::now();
+		auto end = done.get();
+
+		commands.Stop();
+
+		size_t moves = shell.CallCount(SimCall::MoveViewToDesktop);
+
+		shell.OnMove(nullptr);
+		GroupsShutdown();
+
+		if (moves != windows)
+		{
+			std::fprintf(stderr, "unexpected move count %zu for %u windows\n", moves, windows);
+			std::exit(1);
+		}
+
+		auto shown = Clock::time_point(Clock::duration(first.load()));
+		return Result{ Ms(start, released), Ms(start, shown), Ms(start, end) };
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto latency = std::chrono::microseconds(argc > 1 ? std::atoi(argv[1]) : 1000);
+
+	const UINT counts[] = { 10, 50, 150, 500 };
+
+	std::printf("per-call latency %lld us, one NextGroup, times in ms\n\n", (long long)latency.count());
+	std::printf("%8s | %28s | %28s\n", "windows", "inline on the UI thread", "command worker");
+	std::printf("%8s | %8s %9s %9s | %8s %9s %9s\n",
+		"", "UI held", "first", "done", "UI held", "first", "done");
+
+	for (auto count : counts)
+	{
+		auto a = Run(count, latency, false);
+		auto b = Run(count, latency, true);
+
+		std::printf("%8u | %8.2f %9.2f %9.2f | %8.3f %9.2f %9.2f\n",
+			count, a.uiMs, a.firstMs, a.doneMs, b.uiMs, b.firstMs, b.doneMs);
+	}
+
+	return 0;
+}
@@ -0,0 +1,132 @@
+#include "commandqueue.h"
+#include "groups.h"
+#include "trace.h"
+
+namespace {
+	bool IsRotation(Command cmd)
+	{
+		return cmd == Command::Group || cmd == Command::Desktop;
+	}
+}
+
+bool CommandQueue::Push(const QueuedCommand& cmd)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	++m_Stats.pushed;
+
+	bool wasEmpty = m_Pending.empty();
+
+	if (IsRotation(cmd.cmd) && !wasEmpty && m_Pending.back().cmd == cmd.cmd && m_Pending.back().monitor == cmd.monitor)
+		m_Pending.back().steps += cmd.steps;
+	else
+		m_Pending.push_back(cmd);
+
+	return wasEmpty;
+}
+
+void CommandQueue::Take(std::vector<QueuedCommand>& cmds)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	for (const auto& cmd : m_Pending)
+	{
+		if (IsRotation(cmd.cmd) && cmd.steps == 0)
+			continue;
+		cmds.push_back(cmd);
+		++m_Stats.taken;
+	}
+
+	m_Pending.clear();
+}
+
+CommandQueue::Stats CommandQueue::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	return m_Stats;
+}
+
+const char* CommandName(Command cmd)
+{
+	switch (cmd)
+	{
+	case Command::MoveAway: return "MoveAway";
+	case Command::MoveAllAway: return "MoveAllAway";
+	case Command::MoveBack: return "MoveBack";
+	case Command::MoveSwap: return "MoveSwap";
+	case Command::RestoreTo: return "RestoreTo";
+	case Command::Desktop: return "Desktop";
+	case Command::Group: return "Group";
+	case Command::NewGroup: return "NewGroup";
+	case Command::DeleteGroup: return "DeleteGroup";
+	case Command::UnionGroups: return "UnionGroups";
+	case Command::IntersectGroups: return "IntersectGroups";
+	case Command::SubtractGroups: return "SubtractGroups";
+	case Command::Undo: return "Undo";
+	case Command::Redo: return "Redo";
+	default: return "?";
+	}
+}
+
+void RunQueuedCommand(const QueuedCommand& cmd)
+{
+	TraceScope trace(CommandName(cmd.cmd));
+
+	switch (cmd.cmd)
+	{
+	case Command::MoveAway:
+		MoveToScratch(cmd.hwnd, TRUE);
+		break;
+	case Command::MoveAllAway:
+		MoveAllToOther();
+		break;
+	case Command::MoveBack:
+		MoveBackFromOther();
+		break;
+	case Command::MoveSwap:
+		MoveSwap();
+		break;
+	case Command::RestoreTo:
+		RestoreScratched();
+		break;
+	case Command::Desktop:
+		MoveDesktop(cmd.steps);
+		break;
+	case Command::Group:
+		SwitchToAnchorDesktop();
+		MoveGroup(cmd.steps, cmd.monitor);
+		break;
+	case Command::NewGroup:
+		NewGroup(cmd.monitor);
+		break;
+	case Command::DeleteGroup:
+		DeleteGroup(cmd.monitor);
+		break;
+	case Command::UnionGroups:
+		CombineTopGroups(SetOp::Union, cmd.monitor);
+		break;
+	case Command::IntersectGroups:
+		CombineTopGroups(SetOp::Intersect, cmd.monitor);
+		break;
+	case Command::SubtractGroups:
+		CombineTopGroups(SetOp::Difference, cmd.monitor);
+		break;
+	case Command::Undo:
+		UndoCommand();
+		break;
+	case Command::Redo:
+		RedoCommand();
+		break;
+	}
+}
+
+void DrainCommands(CommandQueue& queue)
+{
+	TRACE_SCOPE("DrainCommands");
+
+	std::vector<QueuedCommand> cmds;
+	queue.Take(cmds);
+
+	for (const auto& cmd : cmds)
+		RunQueuedCommand(cmd);
+}
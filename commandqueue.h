@@ -0,0 +1,70 @@
+#pragma once
+
+#include "platform.h"
+
+#include <mutex>
+#include <vector>
+
+// Everything a hotkey can ask for. Group and Desktop are rotations, their
+// steps say how far and which way.
+enum class Command
+{
+	MoveAway,
+	MoveAllAway,
+	MoveBack,
+	MoveSwap,
+	RestoreTo,
+	Desktop,
+	Group,
+	NewGroup,
+	DeleteGroup,
+	UnionGroups,      // the top two groups, into a new one
+	IntersectGroups,
+	SubtractGroups,
+	Undo,
+	Redo,
+};
+
+struct QueuedCommand
+{
+	Command cmd;
+	int steps = 0;        // Group and Desktop
+	HWND hwnd = nullptr;  // MoveAway, the window that was in front
+	HMONITOR monitor = nullptr; // the group commands, whose stack, null for the whole one
+};
+
+// Hotkeys waiting for the command worker. A rotation queued right behind
+// another of the same kind, on the same stack, is folded into it, so ALT+1 pressed five times
+// while a switch is running costs one more switch, to the group five along,
+// instead of five. Anything else keeps its place and its order.
+class CommandQueue
+{
+public:
+	struct Stats
+	{
+		size_t pushed = 0;
+		size_t taken = 0;
+	};
+
+	// Any thread. True when the queue was empty, the caller then has to get a
+	// Drain scheduled; otherwise one already is.
+	bool Push(const QueuedCommand& cmd);
+
+	// Hands over everything queued, rotations that came to nothing left out
+	void Take(std::vector<QueuedCommand>& cmds);
+
+	Stats GetStats() const;
+
+private:
+	mutable std::mutex m_Lock;
+	std::vector<QueuedCommand> m_Pending;
+	Stats m_Stats;
+};
+
+const char* CommandName(Command cmd);
+
+// Runs one command against the group state, on the thread that owns it
+void RunQueuedCommand(const QueuedCommand& cmd);
+
+// Takes and runs everything queued
+void DrainCommands(CommandQueue& queue);
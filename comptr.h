@@ -0,0 +1,78 @@
+#pragma once
+
+#include "platform.h"
+
+#include <utility>
+
+// Owning reference to a COM interface, released when it goes away.
+template<typename T>
+class com_ptr
+{
+public:
+	com_ptr() = default;
+
+	com_ptr(const com_ptr& other)
+		: p(other.p)
+	{
+		if (p) p->AddRef();
+	}
+
+	com_ptr(com_ptr&& other) noexcept
+		: p(std::exchange(other.p, nullptr))
+	{
+	}
+
+	~com_ptr()
+	{
+		Reset();
+	}
+
+	com_ptr& operator=(com_ptr other) noexcept
+	{
+		std::swap(p, other.p);
+		return *this;
+	}
+
+	// Takes over a reference a COM call already handed out
+	static com_ptr Attach(T* raw)
+	{
+		com_ptr r;
+		r.p = raw;
+		return r;
+	}
+
+	// Shares a pointer someone else owns
+	static com_ptr Copy(T* raw)
+	{
+		if (raw) raw->AddRef();
+		return Attach(raw);
+	}
+
+	void Reset()
+	{
+		if (p)
+		{
+			std::exchange(p, nullptr)->Release();
+		}
+	}
+
+	// Hands the reference over, for out params of our own
+	T* Detach()
+	{
+		return std::exchange(p, nullptr);
+	}
+
+	// For out params, drops whatever was held first
+	T** Put()
+	{
+		Reset();
+		return &p;
+	}
+
+	T* Get() const { return p; }
+	T* operator->() const { return p; }
+	explicit operator bool() const { return p != nullptr; }
+
+private:
+	T* p = nullptr;
+};
@@ -0,0 +1,421 @@
+#include "comshell.h"
+#include "trace.h"
+
+namespace {
+	BOOL CALLBACK EnumCollect(HWND hwnd, LPARAM lparam)
+	{
+		std::vector<HWND>& wins = *(std::vector<HWND>*)lparam;
+		wins.push_back(hwnd);
+		return TRUE;
+	}
+
+	// Out of context hooks call back on the thread that set them, where the
+	// shell that set it lives
+	thread_local ComShell* t_Hooked = nullptr;
+}
+
+ComShell::~ComShell()
+{
+	if (hWindowHook)
+	{
+		UnhookWinEvent(hWindowHook);
+		hWindowHook = NULL;
+		t_Hooked = nullptr;
+	}
+	if (pNotificationService)
+	{
+		pNotificationService->Release();
+		pNotificationService = NULL;
+	}
+	if (pDesktopManagerInternal)
+	{
+		pDesktopManagerInternal->Release();
+		pDesktopManagerInternal = NULL;
+	}
+	if (pDesktopManager)
+	{
+		pDesktopManager->Release();
+		pDesktopManager = NULL;
+	}
+	if (viewCollection)
+	{
+		viewCollection->Release();
+		viewCollection = NULL;
+	}
+	if (pServiceProvider)
+	{
+		pServiceProvider->Release();
+		pServiceProvider = NULL;
+	}
+	if (comInit)
+	{
+		CoUninitialize();
+		comInit = false;
+	}
+}
+
+bool ComShell::Init(DWORD apartment)
+{
+	if (!SUCCEEDED(::CoInitializeEx(NULL, apartment)))
+	{
+		return false;
+	}
+
+	comInit = true;
+
+	if (!SUCCEEDED(::CoCreateInstance(CLSID_ImmersiveShell, NULL, CLSCTX_LOCAL_SERVER, __uuidof(IServiceProvider), (PVOID*)&pServiceProvider)))
+	{
+		return false;
+	}
+
+	if (!SUCCEEDED(pServiceProvider->QueryService(__uuidof(IApplicationViewCollection), &viewCollection)))
+	{
+		return false;
+	}
+
+	if (!SUCCEEDED(pServiceProvider->QueryService(__uuidof(IVirtualDesktopManager), &pDesktopManager)))
+	{
+		return false;
+	}
+
+	if (!SUCCEEDED(pServiceProvider->QueryService(CLSID_VirtualDesktopManagerInternal, __uuidof(IVirtualDesktopManagerInternal), (PVOID*)&pDesktopManagerInternal)))
+	{
+		return false;
+	}
+
+	// Optional, without it the desktop cache falls back to asking every time
+	if (!SUCCEEDED(pServiceProvider->QueryService(CLSID_IVirtualNotificationService, __uuidof(IVirtualDesktopNotificationService), (PVOID*)&pNotificationService)))
+	{
+		pNotificationService = NULL;
+	}
+
+	return true;
+}
+
+void ComShell::EnumTopLevelWindows(std::vector<HWND>& wins)
+{
+	TRACE_SCOPE("ComShell::EnumTopLevelWindows");
+	EnumWindows(EnumCollect, (LPARAM)&wins);
+}
+
+HRESULT ComShell::GetWindowTraits(HWND hWin, WindowTraits& traits)
+{
+	TRACE_SCOPE("ComShell::GetWindowTraits");
+
+	// explorer has no view for these, and there are hundreds of them
+	if (!IsWindowVisible(hWin))
+		return E_INVALIDARG;
+
+	IApplicationView* view = nullptr;
+	HRESULT hr = viewCollection->GetViewForHwnd(hWin, &view);
+	if (FAILED(hr))
+		return hr;
+
+	traits = WindowTraits();
+
+	PWSTR appId = nullptr;
+	if (SUCCEEDED(view->GetAppUserModelId(&appId)) && appId)
+	{
+		traits.appId = appId;
+		CoTaskMemFree(appId);
+	}
+	view->Release();
+
+	DWORD pid = 0;
+	GetWindowThreadProcessId(hWin, &pid);
+	if (HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid))
+	{
+		WCHAR image[MAX_PATH];
+		DWORD length = MAX_PATH;
+		if (QueryFullProcessImageNameW(process, 0, image, &length))
+			traits.image.assign(image, length);
+		CloseHandle(process);
+	}
+
+	WCHAR text[256];
+	int length = GetClassNameW(hWin, text, ARRAYSIZE(text));
+	traits.className.assign(text, length > 0 ? length : 0);
+
+	length = GetWindowTextW(hWin, text, ARRAYSIZE(text));
+	traits.title.assign(text, length > 0 ? length : 0);
+
+	return S_OK;
+}
+
+HRESULT ComShell::GetWindowMonitor(HWND hWin, HMONITOR* monitor)
+{
+	// user32 only, nothing crosses into explorer
+	if (!monitor) return E_POINTER;
+	*monitor = MonitorFromWindow(hWin, MONITOR_DEFAULTTONEAREST);
+	return *monitor ? S_OK : E_INVALIDARG;
+}
+
+HRESULT ComShell::GetWindowBasics(HWND hWin, WindowBasics& basics)
+{
+	// the cheapest first, most windows stop there
+	basics.visible = IsWindowVisible(hWin) != FALSE;
+	if (!basics.visible)
+		return S_OK;
+
+	basics.style = (DWORD)GetWindowLongPtrW(hWin, GWL_STYLE);
+	basics.exStyle = (DWORD)GetWindowLongPtrW(hWin, GWL_EXSTYLE);
+	basics.owner = GetWindow(hWin, GW_OWNER);
+
+	basics.cloaked = 0;
+	if (FAILED(DwmGetWindowAttribute(hWin, DWMWA_CLOAKED, &basics.cloaked, sizeof(basics.cloaked))))
+		basics.cloaked = 0;
+
+	RECT rect{};
+	if (!GetWindowRect(hWin, &rect))
+		return HRESULT_FROM_WIN32(GetLastError());
+	basics.width = rect.right - rect.left;
+	basics.height = rect.bottom - rect.top;
+
+	WCHAR name[256];
+	int length = GetClassNameW(hWin, name, ARRAYSIZE(name));
+	basics.className.assign(name, length > 0 ? length : 0);
+
+	return S_OK;
+}
+
+HRESULT ComShell::IsWindowOnCurrentVirtualDesktop(HWND hWin, BOOL* onDesk)
+{
+	TRACE_SCOPE("ComShell::IsWindowOnCurrentVirtualDesktop");
+	return pDesktopManager->IsWindowOnCurrentVirtualDesktop(hWin, onDesk);
+}
+
+HRESULT ComShell::GetWindowDesktopId(HWND hWin, GUID* desktopId)
+{
+	TRACE_SCOPE("ComShell::GetWindowDesktopId");
+	return pDesktopManager->GetWindowDesktopId(hWin, desktopId);
+}
+
+HRESULT ComShell::GetCurrentDesktop(IVirtualDesktop** desktop)
+{
+	TRACE_SCOPE("ComShell::GetCurrentDesktop");
+	return pDesktopManagerInternal->GetCurrentDesktop(desktop);
+}
+
+HRESULT ComShell::GetDesktops(std::vector<IVirtualDesktop*>& desktops)
+{
+	TRACE_SCOPE("ComShell::GetDesktops");
+
+	IObjectArray* pObjectArray = nullptr;
+	HRESULT hr = pDesktopManagerInternal->GetDesktops(&pObjectArray);
+	if (FAILED(hr)) return hr;
+
+	UINT count = 0;
+	hr = pObjectArray->GetCount(&count);
+	if (SUCCEEDED(hr))
+	{
+		for (UINT i = 0; i < count; i++)
+		{
+			IVirtualDesktop* pDesktop = nullptr;
+			if (FAILED(pObjectArray->GetAt(i, __uuidof(IVirtualDesktop), (void**)&pDesktop)))
+				continue;
+			desktops.push_back(pDesktop);
+		}
+	}
+
+	pObjectArray->Release();
+	return hr;
+}
+
+HRESULT ComShell::SwitchDesktop(IVirtualDesktop* desktop)
+{
+	TRACE_SCOPE("ComShell::SwitchDesktop");
+	return pDesktopManagerInternal->SwitchDesktop(desktop);
+}
+
+HRESULT ComShell::CreateDesktop(IVirtualDesktop** desktop)
+{
+	TRACE_SCOPE("ComShell::CreateDesktop");
+	return pDesktopManagerInternal->CreateDesktopW(desktop);
+}
+
+HRESULT ComShell::MoveViewToDesktop(IApplicationView* view, IVirtualDesktop* desktop)
+{
+	TRACE_SCOPE("ComShell::MoveViewToDesktop");
+	return pDesktopManagerInternal->MoveViewToDesktop(view, desktop);
+}
+
+HRESULT ComShell::GetViewForHwnd(HWND hWin, IApplicationView** view)
+{
+	TRACE_SCOPE("ComShell::GetViewForHwnd");
+	return viewCollection->GetViewForHwnd(hWin, view);
+}
+
+HRESULT ComShell::GetViewsByZOrder(std::vector<IApplicationView*>& views)
+{
+	TRACE_SCOPE("ComShell::GetViewsByZOrder");
+
+	IObjectArray* pObjectArray = nullptr;
+	HRESULT hr = viewCollection->GetViewsByZOrder(&pObjectArray);
+	if (FAILED(hr)) return hr;
+
+	UINT count = 0;
+	hr = pObjectArray->GetCount(&count);
+	if (SUCCEEDED(hr))
+	{
+		views.reserve(views.size() + count);
+		for (UINT i = 0; i < count; i++)
+		{
+			IApplicationView* pView = nullptr;
+			if (FAILED(pObjectArray->GetAt(i, __uuidof(IApplicationView), (void**)&pView)))
+				continue;
+			views.push_back(pView);
+		}
+	}
+
+	pObjectArray->Release();
+	return hr;
+}
+
+// A proxy marshaled again refers to explorer's view itself, the thread that
+// unmarshals it talks to explorer directly and not through this apartment
+HRESULT ComShell::ShareView(IApplicationView* view, SharedView* shared)
+{
+	if (!view || !shared) return E_POINTER;
+
+	TRACE_SCOPE("ComShell::ShareView");
+
+	IStream* stream = nullptr;
+	HRESULT hr = CoMarshalInterThreadInterfaceInStream(__uuidof(IApplicationView), view, &stream);
+	*shared = SUCCEEDED(hr) ? stream : nullptr;
+	return hr;
+}
+
+HRESULT ComShell::TakeView(SharedView shared, IApplicationView** view)
+{
+	if (!shared || !view) return E_POINTER;
+
+	// releases the stream, whether it works or not
+	return CoGetInterfaceAndReleaseStream(static_cast<IStream*>(shared), __uuidof(IApplicationView), (void**)view);
+}
+
+void ComShell::DropView(SharedView shared)
+{
+	if (!shared)
+		return;
+
+	IStream* stream = static_cast<IStream*>(shared);
+	LARGE_INTEGER start{};
+	stream->Seek(start, STREAM_SEEK_SET, nullptr);
+	CoReleaseMarshalData(stream);
+	stream->Release();
+}
+
+HRESULT ComShell::RegisterForNotifications(IVirtualDesktopNotification* sink, DWORD* cookie)
+{
+	if (!pNotificationService) return E_NOINTERFACE;
+	return pNotificationService->Register(sink, cookie);
+}
+
+HRESULT ComShell::UnregisterForNotifications(DWORD cookie)
+{
+	if (!pNotificationService) return E_NOINTERFACE;
+	return pNotificationService->Unregister(cookie);
+}
+
+HRESULT ComShell::RegisterForWindowEvents(IWindowEventSink* sink, DWORD* cookie)
+{
+	if (!sink || !cookie) return E_POINTER;
+
+	if (!hWindowHook)
+	{
+		// the callback finds its shell by thread, one hooked shell a thread
+		if (t_Hooked) return E_FAIL;
+
+		hWindowHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, NULL, OnWinEvent, 0, 0,
+			WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+		if (!hWindowHook) return HRESULT_FROM_WIN32(GetLastError());
+		t_Hooked = this;
+	}
+
+	*cookie = nextWindowCookie++;
+	windowSinks.emplace_back(*cookie, sink);
+	return S_OK;
+}
+
+HRESULT ComShell::UnregisterForWindowEvents(DWORD cookie)
+{
+	for (auto it = windowSinks.begin(); it != windowSinks.end(); ++it)
+	{
+		if ((*it).first == cookie && (*it).second)
+		{
+			// the hook is walking the sinks, it takes the entry out after
+			if (dispatchingWindowEvent)
+				(*it).second = nullptr;
+			else
+				windowSinks.erase(it);
+			return S_OK;
+		}
+	}
+	return E_INVALIDARG;
+}
+
+void CALLBACK ComShell::OnWinEvent(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD thread, DWORD time)
+{
+	// the window itself, not one of its parts
+	if (!t_Hooked || !hwnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF)
+		return;
+
+	WindowEvent kind;
+	switch (event)
+	{
+	case EVENT_OBJECT_CREATE: kind = WindowEvent::Created; break;
+	case EVENT_OBJECT_DESTROY: kind = WindowEvent::Destroyed; break;
+	case EVENT_OBJECT_SHOW: kind = WindowEvent::Shown; break;
+	case EVENT_OBJECT_HIDE: kind = WindowEvent::Hidden; break;
+	default: return;
+	}
+
+	// top level windows only, every child of every process would overflow the
+	// event queue. A destroyed window has no ancestor left to ask, it is kept
+	// and tracking passes over the ones no group held.
+	HWND root = GetAncestor(hwnd, GA_ROOT);
+	if (root && root != hwnd)
+		return;
+
+	// a sink may unregister from the callback, by index and without a copy:
+	// one registered now is called from the next event
+	ComShell* shell = t_Hooked;
+	auto& sinks = shell->windowSinks;
+	const size_t count = sinks.size();
+	shell->dispatchingWindowEvent = true;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (sinks[i].second)
+			sinks[i].second->WindowChanged(kind, hwnd);
+	}
+	shell->dispatchingWindowEvent = false;
+	std::erase_if(sinks, [](const auto& sink) { return !sink.second; });
+}
+
+ComShellWait::ComShellWait()
+	: hWake(CreateEvent(NULL, FALSE, FALSE, NULL))
+{
+}
+
+ComShellWait::~ComShellWait()
+{
+	if (hWake)
+		CloseHandle(hWake);
+}
+
+void ComShellWait::Wait()
+{
+	MsgWaitForMultipleObjectsEx(1, &hWake, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+	MSG msg;
+	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+	{
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
+
+void ComShellWait::Wake()
+{
+	SetEvent(hWake);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "shellbackend.h"
+#include "worker.h"
+
+// IShellBackend over the undocumented explorer COM interfaces.
+class ComShell : public IShellBackend
+{
+public:
+	ComShell() = default;
+	~ComShell() override;
+
+	ComShell(const ComShell&) = delete;
+	ComShell& operator=(const ComShell&) = delete;
+
+	// The apartment the calling thread joins, COINIT_MULTITHREADED for move pool threads
+	bool Init(DWORD apartment = COINIT_APARTMENTTHREADED);
+
+	void EnumTopLevelWindows(std::vector<HWND>& wins) override;
+	HRESULT GetWindowTraits(HWND hWin, WindowTraits& traits) override;
+	HRESULT GetWindowMonitor(HWND hWin, HMONITOR* monitor) override;
+	HRESULT GetWindowBasics(HWND hWin, WindowBasics& basics) override;
+
+	HRESULT IsWindowOnCurrentVirtualDesktop(HWND hWin, BOOL* onDesk) override;
+	HRESULT GetWindowDesktopId(HWND hWin, GUID* desktopId) override;
+
+	HRESULT GetCurrentDesktop(IVirtualDesktop** desktop) override;
+	HRESULT GetDesktops(std::vector<IVirtualDesktop*>& desktops) override;
+	HRESULT SwitchDesktop(IVirtualDesktop* desktop) override;
+	HRESULT CreateDesktop(IVirtualDesktop** desktop) override;
+	HRESULT MoveViewToDesktop(IApplicationView* view, IVirtualDesktop* desktop) override;
+
+	HRESULT GetViewForHwnd(HWND hWin, IApplicationView** view) override;
+	HRESULT GetViewsByZOrder(std::vector<IApplicationView*>& views) override;
+
+	HRESULT ShareView(IApplicationView* view, SharedView* shared) override;
+	HRESULT TakeView(SharedView shared, IApplicationView** view) override;
+	void DropView(SharedView shared) override;
+
+	HRESULT RegisterForNotifications(IVirtualDesktopNotification* sink, DWORD* cookie) override;
+	HRESULT UnregisterForNotifications(DWORD cookie) override;
+
+	HRESULT RegisterForWindowEvents(IWindowEventSink* sink, DWORD* cookie) override;
+	HRESULT UnregisterForWindowEvents(DWORD cookie) override;
+
+private:
+	static void CALLBACK OnWinEvent(HWINEVENTHOOK hook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD thread, DWORD time);
+
+	bool comInit = false;
+
+	// one hook for every sink, set with the first and kept until we go
+	HWINEVENTHOOK hWindowHook = NULL;
+	std::vector<std::pair<DWORD, IWindowEventSink*>> windowSinks;
+	DWORD nextWindowCookie = 1;
+	bool dispatchingWindowEvent = false;  // unregistering only clears the sink
+
+	IServiceProvider* pServiceProvider = NULL;
+	IApplicationViewCollection* viewCollection = NULL;
+	IVirtualDesktopManager* pDesktopManager = NULL;
+	IVirtualDesktopManagerInternal* pDesktopManagerInternal = NULL;
+	IVirtualDesktopNotificationService* pNotificationService = NULL;
+};
+
+// How the command worker waits when the shell lives in its STA: asleep on an
+// event, but still dispatching the messages COM uses to deliver explorer's
+// notifications.
+class ComShellWait : public IWorkerWait
+{
+public:
+	ComShellWait();
+	~ComShellWait() override;
+
+	ComShellWait(const ComShellWait&) = delete;
+	ComShellWait& operator=(const ComShellWait&) = delete;
+
+	void Wait() override;
+	void Wake() override;
+
+private:
+	HANDLE hWake = NULL;
+};
@@ -0,0 +1,363 @@
+#include "desktopcache.h"
+#include "desktopregistry.h"
+#include "trace.h"
+#include "viewcache.h"
+#include "windowfilter.h"
+
+#include <unordered_set>
+
+namespace {
+	// Windows the shell reports with no desktop show up on every desktop
+	bool IsNullDesktop(const GUID& id)
+	{
+		return id == GUID{};
+	}
+}
+
+bool DesktopCache::Attach(IShellBackend* shell, DesktopRegistry* registry, ViewCache* views, WindowFilter* filter)
+{
+	Detach();
+
+	IVirtualDesktop* current = nullptr;
+	if (FAILED(shell->GetCurrentDesktop(&current)))
+		return false;
+
+	GUID currentId{};
+	HRESULT hr = current->GetID(&currentId);
+	current->Release();
+	if (FAILED(hr))
+		return false;
+
+	if (FAILED(shell->RegisterForNotifications(this, &m_Cookie)))
+		return false;
+
+	m_Shell = shell;
+	m_Registry = registry;
+	m_Views = views;
+	m_Filter = filter;
+	m_Current = currentId;
+	m_Windows.clear();
+	m_Failed.clear();
+	return true;
+}
+
+void DesktopCache::Detach()
+{
+	if (m_Shell)
+		m_Shell->UnregisterForNotifications(m_Cookie);
+
+	m_Shell = nullptr;
+	m_Registry = nullptr;
+	m_Views = nullptr;
+	m_Filter = nullptr;
+	m_Cookie = 0;
+	m_Windows.clear();
+	m_Failed.clear();
+}
+
+void DesktopCache::Resync()
+{
+	TRACE_SCOPE("DesktopCache::Resync");
+
+	if (!m_Shell)
+		return;
+
+	++m_Stats.resyncs;
+
+	if (m_Registry)
+		m_Registry->Invalidate();
+
+	IVirtualDesktop* current = nullptr;
+	if (SUCCEEDED(m_Shell->GetCurrentDesktop(&current)))
+	{
+		GUID id{};
+		if (SUCCEEDED(current->GetID(&id)))
+		{
+			if (id != m_Current)
+			{
+				++m_Stats.corrected;
+				++m_Changes;
+			}
+			m_Current = id;
+		}
+		current->Release();
+	}
+
+	std::vector<HWND> all;
+	m_Shell->EnumTopLevelWindows(all);
+
+	std::unordered_set<HWND> alive(all.begin(), all.end());
+
+	for (auto it = m_Windows.begin(); it != m_Windows.end();)
+	{
+		if (alive.find((*it).first) == alive.end())
+		{
+			it = m_Windows.erase(it);
+			++m_Changes;
+		}
+		else
+			++it;
+	}
+
+	// the entries of windows the filter rules out are left as they are, no
+	// command looks for those
+	if (m_Filter)
+		m_Filter->Apply(m_Shell, all);
+
+	m_Failed.clear();
+	for (const auto& hwnd : all)
+	{
+		Entry fresh{};
+		fresh.hr = m_Shell->GetWindowDesktopId(hwnd, &fresh.desktop);
+		if (FAILED(fresh.hr))
+			m_Failed.push_back(hwnd);
+
+		auto it = m_Windows.find(hwnd);
+		if (it != m_Windows.end())
+		{
+			Entry& old = (*it).second;
+			if (old.hr != fresh.hr || (SUCCEEDED(fresh.hr) && old.desktop != fresh.desktop))
+			{
+				++m_Stats.corrected;
+				++m_Changes;
+			}
+			old = fresh;
+		}
+		else
+		{
+			m_Windows.emplace(hwnd, fresh);
+		}
+	}
+}
+
+bool DesktopCache::Lookup(HWND hWin, Entry& entry)
+{
+	if (!m_Shell)
+		return false;
+
+	auto it = m_Windows.find(hWin);
+	if (it != m_Windows.end())
+	{
+		++m_Stats.hits;
+		entry = (*it).second;
+		return true;
+	}
+
+	++m_Stats.misses;
+	entry = Entry{};
+	entry.hr = m_Shell->GetWindowDesktopId(hWin, &entry.desktop);
+	m_Windows.emplace(hWin, entry);
+	if (FAILED(entry.hr))
+		m_Failed.push_back(hWin);
+	return true;
+}
+
+void DesktopCache::ExpireFailed()
+{
+	for (HWND hWin : m_Failed)
+	{
+		auto it = m_Windows.find(hWin);
+		if (it != m_Windows.end() && FAILED((*it).second.hr))
+		{
+			m_Windows.erase(it);
+			++m_Changes;
+		}
+	}
+	m_Failed.clear();
+}
+
+HRESULT DesktopCache::IsWindowOnCurrentDesktop(HWND hWin, BOOL* onDesk)
+{
+	if (!m_Shell)
+		return E_FAIL;
+
+	Entry entry;
+	Lookup(hWin, entry);
+	if (FAILED(entry.hr))
+		return entry.hr;
+
+	*onDesk = IsNullDesktop(entry.desktop) || entry.desktop == m_Current;
+	return S_OK;
+}
+
+HRESULT DesktopCache::GetWindowDesktopId(HWND hWin, GUID* desktopId)
+{
+	if (!m_Shell)
+		return E_FAIL;
+
+	Entry entry;
+	Lookup(hWin, entry);
+	if (SUCCEEDED(entry.hr))
+		*desktopId = entry.desktop;
+	return entry.hr;
+}
+
+void DesktopCache::SetWindowDesktop(HWND hWin, const GUID& desktopId)
+{
+	if (!m_Shell)
+		return;
+	Entry& entry = m_Windows[hWin];
+	if (entry.hr != S_OK || entry.desktop != desktopId)
+		++m_Changes;
+	entry = Entry{ desktopId, S_OK };
+}
+
+void DesktopCache::SetCurrentDesktop(const GUID& desktopId)
+{
+	if (m_Current != desktopId)
+		++m_Changes;
+	m_Current = desktopId;
+}
+
+void DesktopCache::Forget(HWND hWin)
+{
+	if (m_Windows.erase(hWin))
+		++m_Changes;
+}
+
+void DesktopCache::Recheck(HWND hWin)
+{
+	auto it = m_Windows.find(hWin);
+	if (it != m_Windows.end() && FAILED((*it).second.hr))
+	{
+		m_Windows.erase(it);
+		++m_Changes;
+	}
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::QueryInterface(REFIID riid, void** ppvObject)
+{
+	if (!ppvObject)
+		return E_POINTER;
+
+	if (riid == IID_IUnknown || riid == IID_IVirtualDesktopNotification)
+	{
+		*ppvObject = static_cast<IVirtualDesktopNotification*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppvObject = nullptr;
+	return E_NOINTERFACE;
+}
+
+// Owned by whoever declared it, the count only keeps COM happy
+ULONG STDMETHODCALLTYPE DesktopCache::AddRef()
+{
+	return ++m_Refs;
+}
+
+ULONG STDMETHODCALLTYPE DesktopCache::Release()
+{
+	return --m_Refs;
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::VirtualDesktopCreated(IVirtualDesktop* pDesktop)
+{
+	++m_Stats.notifications;
+	if (m_Registry)
+		m_Registry->Invalidate();
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::VirtualDesktopDestroyBegin(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback)
+{
+	++m_Stats.notifications;
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::VirtualDesktopDestroyFailed(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback)
+{
+	++m_Stats.notifications;
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::VirtualDesktopDestroyed(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback)
+{
+	++m_Stats.notifications;
+	++m_Changes;
+
+	if (m_Registry)
+		m_Registry->Invalidate();
+
+	GUID destroyed{}, fallback{};
+	if (!pDesktopDestroyed || FAILED(pDesktopDestroyed->GetID(&destroyed)))
+		return S_OK;
+	if (!pDesktopFallback || FAILED(pDesktopFallback->GetID(&fallback)))
+	{
+		// Don't know where they went, ask again next time
+		for (auto it = m_Windows.begin(); it != m_Windows.end();)
+		{
+			if ((*it).second.desktop == destroyed)
+				it = m_Windows.erase(it);
+			else
+				++it;
+		}
+		return S_OK;
+	}
+
+	// explorer moves the windows of a removed desktop onto the fallback
+	for (auto& win : m_Windows)
+	{
+		if (win.second.desktop == destroyed)
+			win.second.desktop = fallback;
+	}
+
+	if (m_Current == destroyed)
+		m_Current = fallback;
+
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::ViewVirtualDesktopChanged(IApplicationView* pView)
+{
+	TRACE_SCOPE("DesktopCache::ViewVirtualDesktopChanged");
+
+	++m_Stats.notifications;
+
+	// whatever explorer couldn't place before may have its view now
+	ExpireFailed();
+
+	if (!pView)
+		return S_OK;
+
+	HWND hWin = m_Views && m_Views->Active() ? m_Views->WindowOf(pView) : nullptr;
+	if (!hWin && (FAILED(pView->GetThumbnailWindow(&hWin)) || !hWin))
+		return S_OK;
+
+	GUID id{};
+	if (FAILED(pView->GetVirtualDesktopId(&id)))
+	{
+		Forget(hWin);
+		return S_OK;
+	}
+
+	// the echo of our own move changes nothing
+	auto it = m_Windows.find(hWin);
+	if (it == m_Windows.end() || FAILED((*it).second.hr) || (*it).second.desktop != id)
+		++m_Changes;
+
+	m_Windows[hWin] = Entry{ id, S_OK };
+	if (m_Registry)
+		m_Registry->WindowMoved(hWin, id);
+	return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DesktopCache::CurrentVirtualDesktopChanged(IVirtualDesktop* pDesktopOld, IVirtualDesktop* pDesktopNew)
+{
+	TRACE_SCOPE("DesktopCache::CurrentVirtualDesktopChanged");
+
+	++m_Stats.notifications;
+
+	GUID id{};
+	if (pDesktopNew && SUCCEEDED(pDesktopNew->GetID(&id)))
+	{
+		if (id != m_Current)
+			++m_Changes;
+		m_Current = id;
+		if (m_Registry)
+			m_Registry->SetCurrent(id);
+	}
+
+	return S_OK;
+}
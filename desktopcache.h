@@ -0,0 +1,112 @@
+#pragma once
+
+#include "shellbackend.h"
+
+class DesktopRegistry;
+class ViewCache;
+class WindowFilter;
+
+#include <unordered_map>
+#include <vector>
+
+// Resident HWND -> desktop map kept current by IVirtualDesktopNotification, so
+// "is this window on the current desktop" is a local lookup instead of a call
+// into explorer. Windows we have not seen yet are asked for once and then
+// tracked; Resync() is the periodic full check that catches anything the
+// notifications missed. A window explorer couldn't place is asked again after
+// the next view notification or once it's created or shown, not served from
+// the map.
+//
+// Everything runs on the thread that owns the shell, same as the notifications.
+class DesktopCache : public IVirtualDesktopNotification
+{
+public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t notifications = 0;
+		size_t resyncs = 0;
+		size_t corrected = 0;  // entries a resync found stale
+	};
+
+	DesktopCache() = default;
+	virtual ~DesktopCache() = default;
+
+	DesktopCache(const DesktopCache&) = delete;
+	DesktopCache& operator=(const DesktopCache&) = delete;
+
+	// Registers for notifications and primes the current desktop. Fails, and the
+	// cache stays inactive, when the shell can't deliver notifications.
+	// Desktop events are passed on to the registry, if given. A view the view
+	// cache holds isn't asked for its window. A resync only asks again for
+	// the desktops of the windows the filter lets through.
+	bool Attach(IShellBackend* shell, DesktopRegistry* registry = nullptr, ViewCache* views = nullptr, WindowFilter* filter = nullptr);
+	void Detach();
+	bool Active() const { return m_Shell != nullptr; }
+
+	// Full enumeration, fixes up every entry and drops windows that are gone
+	void Resync();
+
+	HRESULT IsWindowOnCurrentDesktop(HWND hWin, BOOL* onDesk);
+	HRESULT GetWindowDesktopId(HWND hWin, GUID* desktopId);
+	GUID CurrentDesktopId() const { return m_Current; }
+
+	// Our own moves/switches, applied immediately rather than waiting for the
+	// notification to round trip through the message loop
+	void SetWindowDesktop(HWND hWin, const GUID& desktopId);
+	void SetCurrentDesktop(const GUID& desktopId);
+	void Forget(HWND hWin);
+	// Drops the window's entry if asking for it failed, a window that was
+	// just created or shown may have its view by now
+	void Recheck(HWND hWin);
+
+	size_t Size() const { return m_Windows.size(); }
+	const Stats& GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats = Stats(); }
+
+	// Goes up whenever what the cache holds changes, by our own moves and
+	// switches or by a notification or resync finding something new. The
+	// notification echoing one of our moves doesn't count again. Anything
+	// worked out from the cache is still good while this stays the same.
+	size_t Changes() const { return m_Changes; }
+
+	// IUnknown
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	// IVirtualDesktopNotification
+	HRESULT STDMETHODCALLTYPE VirtualDesktopCreated(IVirtualDesktop* pDesktop) override;
+	HRESULT STDMETHODCALLTYPE VirtualDesktopDestroyBegin(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback) override;
+	HRESULT STDMETHODCALLTYPE VirtualDesktopDestroyFailed(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback) override;
+	HRESULT STDMETHODCALLTYPE VirtualDesktopDestroyed(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback) override;
+	HRESULT STDMETHODCALLTYPE ViewVirtualDesktopChanged(IApplicationView* pView) override;
+	HRESULT STDMETHODCALLTYPE CurrentVirtualDesktopChanged(IVirtualDesktop* pDesktopOld, IVirtualDesktop* pDesktopNew) override;
+
+private:
+	struct Entry
+	{
+		GUID desktop;
+		HRESULT hr;     // failures are kept until they expire, see m_Failed
+	};
+
+	bool Lookup(HWND hWin, Entry& entry);
+	void ExpireFailed();
+
+	IShellBackend* m_Shell = nullptr;
+	DesktopRegistry* m_Registry = nullptr;
+	ViewCache* m_Views = nullptr;
+	WindowFilter* m_Filter = nullptr;
+	DWORD m_Cookie = 0;
+	ULONG m_Refs = 1;
+
+	GUID m_Current{};
+	std::unordered_map<HWND, Entry> m_Windows;
+	// Windows whose entry was a failure when it went in, dropped on the next
+	// view notification unless something placed them since
+	std::vector<HWND> m_Failed;
+
+	Stats m_Stats;
+	size_t m_Changes = 0;
+};
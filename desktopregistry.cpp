@@ -0,0 +1,97 @@
+#include "desktopregistry.h"
+#include "trace.h"
+
+bool DesktopRegistry::Refresh(IShellBackend* shell, HWND hAnchor)
+{
+	TRACE_SCOPE("DesktopRegistry::Refresh");
+
+	Invalidate();
+
+	m_hAnchor = hAnchor;
+
+	std::vector<IVirtualDesktop*> desktops;
+	HRESULT hr = shell->GetDesktops(desktops);
+
+	for (auto desktop : desktops)
+	{
+		auto ref = com_ptr<IVirtualDesktop>::Attach(desktop);
+
+		GUID id{};
+		if (FAILED(hr) || FAILED(ref->GetID(&id)))
+			continue;
+
+		if (!m_Index.emplace(id, m_Desktops.size()).second)
+			continue;
+
+		m_Desktops.push_back(std::move(ref));
+		m_Ids.push_back(id);
+	}
+
+	if (FAILED(hr) || m_Desktops.empty())
+	{
+		Invalidate();
+		return false;
+	}
+
+	com_ptr<IVirtualDesktop> current;
+	GUID currentId{};
+	if (FAILED(shell->GetCurrentDesktop(current.Put())) || FAILED(current->GetID(&currentId)))
+	{
+		Invalidate();
+		return false;
+	}
+	m_Current = IndexOf(currentId);
+
+	GUID anchorId{};
+	if (hAnchor && SUCCEEDED(shell->GetWindowDesktopId(hAnchor, &anchorId)))
+		m_Anchor = IndexOf(anchorId);
+
+	m_Valid = true;
+	return true;
+}
+
+void DesktopRegistry::Invalidate()
+{
+	m_Valid = false;
+	m_Desktops.clear();
+	m_Ids.clear();
+	m_Index.clear();
+	m_Current = None;
+	m_Anchor = None;
+}
+
+int DesktopRegistry::IndexOf(const GUID& id) const
+{
+	auto it = m_Index.find(id);
+	if (it == m_Index.end())
+		return None;
+	return (int)(*it).second;
+}
+
+int DesktopRegistry::Scratch() const
+{
+	for (size_t i = 0; i < m_Desktops.size(); i++)
+	{
+		if ((int)i != m_Current)
+			return (int)i;
+	}
+	return None;
+}
+
+void DesktopRegistry::SetCurrent(const GUID& id)
+{
+	if (!m_Valid)
+		return;
+
+	m_Current = IndexOf(id);
+
+	// A desktop we never saw, rebuild on next use
+	if (m_Current == None)
+		Invalidate();
+}
+
+void DesktopRegistry::WindowMoved(HWND hWin, const GUID& id)
+{
+	if (m_Valid && hWin && hWin == m_hAnchor)
+		m_Anchor = IndexOf(id);
+}
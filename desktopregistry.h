@@ -0,0 +1,47 @@
+#pragma once
+
+#include "shellbackend.h"
+#include "comptr.h"
+
+#include <unordered_map>
+#include <vector>
+
+// The virtual desktops in shell order, with their ids, the current desktop and
+// the one our window lives on (the anchor). Held between commands and only
+// rebuilt after desktops are created or destroyed, or on an explicit refresh,
+// so moving windows needs nothing but the MoveViewToDesktop calls.
+class DesktopRegistry
+{
+public:
+	static constexpr int None = -1;
+
+	bool Refresh(IShellBackend* shell, HWND hAnchor);
+	void Invalidate();
+	bool Valid() const { return m_Valid; }
+
+	size_t Count() const { return m_Desktops.size(); }
+	IVirtualDesktop* At(size_t idx) const { return m_Desktops[idx].Get(); }
+	const GUID& IdAt(size_t idx) const { return m_Ids[idx]; }
+	int IndexOf(const GUID& id) const;
+
+	int Current() const { return m_Current; }
+	int Anchor() const { return m_Anchor; }
+
+	// Where MoveToScratch parks windows, the first desktop that isn't current
+	int Scratch() const;
+
+	// The current desktop or the anchor window moved, no need to rebuild
+	void SetCurrent(const GUID& id);
+	void WindowMoved(HWND hWin, const GUID& id);
+
+private:
+	bool m_Valid = false;
+	HWND m_hAnchor = nullptr;
+
+	std::vector<com_ptr<IVirtualDesktop>> m_Desktops;
+	std::vector<GUID> m_Ids;
+	std::unordered_map<GUID, size_t> m_Index;
+
+	int m_Current = None;
+	int m_Anchor = None;
+};
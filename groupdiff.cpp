@@ -0,0 +1,238 @@
+#include "groupdiff.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <numeric>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define GROUPDIFF_SSE2 1
+#endif
+
+namespace {
+	// Measured with diffbench, below this many pairs (about 11 windows a side)
+	// the nested loops beat setting up a table
+	constexpr size_t ScanLimit = 128;
+
+	using Key = std::uintptr_t;
+
+	Key KeyOf(HWND hwnd)
+	{
+		return reinterpret_cast<Key>(hwnd);
+	}
+
+	// inTarget[i] is set when current[i] is also in target, inCurrent[j] the
+	// other way around
+	void MarkScan(std::span<const HWND> current, std::span<const HWND> target,
+		std::vector<char>& inTarget, std::vector<char>& inCurrent)
+	{
+		for (size_t i = 0; i < current.size(); i++)
+		{
+			for (size_t j = 0; j < target.size(); j++)
+			{
+				if (current[i] == target[j])
+				{
+					inTarget[i] = 1;
+					inCurrent[j] = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	void MarkHash(std::span<const HWND> current, std::span<const HWND> target,
+		std::vector<char>& inTarget, std::vector<char>& inCurrent)
+	{
+		// at most half full, slot holds target index + 1 so zero is empty
+		size_t size = std::bit_ceil(std::max<size_t>(target.size() * 2, 16));
+		size_t mask = size - 1;
+		std::vector<std::uint32_t> slots(size, 0);
+
+		auto hash = [mask](Key key) {
+			// handles are multiples of small powers of two, mix the low bits up
+			std::uint64_t h = (std::uint64_t)key * 0x9E3779B97F4A7C15ull;
+			return (size_t)(h >> 32) & mask;
+		};
+
+		for (size_t j = 0; j < target.size(); j++)
+		{
+			size_t s = hash(KeyOf(target[j]));
+			while (slots[s])
+				s = (s + 1) & mask;
+			slots[s] = (std::uint32_t)j + 1;
+		}
+
+		for (size_t i = 0; i < current.size(); i++)
+		{
+			for (size_t s = hash(KeyOf(current[i])); slots[s]; s = (s + 1) & mask)
+			{
+				size_t j = slots[s] - 1;
+				if (target[j] == current[i])
+				{
+					inTarget[i] = 1;
+					inCurrent[j] = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	// Keys in ascending order with where each one came from
+	void SortKeys(std::span<const HWND> wins, std::vector<Key>& keys, std::vector<std::uint32_t>& from)
+	{
+		from.resize(wins.size());
+		std::iota(from.begin(), from.end(), 0);
+		std::ranges::sort(from, {}, [&](std::uint32_t idx) { return KeyOf(wins[idx]); });
+
+		keys.resize(wins.size());
+		for (size_t k = 0; k < from.size(); k++)
+			keys[k] = KeyOf(wins[from[k]]);
+	}
+
+#ifdef GROUPDIFF_SSE2
+	// 64 bit lane equality, SSE2 only has the 32 bit compare
+	__m128i CmpEq64(__m128i a, __m128i b)
+	{
+		__m128i eq = _mm_cmpeq_epi32(a, b);
+		return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+	}
+#endif
+
+	void MarkMerge(std::span<const HWND> current, std::span<const HWND> target,
+		std::vector<char>& inTarget, std::vector<char>& inCurrent)
+	{
+		std::vector<Key> ka, kb;
+		std::vector<std::uint32_t> fa, fb;
+		SortKeys(current, ka, fa);
+		SortKeys(target, kb, fb);
+
+		size_t i = 0, j = 0;
+
+#ifdef GROUPDIFF_SSE2
+		// two against two per step, all four pairings, then drop whichever
+		// block ends lower
+		while (i + 2 <= ka.size() && j + 2 <= kb.size())
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)&ka[i]);
+			__m128i vb = _mm_loadu_si128((const __m128i*)&kb[j]);
+			__m128i vbSwap = _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2));
+
+			int straight = _mm_movemask_pd(_mm_castsi128_pd(CmpEq64(va, vb)));
+			int crossed = _mm_movemask_pd(_mm_castsi128_pd(CmpEq64(va, vbSwap)));
+
+			if (straight | crossed)
+			{
+				if (straight & 1) { inTarget[fa[i]] = 1; inCurrent[fb[j]] = 1; }
+				if (straight & 2) { inTarget[fa[i + 1]] = 1; inCurrent[fb[j + 1]] = 1; }
+				if (crossed & 1) { inTarget[fa[i]] = 1; inCurrent[fb[j + 1]] = 1; }
+				if (crossed & 2) { inTarget[fa[i + 1]] = 1; inCurrent[fb[j]] = 1; }
+			}
+
+			// on a tie only current moves on, a copy of its last key in the
+			// next block still meets the target one
+			Key lastA = ka[i + 1];
+			Key lastB = kb[j + 1];
+			i += (lastA <= lastB) * 2;
+			j += (lastB < lastA) * 2;
+		}
+#endif
+
+		while (i < ka.size() && j < kb.size())
+		{
+			Key a = ka[i];
+			Key b = kb[j];
+			if (a == b)
+			{
+				inTarget[fa[i]] = 1;
+				inCurrent[fb[j]] = 1;
+			}
+			i += a <= b;
+			j += b < a;
+		}
+	}
+}
+
+void GroupDiff::Clear()
+{
+	toHide.clear();
+	toShow.clear();
+	unchanged.clear();
+}
+
+void DiffGroups(const WindowGroup& current, const WindowGroup& target, const WindowIndex& index, GroupDiff& diff)
+{
+	TRACE_SCOPE("DiffGroups(sets)");
+
+	diff.Clear();
+
+	auto emit = [&index](std::uint64_t bits, size_t word, std::vector<HWND>& out) {
+		for (; bits; bits &= bits - 1)
+			out.push_back(index.At((std::uint32_t)(word * 64 + std::countr_zero(bits))));
+	};
+
+	auto a = current.set.Words();
+	auto b = target.set.Words();
+	for (size_t w = 0; w < std::max(a.size(), b.size()); w++)
+	{
+		std::uint64_t x = w < a.size() ? a[w] : 0;
+		std::uint64_t y = w < b.size() ? b[w] : 0;
+		emit(x & ~y, w, diff.toHide);
+		emit(y & ~x, w, diff.toShow);
+		emit(x & y, w, diff.unchanged);
+	}
+}
+
+// Never Merge: it pays for two sorts that Hash doesn't, and loses to it at
+// every size diffbench tries, so it is only there to be measured against
+DiffMethod PickDiffMethod(size_t current, size_t target)
+{
+	if (current * target <= ScanLimit)
+		return DiffMethod::Scan;
+	return DiffMethod::Hash;
+}
+
+bool DiffMergeUsesSimd()
+{
+#ifdef GROUPDIFF_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
+
+void DiffGroups(std::span<const HWND> current, std::span<const HWND> target, GroupDiff& diff, DiffMethod method)
+{
+	TRACE_SCOPE("DiffGroups");
+
+	diff.Clear();
+
+	if (method == DiffMethod::Auto)
+		method = PickDiffMethod(current.size(), target.size());
+
+	std::vector<char> inTarget(current.size(), 0);
+	std::vector<char> inCurrent(target.size(), 0);
+
+	switch (method)
+	{
+	case DiffMethod::Merge:
+		MarkMerge(current, target, inTarget, inCurrent);
+		break;
+	case DiffMethod::Hash:
+		MarkHash(current, target, inTarget, inCurrent);
+		break;
+	default:
+		MarkScan(current, target, inTarget, inCurrent);
+		break;
+	}
+
+	for (size_t i = 0; i < current.size(); i++)
+		(inTarget[i] ? diff.unchanged : diff.toHide).push_back(current[i]);
+
+	for (size_t j = 0; j < target.size(); j++)
+	{
+		if (!inCurrent[j])
+			diff.toShow.push_back(target[j]);
+	}
+}
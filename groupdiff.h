@@ -0,0 +1,45 @@
+#pragma once
+
+#include "groupset.h"
+#include "platform.h"
+
+#include <span>
+#include <vector>
+
+// What changes between the windows on screen and the group about to be shown.
+// toHide and unchanged keep the order of the current windows, toShow the order
+// of the target group, so the moves happen in z-order like before.
+struct GroupDiff
+{
+	std::vector<HWND> toHide;
+	std::vector<HWND> toShow;
+	std::vector<HWND> unchanged;
+
+	void Clear();
+};
+
+enum class DiffMethod
+{
+	Auto,   // by size, see PickDiffMethod
+	Scan,   // nested loops, nothing allocated, for a handful of windows
+	Merge,  // sort both and walk them together, never picked
+	Hash,   // open addressed table over the target group
+};
+
+// target may not hold the same window twice, which the group lists never do.
+// A window listed twice in current is unchanged or hidden once per copy, by
+// every method.
+void DiffGroups(std::span<const HWND> current, std::span<const HWND> target, GroupDiff& diff, DiffMethod method = DiffMethod::Auto);
+
+DiffMethod PickDiffMethod(size_t current, size_t target);
+
+// The same diff for groups that keep their membership as sets over index:
+// a & ~b, b & ~a and a & b a word at a time, and the set bits turned back
+// into windows through the index. Nothing is looked up per window, but every
+// list comes out in slot order, which is the order the windows were first
+// seen in and not the groups'. This is what the switches use; the diffs over
+// window lists above are the reference diffbench measures it against.
+void DiffGroups(const WindowGroup& current, const WindowGroup& target, const WindowIndex& index, GroupDiff& diff);
+
+// Whether Merge compares handles with SSE2 in this build
+bool DiffMergeUsesSimd();
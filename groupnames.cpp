@@ -0,0 +1,94 @@
+#include "groupnames.h"
+
+GroupId GroupNames::Add(std::wstring_view name)
+{
+	if (m_Ids.find(name) != m_Ids.end())
+		return NoGroup;
+
+	GroupId id;
+	if (!m_Free.empty())
+	{
+		id = m_Free.back();
+		m_Free.pop_back();
+	}
+	else
+	{
+		id = (GroupId)m_Names.size();
+		m_Names.emplace_back();
+		m_Used.push_back(false);
+	}
+
+	m_Names[id] = name;
+	m_Used[id] = true;
+	m_Ids.emplace(m_Names[id], id);
+	++m_Count;
+	return id;
+}
+
+bool GroupNames::Insert(GroupId id, std::wstring_view name)
+{
+	if (id == NoGroup || Contains(id) || m_Ids.find(name) != m_Ids.end())
+		return false;
+
+	// ids skipped over on the way are free for Add
+	while (m_Names.size() <= id)
+	{
+		m_Free.push_back((GroupId)m_Names.size());
+		m_Names.emplace_back();
+		m_Used.push_back(false);
+	}
+	std::erase(m_Free, id);
+
+	m_Names[id] = name;
+	m_Used[id] = true;
+	m_Ids.emplace(m_Names[id], id);
+	++m_Count;
+	return true;
+}
+
+void GroupNames::Remove(GroupId id)
+{
+	if (!Contains(id))
+		return;
+
+	m_Ids.erase(m_Names[id]);
+	m_Names[id].clear();
+	m_Used[id] = false;
+	m_Free.push_back(id);
+	--m_Count;
+}
+
+bool GroupNames::Rename(GroupId id, std::wstring_view name)
+{
+	if (!Contains(id))
+		return false;
+
+	auto it = m_Ids.find(name);
+	if (it != m_Ids.end())
+		return (*it).second == id;
+
+	m_Ids.erase(m_Names[id]);
+	m_Names[id] = name;
+	m_Ids.emplace(m_Names[id], id);
+	return true;
+}
+
+void GroupNames::Clear()
+{
+	m_Names.assign(1, std::wstring());
+	m_Used.assign(1, false);
+	m_Free.clear();
+	m_Ids.clear();
+	m_Count = 0;
+}
+
+GroupId GroupNames::Find(std::wstring_view name) const
+{
+	auto it = m_Ids.find(name);
+	return it == m_Ids.end() ? NoGroup : (*it).second;
+}
+
+const std::wstring& GroupNames::Name(GroupId id) const
+{
+	return Contains(id) ? m_Names[id] : m_Names[NoGroup];
+}
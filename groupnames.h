@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Groups are known by a small integer everywhere, the name is only display
+// text and lives once in GroupNames. Ids are dense so anything kept per group
+// can sit in a vector indexed by them; a deleted group's id is handed out
+// again.
+using GroupId = std::uint32_t;
+constexpr GroupId NoGroup = 0;
+
+class GroupNames
+{
+public:
+	// NoGroup when another group has the name
+	GroupId Add(std::wstring_view name);
+	// Puts a group back under the id it had, for undo. false when the id is in
+	// use or another group has the name.
+	bool Insert(GroupId id, std::wstring_view name);
+	void Remove(GroupId id);
+	// false when another group has the name, renaming to the same name is fine
+	bool Rename(GroupId id, std::wstring_view name);
+	void Clear();
+
+	GroupId Find(std::wstring_view name) const;
+	bool Contains(GroupId id) const { return id < m_Names.size() && m_Used[id]; }
+	// empty for an unknown id
+	const std::wstring& Name(GroupId id) const;
+
+	size_t Count() const { return m_Count; }
+	// One past the largest id there has been, for sizing tables indexed by id
+	size_t Bound() const { return m_Names.size(); }
+
+private:
+	struct NameHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::wstring_view name) const { return std::hash<std::wstring_view>()(name); }
+	};
+
+	std::vector<std::wstring> m_Names{ 1 };   // by id, NoGroup's slot stays empty
+	std::vector<bool> m_Used{ false };
+	std::vector<GroupId> m_Free;
+	std::unordered_map<std::wstring, GroupId, NameHash, std::equal_to<>> m_Ids;
+	size_t m_Count = 0;
+};
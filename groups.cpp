@@ -0,0 +1,2321 @@
+#include "groups.h"
+#include "desktopcache.h"
+#include "desktopregistry.h"
+#include "groupdiff.h"
+#include "movepool.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "undohistory.h"
+#include "viewcache.h"
+#include "windowevents.h"
+#include "windowrules.h"
+#include "windowidentity.h"
+
+#include <assert.h>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <utility>
+#include <sstream>
+
+namespace {
+	constexpr size_t MaxMoveHistory = 15;
+	constexpr size_t MaxUndo = 64;
+	constexpr int SwitchRetries = 1;
+
+	// After this many prefetches in a row went stale only every this many'th
+	// idle chance takes one, until one is used again
+	constexpr size_t StalePrefetches = 3;
+
+	// Members by group id, names only matter to the list view and saving.
+	// Every member has a slot in m_Index, membership is kept as a set over
+	// those slots too.
+	GroupNames m_Names;
+	std::vector<WindowGroup> m_Groups;
+	WindowIndex m_Index;
+
+	// The current desktop as ShowTopGroup found it, kept to reuse its buffers
+	WindowGroup m_OnScreen;
+
+	// The desktop of each group by id with desktopPerGroup, empty until the
+	// group first needs one. Kept when a group is deleted, so undoing that
+	// finds it again.
+	std::vector<GUID> m_GroupDesktops;
+
+	std::deque<HWND> m_Moved;
+
+	// The model as of the last command, shared with the undo entries holding
+	// it, and the groups changed since. m_StateSerial is the last serial given
+	// to a state.
+	UndoHistory m_History{ MaxUndo };
+	GroupsStatePtr m_State;
+	std::uint64_t m_StateSerial = 0;
+	std::vector<GroupId> m_Touched;
+
+	SwitchReport m_LastSwitch;
+
+	// Moves of the command being recorded for undo, if any. m_Log is the one
+	// every command records into, so its buffers are reused.
+	MoveLog* m_MoveLog = nullptr;
+	MoveLog m_Log;
+
+	// What each group member is, for saving. Asked for once per window.
+	std::unordered_map<HWND, WindowIdentity> m_Identities;
+
+	HWND m_hWnd = nullptr;
+
+	IShellBackend* m_Shell = nullptr;
+	FnReport m_Report;
+	FnProgress m_Progress;
+	MovePool* m_Pool = nullptr;
+
+	GroupsOptions m_Opts;
+
+	DesktopCache m_Cache;
+	DesktopRegistry m_Registry;
+	ViewCache m_Views;
+	WindowFilter m_Filter;
+
+	// Window events on their way in, and what they told us of the windows
+	// some group has held: the hidden ones, and the ones closed since the
+	// last resync so an undo doesn't bring them back
+	WindowEventQueue m_Events;
+	DWORD m_EventsCookie = 0;
+	std::vector<WindowEventQueue::Event> m_EventBatch;
+	std::unordered_set<HWND> m_Hidden;
+	std::unordered_set<HWND> m_Dead;
+	WindowTrackStats m_WindowStats;
+
+	// The groups holding each window, by slot, for taking a closed window out
+	// of them without looking at every group. Kept up lazily: m_Reindex has
+	// the groups changed since, each once as m_Queued marks them, m_Indexed
+	// what the index has for each group, and all of it is rebuilt once slots
+	// are handed out anew.
+	std::vector<std::vector<GroupId>> m_Holders;
+	std::vector<std::vector<std::uint32_t>> m_Indexed;
+	std::vector<GroupId> m_Reindex;
+	std::vector<char> m_Queued;
+	bool m_HoldersValid = false;
+
+	// Sorts windows shown for the first time into the groups the rules name.
+	// m_Fresh collects them from a batch of events in the order they came,
+	// m_FreshSet the same windows to look them up, m_Tracking keeps the
+	// moves that park them from draining the next batch halfway.
+	WindowRules m_Rules;
+	RuleStats m_RuleStats;
+	std::vector<HWND> m_Fresh;
+	std::unordered_set<HWND> m_FreshSet;
+
+	// The group a rule put a window in and the last state serial before it
+	// did, so restoring a state from before keeps the window in. Until the
+	// window closes.
+	struct RuledIn
+	{
+		GroupId id;
+		std::uint64_t after;
+	};
+	std::unordered_map<HWND, RuledIn> m_Ruled;
+	bool m_Tracking = false;
+
+	size_t TrackWindows();
+
+	// Snapshot of the command currently running, if any
+	WindowSnapshot* m_Snapshot = nullptr;
+	bool m_InCommand = false;
+
+	// What GroupsPrefetch readied for the next command: the snapshot and the
+	// diffs for rotating the whole stack up and down from the top it saw.
+	// Spent, or dropped, by the next command either way.
+	struct Prefetch
+	{
+		struct Plan
+		{
+			GroupId target = NoGroup;
+			GroupDiff diff;
+		};
+
+		bool ready = false;
+		bool used = false;          // the running command started from it
+		WindowSnapshot snap;
+		std::vector<HWND> windows;  // every top level window, sorted, without window events
+		size_t turnover = 0;        // windows opened and closed when taken, with them
+		size_t changes = 0;         // DesktopCache::Changes when taken
+		GroupId top = NoGroup;
+		Plan plans[2];              // RotateUp, RotateDown
+
+		void Clear()
+		{
+			ready = false;
+			used = false;
+			snap.Clear();
+			windows.clear();
+			turnover = 0;
+			top = NoGroup;
+			for (auto& plan : plans)
+			{
+				plan.target = NoGroup;
+				plan.diff.Clear();
+			}
+		}
+	};
+	Prefetch m_Prefetch;
+	PrefetchStats m_PrefetchStats;
+
+	// prefetches gone stale in a row, see StalePrefetches
+	size_t m_StaleRun = 0;
+	size_t m_IdleChances = 0;
+
+	// Windows opened or closed as far as the window events tell, a lost batch
+	// may have held any
+	size_t WindowTurnover()
+	{
+		return m_WindowStats.turnover + m_WindowStats.lost;
+	}
+
+	// Nothing the snapshot was taken from changed: no notification or resync
+	// found anything new and the same windows are open. Window order doesn't
+	// matter, clicking one to the front isn't a change. The command took in
+	// the window events before this, without them EnumWindows tells.
+	bool PrefetchFresh()
+	{
+		if (!m_Prefetch.ready)
+			return false;
+
+		bool fresh = m_Cache.Active() && m_Cache.Changes() == m_Prefetch.changes;
+		if (fresh && m_EventsCookie)
+			fresh = WindowTurnover() == m_Prefetch.turnover;
+		else if (fresh)
+		{
+			std::vector<HWND> all;
+			m_Shell->EnumTopLevelWindows(all);
+			std::sort(all.begin(), all.end());
+			fresh = all == m_Prefetch.windows;
+		}
+
+		m_StaleRun = fresh ? 0 : m_StaleRun + 1;
+		if (!fresh)
+			++m_PrefetchStats.stale;
+		return fresh;
+	}
+
+	// The stack given to GroupsInit, its groups span every monitor
+	IGroupList* m_Whole = nullptr;
+
+	// One stack per monitor, made the first time a command asks for it. A
+	// deque so the lists stay where they are as more are added.
+	struct MonitorStack
+	{
+		HMONITOR monitor;
+		VectorGroupList list;
+		std::int64_t rotated = 0;
+	};
+	std::deque<MonitorStack> m_Monitors;
+
+	// For GroupsStackMarks: any change to a stack but a rotation, or to a
+	// group name, and the rotations of the whole stack
+	std::uint64_t m_StackEdits = 0;
+	std::int64_t m_WholeRotated = 0;
+
+	// The stack the running command works on and its monitor: m_Whole and
+	// null unless the command is for one monitor
+	IGroupList* m_List = nullptr;
+	HMONITOR m_Monitor = nullptr;
+
+	// Brackets a hotkey command. Takes the window snapshot unless an outer
+	// command already did, nested commands (DeleteGroup -> ShowTopGroup) share
+	// it, or a prefetch still holds. Without notifications the desktop
+	// registry can't know what changed since the last command, so it is
+	// rebuilt once per command instead.
+	class CommandScope
+	{
+	public:
+		explicit CommandScope(bool snapshot = true)
+		{
+			if (m_InCommand)
+				return;
+
+			outer = true;
+			m_InCommand = true;
+
+			// no command works on a window that closed before it
+			TrackWindows();
+
+			if (!m_Cache.Active())
+				m_Registry.Invalidate();
+
+			if (!snapshot || !m_Opts.snapshot)
+				return;
+
+			// the prefetch is spent on this command whether it is used or
+			// not, a command without a snapshot leaves it to Changes
+			spends = true;
+			if (PrefetchFresh())
+			{
+				m_Prefetch.used = true;
+				m_Snapshot = &m_Prefetch.snap;
+				++m_PrefetchStats.used;
+			}
+			else if (SUCCEEDED(snap.Capture(m_Shell, &m_Cache, &m_Views)))
+				m_Snapshot = &snap;
+		}
+
+		~CommandScope()
+		{
+			if (!outer)
+				return;
+			m_InCommand = false;
+			m_Snapshot = nullptr;
+
+			if (spends)
+				m_Prefetch.Clear();
+		}
+
+	private:
+		bool outer = false;
+		bool spends = false;
+		WindowSnapshot snap;
+	};
+
+	DesktopRegistry* Desktops()
+	{
+		bool fresh = m_Registry.Valid()
+			&& m_Opts.desktopRegistry
+			&& (m_Cache.Active() || m_InCommand);
+
+		if (!fresh && !m_Registry.Refresh(m_Shell, m_hWnd))
+			return nullptr;
+
+		return &m_Registry;
+	}
+
+	void Report(const wchar_t* msg)
+	{
+		if (m_Report)
+			m_Report(msg);
+	}
+
+	size_t WrapIdx(size_t curIdx, size_t max, int dir)
+	{
+		int idx = ((int)curIdx) + dir;
+		while (idx < 0) { idx += (int)max; }
+		while (idx >= (int)max) { idx -= (int)max; }
+		return (size_t)idx;
+	}
+
+	// Stack 0 is m_Whole, the monitors' follow in the order they were made,
+	// the same numbering GroupsState uses
+	size_t StackCount()
+	{
+		return m_Monitors.size() + 1;
+	}
+
+	IGroupList* StackAt(size_t idx)
+	{
+		return idx == 0 ? m_Whole : &m_Monitors[idx - 1].list;
+	}
+
+	// RotateUp steps a monitor's stack took, RotateDown ones negative
+	std::int64_t& StackRotated(HMONITOR monitor)
+	{
+		for (auto& stack : m_Monitors)
+		{
+			if (stack.monitor == monitor)
+				return stack.rotated;
+		}
+		return m_WholeRotated;
+	}
+
+	// null for a monitor without a stack, unless make
+	IGroupList* MonitorList(HMONITOR monitor, bool make)
+	{
+		if (!monitor)
+			return m_Whole;
+
+		for (auto& stack : m_Monitors)
+		{
+			if (stack.monitor == monitor)
+				return &stack.list;
+		}
+
+		if (!make)
+			return nullptr;
+		return &m_Monitors.emplace_back(MonitorStack{ monitor, {} }).list;
+	}
+
+	// Points m_List at the stack of a monitor for the command, null for the
+	// whole one. Put back on the way out so a nested command can pick its own.
+	class StackScope
+	{
+	public:
+		explicit StackScope(HMONITOR monitor)
+			: list(m_List)
+			, was(m_Monitor)
+		{
+			m_List = MonitorList(monitor, true);
+			m_Monitor = monitor;
+		}
+
+		~StackScope()
+		{
+			m_List = list;
+			m_Monitor = was;
+		}
+
+	private:
+		IGroupList* list;
+		HMONITOR was;
+	};
+
+	// Leaves out the windows from first on that MonitorFromWindow puts on
+	// another monitor than the stack of the command, if it has one
+	void KeepOnMonitor(std::vector<HWND>& wins, size_t first)
+	{
+		if (!m_Monitor)
+			return;
+
+		auto keep = std::remove_if(wins.begin() + (std::ptrdiff_t)first, wins.end(), [](HWND hwnd) {
+			HMONITOR at = nullptr;
+			return FAILED(m_Shell->GetWindowMonitor(hwnd, &at)) || at != m_Monitor;
+		});
+		wins.erase(keep, wins.end());
+	}
+
+	HRESULT IsOnCurrent(HWND hwnd, BOOL* onDesk)
+	{
+		if (m_Snapshot)
+		{
+			auto entry = m_Snapshot->Find(hwnd);
+			if (!entry) return E_INVALIDARG;
+			*onDesk = m_Snapshot->IsOnCurrent(*entry);
+			return S_OK;
+		}
+		if (m_Cache.Active())
+			return m_Cache.IsWindowOnCurrentDesktop(hwnd, onDesk);
+		return m_Shell->IsWindowOnCurrentVirtualDesktop(hwnd, onDesk);
+	}
+
+	// The top level windows worth asking explorer about
+	void EnumCandidates(std::vector<HWND>& wins)
+	{
+		m_Shell->EnumTopLevelWindows(wins);
+		if (m_Opts.filterWindows)
+			m_Filter.Apply(m_Shell, wins);
+	}
+
+	// On a monitor's stack only that monitor's windows are on screen
+	void EnumCurrent(std::vector<HWND>& wins)
+	{
+		size_t first = wins.size();
+
+		if (m_Snapshot)
+			m_Snapshot->Current(wins);
+		else
+		{
+			std::vector<HWND> all;
+			EnumCandidates(all);
+
+			for (const auto& hwnd : all)
+			{
+				BOOL onDesk = FALSE;
+				if (SUCCEEDED(IsOnCurrent(hwnd, &onDesk)) && onDesk)
+					wins.push_back(hwnd);
+			}
+		}
+
+		KeepOnMonitor(wins, first);
+	}
+
+	// The same monitor filter as EnumCurrent, which leaves every window in
+	// for the commands that take no monitor
+	void EnumNotCurrent(std::vector<HWND>& wins)
+	{
+		size_t first = wins.size();
+
+		if (m_Snapshot)
+			m_Snapshot->NotCurrent(wins);
+		else
+		{
+			std::vector<HWND> all;
+			EnumCandidates(all);
+
+			for (const auto& hwnd : all)
+			{
+				BOOL onDesk = FALSE;
+				if (SUCCEEDED(IsOnCurrent(hwnd, &onDesk)) && !onDesk)
+					wins.push_back(hwnd);
+			}
+		}
+
+		KeepOnMonitor(wins, first);
+	}
+
+	HRESULT ViewForHwnd(HWND hWin, com_ptr<IApplicationView>& view)
+	{
+		if (m_Snapshot)
+		{
+			auto entry = m_Snapshot->Find(hWin);
+			if (!entry) return E_INVALIDARG;
+			view = com_ptr<IApplicationView>::Copy(entry->view);
+			return S_OK;
+		}
+		if (m_Views.Active())
+			return m_Views.GetView(hWin, view.Put());
+		return m_Shell->GetViewForHwnd(hWin, view.Put());
+	}
+
+	// The view of a window this thread already holds, without asking explorer
+	bool HeldView(HWND hWin, com_ptr<IApplicationView>& view)
+	{
+		if (m_Snapshot)
+		{
+			auto entry = m_Snapshot->Find(hWin);
+			if (!entry || !entry->view) return false;
+			view = com_ptr<IApplicationView>::Copy(entry->view);
+			return true;
+		}
+		return m_Views.Active() && m_Views.FindView(hWin, view.Put());
+	}
+
+	// Whether a batch can go on the views the cache holds, a snapshot is only
+	// worth taking when some window's view would have to be looked up
+	bool ViewsHeld(std::span<const HWND> wins)
+	{
+		if (!m_Cache.Active() || !m_Views.Active())
+			return false;
+		for (HWND hwnd : wins)
+		{
+			if (hwnd != m_hWnd && !m_Views.Holds(hwnd))
+				return false;
+		}
+		return true;
+	}
+
+	// The view may be what failed, the next move asks explorer for it again
+	HRESULT MoveView(HWND hWin, IApplicationView* view, IVirtualDesktop* desktop)
+	{
+		HRESULT hr = m_Shell->MoveViewToDesktop(view, desktop);
+		if (FAILED(hr))
+			m_Views.Forget(hWin);
+		return hr;
+	}
+
+	// Our move went through, keep the snapshot and cache in line with it.
+	// from is where it was, for undo, empty when that isn't known.
+	void MovedTo(HWND hWin, const GUID& from, const GUID& desktopId)
+	{
+		if (m_Snapshot)
+			m_Snapshot->SetDesktop(hWin, desktopId);
+		m_Cache.SetWindowDesktop(hWin, desktopId);
+		if (m_MoveLog && from != GUID{})
+			m_MoveLog->Moved(hWin, from, desktopId);
+	}
+
+	// Desktop of a window if we know it without asking the shell
+	bool KnownDesktop(HWND hWin, GUID* desktopId)
+	{
+		if (m_Snapshot)
+		{
+			auto entry = m_Snapshot->Find(hWin);
+			if (!entry) return false;
+			*desktopId = entry->desktop;
+			return true;
+		}
+		return m_Cache.Active() && SUCCEEDED(m_Cache.GetWindowDesktopId(hWin, desktopId));
+	}
+
+	// Where a window is before we move it, for the undo log. Empty when no
+	// command is being recorded, the shell is only asked when neither the
+	// snapshot nor the cache knows.
+	GUID DesktopBefore(HWND hWin)
+	{
+		GUID at{};
+		if (m_MoveLog && !KnownDesktop(hWin, &at) && FAILED(m_Shell->GetWindowDesktopId(hWin, &at)))
+			at = GUID{};
+		return at;
+	}
+
+	// Bulk moves for the commands, they don't look at the outcomes
+	void MoveAll(std::span<const HWND> wins, bool toCurrent)
+	{
+		if (wins.empty())
+			return;
+
+		auto desktops = Desktops();
+		if (!desktops) return;
+
+		int target = toCurrent ? desktops->Current() : desktops->Scratch();
+		if (target == DesktopRegistry::None) return;
+
+		std::vector<MoveOutcome> results;
+		MoveWindowsToDesktop(wins, desktops->IdAt(target), results);
+	}
+
+	void HideAll(std::span<const HWND> wins)
+	{
+		MoveAll(wins, false);
+	}
+
+	void ShowAll(std::span<const HWND> wins)
+	{
+		MoveAll(wins, true);
+	}
+
+	bool SwitchTo(DesktopRegistry& desktops, int idx)
+	{
+		if (FAILED(m_Shell->SwitchDesktop(desktops.At(idx))))
+			return false;
+		m_Cache.SetCurrentDesktop(desktops.IdAt(idx));
+		desktops.SetCurrent(desktops.IdAt(idx));
+		return true;
+	}
+
+	WindowGroup& Members(GroupId id)
+	{
+		if (m_Groups.size() < m_Names.Bound())
+			m_Groups.resize(m_Names.Bound());
+		return m_Groups[id];
+	}
+
+	// The group's members changed since the holders index last saw them
+	void Reindex(GroupId id)
+	{
+		if (!m_HoldersValid)
+			return;
+		if (m_Queued.size() <= id)
+			m_Queued.resize(id + 1, 0);
+		if (m_Queued[id])
+			return;
+		m_Queued[id] = 1;
+		m_Reindex.push_back(id);
+	}
+
+	// The group's record in m_State is out of date
+	void Touch(GroupId id)
+	{
+		m_Touched.push_back(id);
+		Reindex(id);
+	}
+
+	// Groups get a desktop each, only the whole stack's
+	bool OwnDesktops()
+	{
+		return m_Opts.desktopPerGroup && !m_Monitor;
+	}
+
+	GUID& GroupDesktop(GroupId id)
+	{
+		if (m_GroupDesktops.size() < m_Names.Bound())
+			m_GroupDesktops.resize(m_Names.Bound());
+		return m_GroupDesktops[id];
+	}
+
+	// A new group can have the id of a deleted one, it doesn't get its desktop
+	GroupId AddGroup(std::wstring_view name)
+	{
+		++m_StackEdits;
+		GroupId id = m_Names.Add(name);
+		if (id != NoGroup)
+			GroupDesktop(id) = GUID{};
+		return id;
+	}
+
+	// A group without a desktop takes the current one, unless a group has it
+	void AdoptDesktop(GroupId id)
+	{
+		auto desktops = Desktops();
+		if (GroupDesktop(id) != GUID{} || !desktops || desktops->Current() == DesktopRegistry::None)
+			return;
+
+		const GUID& current = desktops->IdAt(desktops->Current());
+		for (GroupId other = 0; other < m_GroupDesktops.size(); other++)
+		{
+			if (m_GroupDesktops[other] == current && m_Names.Contains(other))
+				return;
+		}
+		GroupDesktop(id) = current;
+	}
+
+	// What is on screen now becomes the group
+	void Capture(GroupId id)
+	{
+		if (OwnDesktops())
+			AdoptDesktop(id);
+
+		std::vector<HWND> current;
+		EnumCurrent(current);
+
+		auto& group = Members(id);
+		if (std::equal(current.begin(), current.end(), group.windows.begin(), group.windows.end()))
+			return;
+
+		group.Assign(current, m_Index);
+		Touch(id);
+	}
+
+	// Slots of windows no group holds any more are only given back here, once
+	// they outnumber the ones in use
+	void CompactIndex()
+	{
+		size_t used = 0;
+		for (const auto& group : m_Groups)
+			used += group.windows.size();
+		if (m_Index.Size() <= used * 2 + 256)
+			return;
+
+		m_Index.Clear();
+		for (auto& group : m_Groups)
+		{
+			std::vector<HWND> windows = std::move(group.windows);
+			group.Assign(windows, m_Index);
+		}
+		m_HoldersValid = false;
+	}
+
+	void SyncHolders()
+	{
+		if (!m_HoldersValid)
+		{
+			m_Holders.clear();
+			m_Indexed.clear();
+			m_Reindex.resize(m_Groups.size());
+			std::iota(m_Reindex.begin(), m_Reindex.end(), GroupId(0));
+			m_HoldersValid = true;
+		}
+		if (m_Reindex.empty())
+			return;
+
+		std::sort(m_Reindex.begin(), m_Reindex.end());
+		m_Reindex.erase(std::unique(m_Reindex.begin(), m_Reindex.end()), m_Reindex.end());
+		if (m_Indexed.size() < m_Groups.size())
+			m_Indexed.resize(m_Groups.size());
+
+		for (auto id : m_Reindex)
+		{
+			if (id >= m_Indexed.size())
+				continue;
+
+			auto& indexed = m_Indexed[id];
+			for (auto slot : indexed)
+				std::erase(m_Holders[slot], id);
+			indexed.clear();
+
+			if (!m_Names.Contains(id))
+				continue;
+
+			indexed = m_Groups[id].slots;
+			for (auto slot : indexed)
+			{
+				if (slot >= m_Holders.size())
+					m_Holders.resize(slot + 1);
+				m_Holders[slot].push_back(id);
+			}
+		}
+		for (auto id : m_Reindex)
+		{
+			if (id < m_Queued.size())
+				m_Queued[id] = 0;
+		}
+		m_Reindex.clear();
+	}
+
+	// Takes a closed window out of every group that holds it, returns how
+	// many did
+	size_t PruneWindow(HWND hWin)
+	{
+		auto slot = m_Index.Find(hWin);
+		if (slot == WindowIndex::None)
+			return 0;
+
+		SyncHolders();
+		if (slot >= m_Holders.size())
+			return 0;
+
+		// the index stays right for the holders without reindexing them, the
+		// slot is all that changed and its entry is gone
+		auto holders = std::move(m_Holders[slot]);
+		m_Holders[slot].clear();
+		for (auto id : holders)
+		{
+			m_Groups[id].Remove(slot);
+			m_Touched.push_back(id);
+		}
+		return holders.size();
+	}
+
+	// Every group against EnumWindows, for when events went missing
+	size_t SweepClosed()
+	{
+		TRACE_SCOPE("SweepClosed");
+
+		++m_WindowStats.sweeps;
+		m_Dead.clear();
+
+		std::vector<HWND> all;
+		m_Shell->EnumTopLevelWindows(all);
+		std::unordered_set<HWND> alive(all.begin(), all.end());
+		auto closed = [&alive](HWND hWin) { return alive.find(hWin) == alive.end(); };
+		std::erase_if(m_Ruled, [&closed](const auto& ruled) { return closed(ruled.first); });
+
+		size_t pruned = 0;
+		for (GroupId id = 0; id < m_Groups.size(); id++)
+		{
+			auto& group = m_Groups[id];
+			if (std::none_of(group.windows.begin(), group.windows.end(), closed))
+				continue;
+
+			std::vector<HWND> open = group.windows;
+			std::erase_if(open, closed);
+			pruned += group.windows.size() - open.size();
+			group.Assign(open, m_Index);
+			Touch(id);
+		}
+		return pruned;
+	}
+
+	// Top of a stack, its windows are the ones on screen
+	bool OnScreen(GroupId id)
+	{
+		GroupId top = NoGroup;
+		for (size_t i = 0; i < StackCount(); i++)
+		{
+			if (StackAt(i)->GetTop(top) && top == id)
+				return true;
+		}
+		return false;
+	}
+
+	// Where the windows of a group not on screen are kept
+	GUID ParkingDesktop(GroupId id)
+	{
+		auto desktops = Desktops();
+		if (!desktops)
+			return GUID{};
+
+		const GUID& own = GroupDesktop(id);
+		if (m_Opts.desktopPerGroup && own != GUID{} && desktops->IndexOf(own) != DesktopRegistry::None)
+			return own;
+
+		int scratch = desktops->Scratch();
+		return scratch == DesktopRegistry::None ? GUID{} : desktops->IdAt(scratch);
+	}
+
+	// The windows of m_Fresh the filter lets through are asked for their
+	// traits and join the group of the first rule matching them. One for a
+	// group that isn't on screen goes where that group is parked, it would
+	// be taken into the top group with the next capture otherwise.
+	void AssignByRules()
+	{
+		if (m_Fresh.empty())
+			return;
+
+		TRACE_SCOPE("AssignByRules");
+
+		std::vector<HWND> fresh = std::move(m_Fresh);
+		m_Fresh.clear();
+		m_FreshSet.clear();
+		if (m_Opts.filterWindows)
+			m_Filter.Apply(m_Shell, fresh);
+
+		std::vector<std::pair<GUID, std::vector<HWND>>> parked;
+		WindowTraits traits;
+		for (HWND hwnd : fresh)
+		{
+			if (FAILED(m_Shell->GetWindowTraits(hwnd, traits)))
+				continue;
+			++m_RuleStats.classified;
+
+			size_t rule = m_Rules.Match(traits);
+			if (rule == WindowRules::None)
+				continue;
+			++m_RuleStats.matched;
+
+			GroupId id = m_Names.Find(m_Rules.Rule(rule).group);
+			if (id == NoGroup)
+			{
+				++m_RuleStats.missing;
+				continue;
+			}
+
+			auto slot = m_Index.Add(hwnd);
+			auto& group = Members(id);
+			if (group.set.Test(slot))
+				continue;
+			group.Add(hwnd, slot);
+			Touch(id);
+			m_Ruled[hwnd] = RuledIn{ id, m_StateSerial };
+			++m_RuleStats.assigned;
+
+			if (OnScreen(id))
+				continue;
+			GUID to = ParkingDesktop(id);
+			if (to == GUID{})
+				continue;
+			auto it = std::find_if(parked.begin(), parked.end(), [&](const auto& p) { return p.first == to; });
+			if (it == parked.end())
+				it = parked.insert(parked.end(), { to, {} });
+			(*it).second.push_back(hwnd);
+		}
+
+		if (parked.empty())
+			return;
+
+		CommandScope command(false);
+		std::vector<MoveOutcome> results;
+		for (const auto& batch : parked)
+			MoveWindowsToDesktop(batch.second, batch.first, results);
+		for (const auto& out : results)
+			m_RuleStats.parked += out.result == MoveResult::Moved;
+	}
+
+	size_t TrackWindows()
+	{
+		if (!m_EventsCookie || m_Tracking)
+			return 0;
+
+		m_EventBatch.clear();
+		bool whole = m_Events.Drain(m_EventBatch);
+		if (whole && m_EventBatch.empty())
+			return 0;
+
+		TRACE_SCOPE("TrackWindows");
+
+		++m_WindowStats.batches;
+		m_WindowStats.events += m_EventBatch.size();
+
+		size_t pruned = 0;
+		for (const auto& ev : m_EventBatch)
+		{
+			if (ev.kind == WindowEvent::Created || ev.kind == WindowEvent::Destroyed)
+				++m_WindowStats.turnover;
+
+			// only what some group has held is worth remembering
+			bool known = m_Index.Find(ev.hwnd) != WindowIndex::None;
+			switch (ev.kind)
+			{
+			case WindowEvent::Created:
+				// a handle of a closed window given out again
+				m_Dead.erase(ev.hwnd);
+				m_Hidden.erase(ev.hwnd);
+				m_Cache.Recheck(ev.hwnd);
+				break;
+			case WindowEvent::Destroyed:
+				m_Ruled.erase(ev.hwnd);
+				if (!known)
+				{
+					if (m_FreshSet.erase(ev.hwnd))
+						std::erase(m_Fresh, ev.hwnd);
+					break;
+				}
+				m_Dead.insert(ev.hwnd);
+				m_Hidden.erase(ev.hwnd);
+				m_Identities.erase(ev.hwnd);
+				std::erase(m_Moved, ev.hwnd);
+				pruned += PruneWindow(ev.hwnd);
+				break;
+			case WindowEvent::Shown:
+				m_Hidden.erase(ev.hwnd);
+				m_Cache.Recheck(ev.hwnd);
+				if (!known && !m_Rules.Empty() && m_FreshSet.insert(ev.hwnd).second)
+					m_Fresh.push_back(ev.hwnd);
+				break;
+			case WindowEvent::Hidden:
+				if (known)
+					m_Hidden.insert(ev.hwnd);
+				break;
+			}
+		}
+
+		if (!whole)
+		{
+			++m_WindowStats.lost;
+			pruned += SweepClosed();
+		}
+
+		m_WindowStats.pruned += pruned;
+
+		m_Tracking = true;
+		AssignByRules();
+		m_Tracking = false;
+
+		return pruned;
+	}
+
+	void ResetTracking()
+	{
+		m_EventBatch.clear();
+		m_Hidden.clear();
+		m_Dead.clear();
+		m_WindowStats = WindowTrackStats();
+		m_Holders.clear();
+		m_Indexed.clear();
+		m_Reindex.clear();
+		m_Queued.clear();
+		m_HoldersValid = false;
+		m_Fresh.clear();
+		m_FreshSet.clear();
+		m_Ruled.clear();
+		m_RuleStats = RuleStats();
+	}
+
+	// name, name 2, name 3, ...
+	std::wstring UniqueGroupName(const std::wstring& name)
+	{
+		std::wstring ret = name;
+		for (int n = 2; m_Names.Find(ret) != NoGroup; n++)
+			ret = name + TEXT(" ") + std::to_wstring(n);
+		return ret;
+	}
+
+	// A stack, top first
+	void GetOrder(IGroupList* list, std::vector<GroupId>& order)
+	{
+		GroupId id = NoGroup;
+		for (size_t i = 0; list->GetAt(i, id); i++)
+			order.push_back(id);
+	}
+
+	void SetOrder(IGroupList* list, const std::vector<GroupId>& order)
+	{
+		++m_StackEdits;
+		GroupId top = NoGroup;
+		while (list->DelTop(top))
+			;
+		for (size_t i = order.size(); i-- > 0;)
+			list->AddTop(order[i]);
+	}
+
+	bool SameOrder(IGroupList* list, const std::vector<GroupId>& order)
+	{
+		GroupId id = NoGroup;
+		size_t n = 0;
+		for (; list->GetAt(n, id); n++)
+		{
+			if (n >= order.size() || order[n] != id)
+				return false;
+		}
+		return n == order.size();
+	}
+
+	// Brings m_State up to the model. Only the touched groups get a new
+	// record, the rest are shared with the state before.
+	void CommitState()
+	{
+		if (!m_Whole || !m_State)
+			return;
+
+		static const std::vector<GroupId> none;
+		auto recorded = [](size_t idx) -> const std::vector<GroupId>& {
+			return idx < m_State->StackCount() ? m_State->Stack(idx) : none;
+		};
+
+		bool sameOrder = true;
+		for (size_t i = 0; i < StackCount() && sameOrder; i++)
+			sameOrder = SameOrder(StackAt(i), recorded(i));
+		if (sameOrder && m_Touched.empty())
+			return;
+
+		auto state = std::make_shared<GroupsState>();
+		state->monitors.resize(m_Monitors.size());
+		for (size_t i = 0; i < StackCount(); i++)
+		{
+			state->Stack(i).reserve(recorded(i).size() + 1);
+			GetOrder(StackAt(i), state->Stack(i));
+		}
+
+		state->groups = m_State->groups;
+		state->groups.resize(std::max(state->groups.size(), m_Names.Bound()));
+
+		std::sort(m_Touched.begin(), m_Touched.end());
+		m_Touched.erase(std::unique(m_Touched.begin(), m_Touched.end()), m_Touched.end());
+		for (auto touched : m_Touched)
+		{
+			if (m_Names.Contains(touched))
+				state->groups[touched] = std::make_shared<const GroupRecord>(GroupRecord{ m_Names.Name(touched), Members(touched).windows });
+			else
+				state->groups[touched] = nullptr;
+		}
+		m_Touched.clear();
+
+		state->serial = ++m_StateSerial;
+		m_State = std::move(state);
+	}
+
+	// Brackets a command that can be undone. The outermost one keeps the state
+	// the command started from and logs every window moved until it ends, then
+	// pushes an entry when the model changed or a window ended up elsewhere.
+	class UndoScope
+	{
+	public:
+		explicit UndoScope(bool record = true)
+		{
+			if (!record || m_MoveLog || !m_State)
+				return;
+
+			// what window events did to the groups isn't the command's to undo
+			TrackWindows();
+
+			CommitState();
+			before = m_State;
+			outer = true;
+			m_Log.Clear();
+			m_MoveLog = &m_Log;
+		}
+
+		~UndoScope()
+		{
+			if (!outer)
+				return;
+			m_MoveLog = nullptr;
+
+			CommitState();
+			if (before == m_State && m_Log.Empty())
+				return;
+
+			UndoEntry entry{ before, m_State, {} };
+			m_Log.Take(entry.moves);
+			if (entry.before == entry.after && entry.moves.empty())
+				return;
+
+			m_History.Push(std::move(entry));
+		}
+
+	private:
+		bool outer = false;
+		GroupsStatePtr before;
+	};
+
+	// Puts the model back as a recorded state had it. Only groups whose record
+	// differs from the current one are rebuilt.
+	void Restore(const GroupsStatePtr& state)
+	{
+		CommitState();
+
+		std::vector<GroupId> changed;
+		size_t bound = std::max(m_State->groups.size(), state->groups.size());
+		for (GroupId id = 1; id < bound; id++)
+		{
+			if (m_State->Find(id) != state->Find(id))
+				changed.push_back(id);
+		}
+
+		// every changed name is let go before any is put back, a name can have
+		// moved between ids
+		for (auto id : changed)
+			m_Names.Remove(id);
+
+		for (auto id : changed)
+		{
+			auto record = state->Find(id);
+			if (!record)
+			{
+				Members(id).Clear();
+				Reindex(id);
+				continue;
+			}
+
+			m_Names.Insert(id, record->name);
+			auto& group = Members(id);
+			group.Assign(record->windows, m_Index);
+			Reindex(id);
+
+			// a window closed since the state was recorded stays out
+			auto dead = [](HWND hWin) { return m_Dead.find(hWin) != m_Dead.end(); };
+			if (!m_Dead.empty() && std::any_of(group.windows.begin(), group.windows.end(), dead))
+			{
+				std::vector<HWND> open = group.windows;
+				std::erase_if(open, dead);
+				group.Assign(open, m_Index);
+				Touch(id);
+			}
+		}
+
+		// rules aren't undone, a window one sorted in after the state was
+		// recorded stays in its group
+		for (const auto& [hwnd, ruled] : m_Ruled)
+		{
+			if (ruled.after < state->serial || !state->Find(ruled.id)
+				|| !std::binary_search(changed.begin(), changed.end(), ruled.id))
+				continue;
+
+			auto slot = m_Index.Add(hwnd);
+			auto& group = Members(ruled.id);
+			if (group.set.Test(slot))
+				continue;
+			group.Add(hwnd, slot);
+			Touch(ruled.id);
+		}
+
+		// a monitor's stack made since the state was recorded ends up empty
+		for (size_t i = 0; i < StackCount(); i++)
+			SetOrder(StackAt(i), i < state->StackCount() ? state->Stack(i) : std::vector<GroupId>());
+
+		m_State = state;
+	}
+
+	// Sends the windows of a recorded command back where they were, or on to
+	// where it left them. One batch per desktop, the current one first.
+	void Replay(std::span<const WindowMove> moves, bool undo)
+	{
+		std::vector<std::pair<GUID, std::vector<HWND>>> batches;
+		for (const auto& move : moves)
+		{
+			const GUID& to = undo ? move.from : move.to;
+			auto it = std::find_if(batches.begin(), batches.end(), [&](const auto& b) { return b.first == to; });
+			if (it == batches.end())
+				it = batches.insert(batches.end(), { to, {} });
+			(*it).second.push_back(move.hwnd);
+		}
+
+		auto desktops = Desktops();
+		if (desktops && desktops->Current() != DesktopRegistry::None)
+		{
+			GUID current = desktops->IdAt(desktops->Current());
+			std::stable_partition(batches.begin(), batches.end(), [&](const auto& b) { return b.first == current; });
+		}
+
+		std::vector<MoveOutcome> results;
+		for (const auto& batch : batches)
+			MoveWindowsToDesktop(batch.second, batch.first, results);
+	}
+
+	// Runs a group switch as one transaction: shows, hides, retries what
+	// failed, and rolls back when something still fails. Every outcome ends up
+	// in m_LastSwitch. false when the switch was rolled back.
+	bool RunSwitch(const GroupDiff& diff)
+	{
+		TRACE_SCOPE("RunSwitch");
+
+		auto& report = m_LastSwitch;
+		report.Clear();
+
+		auto desktops = Desktops();
+		if (!desktops || desktops->Current() == DesktopRegistry::None || desktops->Scratch() == DesktopRegistry::None)
+			return false;
+
+		const GUID current = desktops->IdAt(desktops->Current());
+		const GUID scratch = desktops->IdAt(desktops->Scratch());
+
+		// showing first puts something on screen after one move, not after
+		// every hide
+		if (FAILED(MoveWindowsToDesktop(diff.toShow, current, report.outcomes))
+			|| FAILED(MoveWindowsToDesktop(diff.toHide, scratch, report.outcomes)))
+		{
+			report.outcomes.resize(diff.toShow.size() + diff.toHide.size(), MoveOutcome{ nullptr, MoveResult::Failed, E_FAIL });
+		}
+		const size_t shown = diff.toShow.size();
+
+		// a window that is gone has nothing to move back, only failed moves count
+		std::vector<size_t> failed;
+		for (int attempt = 0; ; attempt++)
+		{
+			failed.clear();
+			for (size_t i = 0; i < report.outcomes.size(); i++)
+			{
+				if (report.outcomes[i].result == MoveResult::Failed)
+					failed.push_back(i);
+			}
+			if (failed.empty() || attempt == SwitchRetries)
+				break;
+
+			report.retried += failed.size();
+			for (bool show : { true, false })
+			{
+				std::vector<HWND> again;
+				for (auto i : failed)
+				{
+					if ((i < shown) == show)
+						again.push_back(show ? diff.toShow[i] : diff.toHide[i - shown]);
+				}
+				if (again.empty())
+					continue;
+
+				std::vector<MoveOutcome> retry;
+				MoveWindowsToDesktop(again, show ? current : scratch, retry);
+				size_t k = 0;
+				for (auto i : failed)
+				{
+					if ((i < shown) == show && k < retry.size())
+						report.outcomes[i] = retry[k++];
+				}
+			}
+		}
+
+		if (failed.empty())
+			return true;
+
+		// put back what did move, the shown ones hidden again and the other way
+		report.committed = false;
+		std::vector<HWND> unshow, unhide;
+		for (size_t i = 0; i < report.outcomes.size(); i++)
+		{
+			if (report.outcomes[i].result != MoveResult::Moved)
+				continue;
+			(i < shown ? unshow : unhide).push_back(report.outcomes[i].hwnd);
+		}
+		MoveWindowsToDesktop(unhide, current, report.rollback);
+		MoveWindowsToDesktop(unshow, scratch, report.rollback);
+
+		Report(TEXT("Some windows could not be moved, the group switch was taken back"));
+		return false;
+	}
+
+	// Index of the group's desktop, made when it has none or the one it had
+	// was closed
+	int GroupDesktopIndex(GroupId id)
+	{
+		auto desktops = Desktops();
+		if (!desktops)
+			return DesktopRegistry::None;
+
+		GUID& own = GroupDesktop(id);
+		if (own != GUID{})
+		{
+			int idx = desktops->IndexOf(own);
+			if (idx != DesktopRegistry::None)
+				return idx;
+		}
+
+		com_ptr<IVirtualDesktop> made;
+		GUID madeId{};
+		if (FAILED(m_Shell->CreateDesktop(made.Put())) || FAILED(made->GetID(&madeId)))
+			return DesktopRegistry::None;
+		own = madeId;
+
+		m_Registry.Invalidate();
+		desktops = Desktops();
+		return desktops ? desktops->IndexOf(madeId) : DesktopRegistry::None;
+	}
+
+	// The switch with a desktop per group: the group's windows that are
+	// somewhere else, like the ones it shares with another group, are moved
+	// to its desktop and then that is switched to. A move failing leaves the
+	// window out, only the switch failing counts. false when it did.
+	bool SwitchToGroupDesktop(GroupId id)
+	{
+		TRACE_SCOPE("SwitchToGroupDesktop");
+
+		auto& report = m_LastSwitch;
+		report.Clear();
+
+		int idx = GroupDesktopIndex(id);
+		if (idx == DesktopRegistry::None)
+		{
+			report.committed = false;
+			Report(TEXT("Failed to make a desktop for the group"));
+			return false;
+		}
+
+		GUID target = m_Registry.IdAt(idx);
+		MoveWindowsToDesktop(Members(id).windows, target, report.outcomes);
+
+		auto desktops = Desktops();
+		idx = desktops ? desktops->IndexOf(target) : DesktopRegistry::None;
+		if (idx == DesktopRegistry::None || (idx != desktops->Current() && !SwitchTo(*desktops, idx)))
+		{
+			report.committed = false;
+			Report(TEXT("Failed to switch to the group's desktop"));
+			return false;
+		}
+		return true;
+	}
+
+	// The prefetched moves for a rotation of the whole stack from top to
+	// target, when the command started from the prefetch. Capturing top gave
+	// it the windows the prefetch saw on screen, so the diff still holds.
+	bool TakePlan(GroupId top, GroupId target, GroupDiff& diff)
+	{
+		if (!m_Prefetch.used || m_Prefetch.top != top || m_Monitor)
+			return false;
+
+		for (auto& plan : m_Prefetch.plans)
+		{
+			if (plan.target != target)
+				continue;
+			std::swap(diff, plan.diff);
+			plan.target = NoGroup;
+			++m_PrefetchStats.plans;
+			return true;
+		}
+		return false;
+	}
+
+	// Undo and redo put the stack back, the top group's desktop goes with it
+	void SwitchToTopDesktop()
+	{
+		GroupId top = NoGroup;
+		if (!m_Opts.desktopPerGroup || !m_Whole->GetTop(top) || top >= m_GroupDesktops.size() || m_GroupDesktops[top] == GUID{})
+			return;
+
+		auto desktops = Desktops();
+		if (!desktops)
+			return;
+
+		int idx = desktops->IndexOf(m_GroupDesktops[top]);
+		if (idx != DesktopRegistry::None && idx != desktops->Current())
+			SwitchTo(*desktops, idx);
+	}
+
+	std::wstring NextGroupName()
+	{
+		static int agroupidx = 0;
+
+		std::wstring ret;
+
+		while (ret.empty() || m_Names.Find(ret) != NoGroup)
+		{
+			std::wstringstream str;
+			str << TEXT("AutoGroup") << (++agroupidx);
+			ret = str.str();
+		}
+
+		return ret;
+	}
+}
+
+BOOL VectorGroupList::GetTop(GroupId& id)
+{
+	if (mItems.empty())
+		return FALSE;
+	id = mItems[0];
+	return TRUE;
+}
+
+BOOL VectorGroupList::GetAt(size_t pos, GroupId& id)
+{
+	if (pos >= mItems.size())
+		return FALSE;
+	id = mItems[pos];
+	return TRUE;
+}
+
+BOOL VectorGroupList::AddTop(GroupId id)
+{
+	mItems.insert(mItems.begin(), id);
+	return TRUE;
+}
+
+BOOL VectorGroupList::DelTop(GroupId& deleted)
+{
+	if (mItems.empty())
+		return FALSE;
+	deleted = mItems[0];
+	mItems.erase(mItems.begin());
+	return TRUE;
+}
+
+BOOL VectorGroupList::RotateUp()
+{
+	if (mItems.empty())
+		return FALSE;
+	std::rotate(mItems.begin(), mItems.begin() + 1, mItems.end());
+	return TRUE;
+}
+
+BOOL VectorGroupList::RotateDown()
+{
+	if (mItems.empty())
+		return FALSE;
+	std::rotate(mItems.begin(), mItems.end() - 1, mItems.end());
+	return TRUE;
+}
+
+void GroupsInit(IShellBackend* shell, IGroupList* list, HWND hSelf, FnReport&& report, const GroupsOptions& opts)
+{
+	m_Shell = shell;
+	m_Whole = list;
+	m_List = list;
+	m_Monitor = nullptr;
+	m_Monitors.clear();
+	++m_StackEdits;
+	m_hWnd = hSelf;
+	m_Report = std::move(report);
+	m_Opts = opts;
+	m_Names.Clear();
+	m_Groups.clear();
+	m_Index.Clear();
+	m_OnScreen.Clear();
+	m_GroupDesktops.clear();
+	m_Moved.clear();
+	m_Identities.clear();
+	m_History.Clear();
+	m_LastSwitch.Clear();
+	m_Prefetch.Clear();
+	m_PrefetchStats = PrefetchStats();
+	m_StaleRun = 0;
+	m_IdleChances = 0;
+	ResetTracking();
+	m_State = std::make_shared<const GroupsState>();
+	m_Touched.clear();
+
+	m_Registry.Invalidate();
+
+	m_Filter.SetOptions(m_Opts.windowFilter);
+	m_Filter.ResetStats();
+
+	if (m_Opts.viewCache)
+		m_Views.Attach(shell);
+	else
+		m_Views.Detach();
+
+	// without notifications every query goes to the shell
+	if (m_Opts.desktopCache)
+		m_Cache.Attach(shell, &m_Registry, &m_Views, m_Opts.filterWindows ? &m_Filter : nullptr);
+	else
+		m_Cache.Detach();
+
+	// what was queued for an earlier shell is of no use
+	std::vector<WindowEventQueue::Event> stale;
+	m_Events.Drain(stale);
+	if (!m_Opts.trackWindows || FAILED(shell->RegisterForWindowEvents(&m_Events, &m_EventsCookie)))
+		m_EventsCookie = 0;
+}
+
+void GroupsShutdown()
+{
+	if (m_EventsCookie)
+		m_Shell->UnregisterForWindowEvents(m_EventsCookie);
+	m_EventsCookie = 0;
+	ResetTracking();
+
+	m_Cache.Detach();
+	m_Views.Detach();
+	m_Rules.Clear();
+	m_Registry.Invalidate();
+	m_Names.Clear();
+	m_Groups.clear();
+	m_Index.Clear();
+	m_OnScreen.Clear();
+	m_GroupDesktops.clear();
+	m_Moved.clear();
+	m_Identities.clear();
+	m_History.Clear();
+	m_LastSwitch.Clear();
+	m_Prefetch.Clear();
+	m_State = nullptr;
+	m_Touched.clear();
+	m_Shell = nullptr;
+	m_Whole = nullptr;
+	m_List = nullptr;
+	m_Monitor = nullptr;
+	m_Monitors.clear();
+	m_Report = nullptr;
+	m_Progress = nullptr;
+	m_Pool = nullptr;
+}
+
+void GroupsSetProgress(FnProgress&& progress)
+{
+	m_Progress = std::move(progress);
+}
+
+void GroupsSetMovePool(MovePool* pool)
+{
+	m_Pool = pool && pool->Threads() ? pool : nullptr;
+}
+
+const std::vector<HWND>* GroupMembers(GroupId id)
+{
+	if (!m_Names.Contains(id))
+		return nullptr;
+	return &Members(id).windows;
+}
+
+size_t GroupCount()
+{
+	return m_Names.Count();
+}
+
+const std::wstring& GroupName(GroupId id)
+{
+	return m_Names.Name(id);
+}
+
+GroupId FindGroup(std::wstring_view name)
+{
+	return m_Names.Find(name);
+}
+
+void GetGroupStack(HMONITOR monitor, std::vector<GroupId>& order)
+{
+	if (auto list = MonitorList(monitor, false))
+		GetOrder(list, order);
+}
+
+GroupStackMarks GroupsStackMarks(HMONITOR monitor)
+{
+	return GroupStackMarks{ m_StackEdits, StackRotated(monitor) };
+}
+
+bool GroupsSave(const char* file, const std::vector<GroupId>& order, const FnWindowKey& key)
+{
+	TRACE_SCOPE("GroupsSave");
+
+	// Each window is asked once, the ones no longer in a group are let go.
+	// Failures are kept as an empty identity so they aren't asked again.
+	std::unordered_map<HWND, WindowIdentity> known;
+	for (const auto& group : m_Groups)
+	{
+		for (auto hWin : group.windows)
+		{
+			auto it = m_Identities.find(hWin);
+			if (it != m_Identities.end())
+			{
+				known.insert(m_Identities.extract(it));
+				continue;
+			}
+
+			WindowTraits traits;
+			if (SUCCEEDED(m_Shell->GetWindowTraits(hWin, traits)))
+				known.emplace(hWin, MakeWindowIdentity(traits));
+			else
+				known.emplace(hWin, WindowIdentity());
+		}
+	}
+	m_Identities.swap(known);
+
+	std::vector<GroupStoreEntry> entries;
+	entries.reserve(order.size());
+	for (auto id : order)
+		entries.push_back({ m_Names.Name(id), GroupMembers(id) });
+
+	return GroupStoreWrite(file, entries, key, [](HWND hWin) -> const WindowIdentity* {
+		auto it = m_Identities.find(hWin);
+		if (it == m_Identities.end() || (*it).second == WindowIdentity())
+			return nullptr;
+		return &(*it).second;
+	});
+}
+
+bool GroupsLoad(const char* file, const FnWindowKey& key)
+{
+	TRACE_SCOPE("GroupsLoad");
+
+	GroupStoreView view;
+	if (!view.Open(file))
+		return false;
+
+	m_Prefetch.Clear();
+	m_HoldersValid = false;
+
+	std::vector<HWND> wins;
+	m_Shell->EnumTopLevelWindows(wins);
+	std::unordered_set<HWND> alive(wins.begin(), wins.end());
+	std::unordered_set<HWND> bound;
+
+	// Members whose handle is gone, to be found again by identity. Their slot
+	// is held with a null so the group keeps its order.
+	std::vector<WindowIdentity> wanted;
+	std::vector<std::pair<size_t, size_t>> slots;
+	std::vector<std::pair<GroupId, std::vector<HWND>>> loaded;
+
+	// AddTop pushes down what is there, so bottom up keeps the order
+	for (size_t i = view.GroupCount(); i-- > 0;)
+	{
+		auto group = view.Group(i);
+		if (group.name.empty())
+			continue;
+
+		GroupId id = AddGroup(group.name);
+		if (id == NoGroup)
+			continue;
+
+		auto& members = loaded.emplace_back(id, std::vector<HWND>()).second;
+		members.reserve(group.members.size());
+		for (const auto& stored : group.members)
+		{
+			// still open since we saved, the usual case after we crashed
+			HWND hWin = (HWND)(std::uintptr_t)stored.hwnd;
+			if (alive.find(hWin) != alive.end() && (!stored.key || !key || key(hWin) == stored.key))
+			{
+				members.push_back(hWin);
+				bound.insert(hWin);
+				continue;
+			}
+
+			auto identity = view.Identity(stored);
+			if (identity == WindowIdentity())
+				continue;
+
+			wanted.push_back(std::move(identity));
+			slots.emplace_back(loaded.size() - 1, members.size());
+			members.push_back(nullptr);
+		}
+
+		m_Whole->AddTop(id);
+	}
+
+	if (!wanted.empty())
+	{
+		WindowIdentityIndex index;
+		for (auto hWin : wins)
+		{
+			WindowTraits traits;
+			if (bound.find(hWin) != bound.end() || hWin == m_hWnd || FAILED(m_Shell->GetWindowTraits(hWin, traits)))
+				continue;
+
+			auto identity = MakeWindowIdentity(traits);
+			m_Identities[hWin] = identity;
+			index.Add(hWin, std::move(identity));
+		}
+
+		std::vector<HWND> found;
+		index.Match(wanted, found);
+		for (size_t i = 0; i < found.size(); i++)
+			loaded[slots[i].first].second[slots[i].second] = found[i];
+	}
+
+	for (auto& [id, members] : loaded)
+	{
+		std::erase(members, nullptr);
+		Members(id).Assign(members, m_Index);
+		Touch(id);
+	}
+
+	return true;
+}
+
+void GroupsResync()
+{
+	m_Cache.Resync();
+	m_Views.Resync();
+
+	if (m_Shell && !m_InCommand && m_Opts.trackWindows)
+	{
+		TrackWindows();
+		m_WindowStats.pruned += SweepClosed();
+	}
+	CompactIndex();
+}
+
+size_t GroupsTrackWindows()
+{
+	if (m_InCommand)
+		return 0;
+	return TrackWindows();
+}
+
+const WindowTrackStats& GroupsWindowStats()
+{
+	return m_WindowStats;
+}
+
+void GroupsSetRules(std::span<const WindowRule> rules)
+{
+	TRACE_SCOPE("GroupsSetRules");
+	m_Rules.Compile(rules);
+	m_Fresh.clear();
+	m_FreshSet.clear();
+}
+
+const RuleStats& GroupsRuleStats()
+{
+	return m_RuleStats;
+}
+
+void GroupsPrefetch()
+{
+	TRACE_SCOPE("GroupsPrefetch");
+
+	m_Prefetch.Clear();
+	if (!m_Shell || !m_Whole || m_InCommand || !m_Opts.snapshot || !m_Cache.Active() || m_Opts.desktopPerGroup)
+		return;
+
+	std::vector<GroupId> order;
+	GetOrder(m_Whole, order);
+	if (order.empty())
+		return;
+
+	// windows keep coming and going between commands, a prefetch would only
+	// be thrown away again
+	if (m_StaleRun >= StalePrefetches && ++m_IdleChances % StalePrefetches != 0)
+	{
+		++m_PrefetchStats.skipped;
+		return;
+	}
+
+	// what opened or closed so far is in the count taken with the snapshot
+	TrackWindows();
+	if (m_EventsCookie)
+		m_Prefetch.turnover = WindowTurnover();
+	else
+	{
+		m_Shell->EnumTopLevelWindows(m_Prefetch.windows);
+		std::sort(m_Prefetch.windows.begin(), m_Prefetch.windows.end());
+	}
+
+	if (FAILED(m_Prefetch.snap.Capture(m_Shell, &m_Cache, &m_Views)))
+	{
+		m_Prefetch.Clear();
+		return;
+	}
+	m_Prefetch.changes = m_Cache.Changes();
+	m_Prefetch.top = order[0];
+
+	// MoveGroup captures the top first, so its diffs start from the screen.
+	// An empty group isn't switched to and a closed window isn't moved.
+	std::vector<HWND> current;
+	m_Prefetch.snap.Current(current);
+	WindowGroup screen;
+	screen.Assign(current, m_Index);
+
+	for (int i = 0; i < 2 && order.size() > 1; i++)
+	{
+		GroupId target = order[WrapIdx(0, order.size(), i == 0 ? 1 : -1)];
+		if (Members(target).windows.empty())
+			continue;
+
+		auto& plan = m_Prefetch.plans[i];
+		plan.target = target;
+		DiffGroups(screen, Members(target), m_Index, plan.diff);
+		std::erase_if(plan.diff.toShow, [](HWND hwnd) { return !m_Prefetch.snap.Find(hwnd); });
+	}
+
+	m_Prefetch.ready = true;
+	++m_PrefetchStats.taken;
+}
+
+const PrefetchStats& GroupsPrefetchStats()
+{
+	return m_PrefetchStats;
+}
+
+DesktopCache& GroupsDesktopCache()
+{
+	return m_Cache;
+}
+
+ViewCache& GroupsViewCache()
+{
+	return m_Views;
+}
+
+WindowFilter& GroupsWindowFilter()
+{
+	return m_Filter;
+}
+
+void MoveDesktop(int dir)
+{
+	CommandScope command(false);
+
+	auto desktops = Desktops();
+	if (!desktops || desktops->Current() == DesktopRegistry::None) return;
+
+	SwitchTo(*desktops, (int)WrapIdx(desktops->Current(), desktops->Count(), dir));
+}
+
+void NextDesktop()
+{
+	MoveDesktop(1);
+}
+
+void PrevDesktop()
+{
+	MoveDesktop(-1);
+}
+
+void ShowTopGroup(HMONITOR monitor)
+{
+	StackScope stack(monitor);
+	UndoScope undo;
+	CommandScope command;
+
+	GroupId id = NoGroup;
+	auto success = m_List->GetTop(id);
+	assert(success && m_Names.Contains(id));
+
+	if (OwnDesktops())
+	{
+		SwitchToGroupDesktop(id);
+		return;
+	}
+
+	std::vector<HWND> currentWin;
+
+	EnumCurrent(currentWin);
+
+	m_OnScreen.Assign(currentWin, m_Index);
+
+	GroupDiff diff;
+	DiffGroups(m_OnScreen, Members(id), m_Index, diff);
+
+	RunSwitch(diff);
+}
+
+void MoveGroup(int dir, HMONITOR monitor)
+{
+	StackScope stack(monitor);
+	UndoScope undo;
+	CommandScope command;
+
+	// all top level windows go into the current window
+	GroupId id = NoGroup;
+	if (!m_List->GetTop(id))
+	{
+		id = AddGroup(NextGroupName());
+		m_List->AddTop(id);
+		Touch(id);
+	}
+
+	Capture(id);
+
+	// the stack as it was, a switch that is rolled back leaves it like this
+	std::vector<GroupId> order;
+	GetOrder(m_List, order);
+
+	if (order.size() < 2) // nothing to rotate to
+		return;
+
+	// a full lap ends where it started, queued rotations can add up to several
+	dir %= (int)order.size();
+	StackRotated(monitor) += dir;
+
+	for (;dir > 0; --dir)
+		if (!m_List->RotateUp())
+		{
+			++m_StackEdits;
+			Report(TEXT("Failed to rotate Lists"));
+			return;
+		}
+
+	for (;dir < 0; ++dir)
+		if (!m_List->RotateDown())
+		{
+			++m_StackEdits;
+			Report(TEXT("Failed to rotate Lists"));
+			return;
+		}
+
+	GroupId top = NoGroup;
+	if (!m_List->GetTop(top))
+	{
+		Report(TEXT("Failed to get top after rotate Lists"));
+		return;
+	}
+
+	if (!m_Names.Contains(top))
+	{
+		Report(TEXT("Groups out of sync"));
+		return;
+	}
+
+	if (OwnDesktops())
+	{
+		// an empty group gets an empty desktop
+		if (!SwitchToGroupDesktop(top))
+			SetOrder(m_List, order);
+		return;
+	}
+
+	auto& target = Members(top);
+	if (!target.windows.empty())
+	{
+		GroupDiff diff;
+		if (!TakePlan(id, top, diff))
+			DiffGroups(Members(id), target, m_Index, diff);
+
+		if (!RunSwitch(diff))
+			SetOrder(m_List, order);
+	}
+
+	// in the case of the target group being empty we'll keep the same windows
+}
+
+void NextGroup()
+{
+	MoveGroup(1);
+}
+
+void PrevGroup()
+{
+	MoveGroup(-1);
+}
+
+void DeleteGroup(HMONITOR monitor)
+{
+	StackScope stack(monitor);
+	UndoScope undo;
+	CommandScope command;
+
+	GroupId id = NoGroup;
+
+	if (!m_List->DelTop(id))
+	{
+		Report(TEXT("No group to delete"));
+		return;
+	}
+	++m_StackEdits;
+
+	assert(m_Names.Contains(id));
+	Members(id).Clear();
+	m_Names.Remove(id);
+	Touch(id);
+
+	GroupId top = NoGroup;
+	if (m_List->GetTop(top))
+		ShowTopGroup(monitor);
+}
+
+void NewGroup(HMONITOR monitor)
+{
+	StackScope stack(monitor);
+	UndoScope undo;
+	CommandScope command;
+
+	// Capture current
+	GroupId top = NoGroup;
+	bool first = !m_List->GetTop(top);
+	if (!first)
+		Capture(top);
+
+	// Make new
+	GroupId id = AddGroup(NextGroupName());
+	if (!m_List->AddTop(id))
+	{
+		m_Names.Remove(id);
+		Report(TEXT("Failed to allocate new group"));
+		return;
+	}
+
+	Members(id).Clear();
+	Touch(id);
+
+	// with a desktop per group the first one takes what is on screen, the
+	// ones after it start out on an empty desktop
+	if (OwnDesktops())
+	{
+		if (first)
+			Capture(id);
+		else
+			SwitchToGroupDesktop(id);
+	}
+}
+
+GroupId CombineGroups(SetOp op, GroupId a, GroupId b, HMONITOR monitor)
+{
+	StackScope stack(monitor);
+	UndoScope undo;
+	CommandScope command;
+
+	if (!m_Names.Contains(a) || !m_Names.Contains(b))
+	{
+		Report(TEXT("No such group to combine"));
+		return NoGroup;
+	}
+
+	// the top group is what is on screen, not what it was when last left
+	GroupId top = NoGroup;
+	if (m_List->GetTop(top))
+		Capture(top);
+
+	WindowGroup combined;
+	CombineWindowGroups(op, Members(a), Members(b), combined);
+
+	const wchar_t* sign = op == SetOp::Union ? TEXT("+") : op == SetOp::Intersect ? TEXT("&") : TEXT("-");
+	GroupId id = AddGroup(UniqueGroupName(m_Names.Name(a) + sign + m_Names.Name(b)));
+	if (!m_List->AddTop(id))
+	{
+		m_Names.Remove(id);
+		Report(TEXT("Failed to allocate new group"));
+		return NoGroup;
+	}
+
+	Members(id) = std::move(combined);
+	Touch(id);
+
+	ShowTopGroup(monitor);
+	return id;
+}
+
+void CombineTopGroups(SetOp op, HMONITOR monitor)
+{
+	auto list = MonitorList(monitor, true);
+
+	GroupId a = NoGroup;
+	GroupId b = NoGroup;
+	if (!list->GetAt(0, a) || !list->GetAt(1, b))
+	{
+		Report(TEXT("Combining needs two groups"));
+		return;
+	}
+
+	CombineGroups(op, a, b, monitor);
+}
+
+void SwitchReport::Clear()
+{
+	committed = true;
+	retried = 0;
+	outcomes.clear();
+	rollback.clear();
+}
+
+const SwitchReport& GroupsLastSwitch()
+{
+	return m_LastSwitch;
+}
+
+HRESULT MoveWindowsToDesktop(std::span<const HWND> wins, const GUID& target, std::vector<MoveOutcome>& results)
+{
+	TRACE_SCOPE("MoveWindowsToDesktop");
+
+	// inside a command the snapshot is shared, outside one it is only taken
+	// for windows the caches don't know
+	CommandScope command(!m_InCommand && !ViewsHeld(wins));
+
+	auto desktops = Desktops();
+	if (!desktops) return E_FAIL;
+
+	int idx = desktops->IndexOf(target);
+	if (idx == DesktopRegistry::None) return E_INVALIDARG;
+
+	IVirtualDesktop* pTarget = desktops->At(idx);
+
+	results.reserve(results.size() + wins.size());
+
+	// settle what needs no call first, the rest is moved below
+	std::vector<size_t> toMove;
+	std::vector<GUID> from; // by toMove, only kept while recording for undo
+	if (m_MoveLog)
+		from.reserve(wins.size());
+	for (const auto& hwnd : wins)
+	{
+		MoveOutcome out{ hwnd, MoveResult::Moved, S_OK };
+
+		GUID at{};
+		if (hwnd == m_hWnd)
+			out.result = MoveResult::Skipped;
+		else if (KnownDesktop(hwnd, &at) && (at == target || at == GUID{}))
+			out.result = MoveResult::AlreadyThere;
+		else
+		{
+			toMove.push_back(results.size());
+			if (m_MoveLog)
+				from.push_back(at == GUID{} ? DesktopBefore(hwnd) : at);
+		}
+
+		results.push_back(out);
+	}
+
+	if (m_Pool && toMove.size() > 1)
+	{
+		// the views we hold go along, the pool only looks up the rest and
+		// hands those back for the cache
+		std::vector<HWND> batch;
+		std::vector<SharedView> views(toMove.size(), nullptr);
+		batch.reserve(toMove.size());
+		for (size_t k = 0; k < toMove.size(); k++)
+		{
+			HWND hwnd = results[toMove[k]].hwnd;
+			batch.push_back(hwnd);
+
+			com_ptr<IApplicationView> app;
+			if (HeldView(hwnd, app) && FAILED(m_Shell->ShareView(app.Get(), &views[k])))
+				views[k] = nullptr;
+		}
+
+		std::vector<MoveOutcome> moved(toMove.size());
+		m_Pool->Move(batch, views, target, moved, m_Progress);
+
+		for (size_t k = 0; k < toMove.size(); k++)
+		{
+			results[toMove[k]] = moved[k];
+			if (moved[k].result == MoveResult::Moved)
+				MovedTo(moved[k].hwnd, m_MoveLog ? from[k] : GUID{}, target);
+			else
+				m_Views.Forget(moved[k].hwnd);
+
+			com_ptr<IApplicationView> app;
+			if (views[k] && SUCCEEDED(m_Shell->TakeView(views[k], app.Put())))
+				m_Views.Add(moved[k].hwnd, app.Get());
+		}
+
+		return S_OK;
+	}
+
+	for (size_t k = 0; k < toMove.size(); k++)
+	{
+		auto& out = results[toMove[k]];
+
+		com_ptr<IApplicationView> app;
+		if (FAILED(out.hr = ViewForHwnd(out.hwnd, app)))
+			out.result = MoveResult::NoView;
+		else if (FAILED(out.hr = MoveView(out.hwnd, app.Get(), pTarget)))
+			out.result = MoveResult::Failed;
+		else
+			MovedTo(out.hwnd, m_MoveLog ? from[k] : GUID{}, target);
+
+		if (m_Progress)
+			m_Progress(k + 1, toMove.size());
+	}
+
+	return S_OK;
+}
+
+void RestoreScratched()
+{
+	UndoScope undo;
+	CommandScope command;
+
+	std::vector<HWND> list;
+
+	EnumNotCurrent(list);
+
+	ShowAll(list);
+}
+
+void MoveToCurrent(HWND hWin)
+{
+	if (hWin == m_hWnd) return;
+
+	BOOL onDesk = FALSE;
+	if (!SUCCEEDED(IsOnCurrent(hWin, &onDesk))) return;
+	if (onDesk) return;
+
+	auto desktops = Desktops();
+	if (!desktops || desktops->Current() == DesktopRegistry::None) return;
+
+	GUID from = DesktopBefore(hWin);
+
+	com_ptr<IApplicationView> app;
+	if (!SUCCEEDED(ViewForHwnd(hWin, app))) return;
+	if (!SUCCEEDED(MoveView(hWin, app.Get(), desktops->At(desktops->Current())))) return;
+
+	MovedTo(hWin, from, desktops->IdAt(desktops->Current()));
+}
+
+void MoveBackFromOther()
+{
+	UndoScope undo;
+
+	if (m_Moved.empty())
+		return;
+	MoveToCurrent(m_Moved.back());
+	m_Moved.pop_back();
+}
+
+void MoveAllToOther()
+{
+	UndoScope undo;
+	CommandScope command;
+
+	std::vector<HWND> list;
+	EnumCurrent(list);
+	HideAll(list);
+}
+
+void MoveToScratch(HWND hWin, BOOL track)
+{
+	if (hWin == m_hWnd) return; // ignore ourself
+
+	// only the hotkey is a command of its own, batch callers record themselves
+	UndoScope undo(track != FALSE);
+
+	auto desktops = Desktops();
+	if (!desktops) return;
+
+	int target = desktops->Scratch();
+	if (target == DesktopRegistry::None) return;
+
+	GUID from = DesktopBefore(hWin);
+
+	com_ptr<IApplicationView> app;
+	if (!SUCCEEDED(ViewForHwnd(hWin, app))) return;
+	if (!SUCCEEDED(MoveView(hWin, app.Get(), desktops->At(target)))) return;
+
+	MovedTo(hWin, from, desktops->IdAt(target));
+
+	if (track)
+	{
+		while (m_Moved.size() > MaxMoveHistory)
+			m_Moved.pop_front();
+
+		m_Moved.push_back(hWin);
+	}
+}
+
+void MoveSwap()
+{
+	UndoScope undo;
+	CommandScope command;
+
+	std::vector<HWND> current;
+	EnumCurrent(current);
+
+	std::vector<HWND> notcurrent;
+	EnumNotCurrent(notcurrent);
+
+	HideAll(current);
+	ShowAll(notcurrent);
+}
+
+void SwitchToAnchorDesktop()
+{
+	// every group has a desktop, there is no group desktop to go back to
+	if (m_Opts.desktopPerGroup)
+		return;
+
+	CommandScope command(false);
+
+	auto desktops = Desktops();
+	if (!desktops) return;
+
+	int anchor = desktops->Anchor();
+	if (anchor == DesktopRegistry::None || anchor == desktops->Current())
+		return;
+
+	SwitchTo(*desktops, anchor);
+}
+
+BOOL RenameGroup(GroupId id, const std::wstring& name)
+{
+	UndoScope undo;
+
+	if (!m_Names.Rename(id, name))
+		return FALSE;
+
+	++m_StackEdits;
+	Touch(id);
+	return TRUE;
+}
+
+BOOL UndoCommand()
+{
+	CommandScope command;
+
+	auto entry = m_History.Undo();
+	if (!entry)
+		return FALSE;
+
+	Restore(entry->before);
+	Replay(entry->moves, true);
+	SwitchToTopDesktop();
+	return TRUE;
+}
+
+BOOL RedoCommand()
+{
+	CommandScope command;
+
+	auto entry = m_History.Redo();
+	if (!entry)
+		return FALSE;
+
+	Restore(entry->after);
+	Replay(entry->moves, false);
+	SwitchToTopDesktop();
+	return TRUE;
+}
+
+size_t UndoDepth()
+{
+	return m_History.UndoCount();
+}
+
+size_t RedoDepth()
+{
+	return m_History.RedoCount();
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "groupnames.h"
+#include "groupset.h"
+#include "groupstore.h"
+#include "shellbackend.h"
+#include "windowfilter.h"
+#include "windowrules.h"
+
+#include <string>
+#include <vector>
+#include <span>
+#include <functional>
+
+// Ordered stack of groups, the top entry is the active group. VectorGroupList
+// is the one the commands run against, the list view shows a copy of it.
+struct IGroupList
+{
+	virtual ~IGroupList() = default;
+
+	virtual BOOL GetTop(GroupId& id) = 0;
+	virtual BOOL GetAt(size_t pos, GroupId& id) = 0;  // 0 is the top
+	virtual BOOL AddTop(GroupId id) = 0;
+	virtual BOOL DelTop(GroupId& deleted) = 0;
+	virtual BOOL RotateUp() = 0;
+	virtual BOOL RotateDown() = 0;
+};
+
+class VectorGroupList : public IGroupList
+{
+public:
+	BOOL GetTop(GroupId& id) override;
+	BOOL GetAt(size_t pos, GroupId& id) override;
+	BOOL AddTop(GroupId id) override;
+	BOOL DelTop(GroupId& deleted) override;
+	BOOL RotateUp() override;
+	BOOL RotateDown() override;
+
+	std::vector<GroupId> mItems;
+};
+
+class DesktopCache;
+class ViewCache;
+class MovePool;
+
+using FnReport = std::function<void(const wchar_t* msg)>;
+using FnProgress = std::function<void(size_t done, size_t total)>;
+
+// Switches for the cheaper paths, so they can be measured against the old ones
+struct GroupsOptions
+{
+	bool desktopCache = true;  // notification fed HWND -> desktop cache
+	bool snapshot = true;      // one GetViewsByZOrder per command
+	bool desktopRegistry = true; // desktop list held between lookups
+	bool viewCache = true;     // HWND -> view held until the window is destroyed
+	bool trackWindows = true;  // closed windows leave their groups as they close
+	bool filterWindows = true; // EnumWindows narrowed down in process before explorer is asked
+	WindowFilterOptions windowFilter;
+
+	// Every group of the whole stack on a virtual desktop of its own, made the
+	// first time the group is shown, instead of parking the groups not on
+	// screen on the scratch desktop. A switch is then one SwitchDesktop, plus
+	// a move for each window the group shares with another. The monitors'
+	// stacks keep parking.
+	bool desktopPerGroup = false;
+};
+
+// list is the stack whose groups span every monitor. Each monitor can have a
+// stack of its own besides: the commands that work on a stack take the
+// monitor whose stack it is, null for list, and a monitor's stack is made the
+// first time one asks for it. Its groups only take in, show and hide the
+// windows MonitorFromWindow puts on that monitor, so a switch there leaves
+// the other screens alone.
+//
+// hSelf is our own window, it is never moved and anchors the group desktop
+void GroupsInit(IShellBackend* shell, IGroupList* list, HWND hSelf, FnReport&& report, const GroupsOptions& opts = GroupsOptions());
+void GroupsShutdown();
+
+// Called after each window of a batch move, on the thread running the command
+// or on a move pool thread
+void GroupsSetProgress(FnProgress&& progress);
+
+// Batch moves go out across the pool's threads when there is one, null puts
+// them back on the command thread
+void GroupsSetMovePool(MovePool* pool);
+
+const std::vector<HWND>* GroupMembers(GroupId id);
+size_t GroupCount();
+
+// empty for an unknown id
+const std::wstring& GroupName(GroupId id);
+GroupId FindGroup(std::wstring_view name);
+
+// A monitor's stack, top first, null for the one given to GroupsInit.
+// Nothing for a monitor that has none yet.
+void GetGroupStack(HMONITOR monitor, std::vector<GroupId>& order);
+
+// For keeping a copy of a stack without copying it after every command.
+// edits moves with any change to any stack other than a rotation, and with
+// every change to a group name; rotated counts the RotateUp steps the
+// monitor's stack took, RotateDown ones negative. While edits stays where it
+// was, the copy only needs rotating by how far rotated moved.
+struct GroupStackMarks
+{
+	std::uint64_t edits = 0;
+	std::int64_t rotated = 0;
+};
+GroupStackMarks GroupsStackMarks(HMONITOR monitor);
+
+// Writes every group in order (the list, top first) with its members to file.
+// key is stored with each member so a reused handle isn't taken for it later,
+// and so is its WindowIdentity, looked up the first time the window is saved.
+bool GroupsSave(const char* file, const std::vector<GroupId>& order, const FnWindowKey& key = nullptr);
+
+// Brings back the groups of a GroupsSave file onto the list. Members still
+// open with the same key keep their window; the rest are matched by identity
+// against the windows left over, which are only asked for their traits when
+// there is something to match. Members nothing matches are dropped and
+// nothing is moved.
+bool GroupsLoad(const char* file, const FnWindowKey& key = nullptr);
+
+// Periodic consistency check of the notification fed window cache, and of
+// the groups: whatever EnumWindows no longer lists leaves them, in case
+// window events were missed
+void GroupsResync();
+
+// Takes in the window events queued since the last call. A closed window
+// leaves every group holding it, found through a window -> groups index
+// rather than by looking at every group; hidden ones stay. Every command
+// does this first. Returns how many memberships were dropped.
+size_t GroupsTrackWindows();
+
+struct WindowTrackStats
+{
+	size_t events = 0;
+	size_t batches = 0;
+	size_t pruned = 0;    // memberships of closed windows dropped
+	size_t lost = 0;      // batches that came with events missing
+	size_t sweeps = 0;    // passes over every group against EnumWindows
+	size_t turnover = 0;  // windows created or destroyed, ours or not
+};
+
+const WindowTrackStats& GroupsWindowStats();
+
+// Rules for the windows shown for the first time, compiled once here and
+// kept until GroupsShutdown, none to stop. Each new window is classified with
+// the window events it came with: ruled out by the window filter, or asked for
+// its traits and put in the group of the first rule matching them. A rule
+// naming no group there is does nothing. The window of a group not on screen
+// is parked with that group's, so capturing the top group doesn't take it in
+// as well. Needs trackWindows. Not part of any command's undo: undoing a
+// command from before a window was sorted in leaves it in its group, until
+// it closes.
+void GroupsSetRules(std::span<const WindowRule> rules);
+
+struct RuleStats
+{
+	size_t classified = 0;  // new windows asked for their traits
+	size_t matched = 0;
+	size_t assigned = 0;
+	size_t missing = 0;     // matched a rule whose group doesn't exist
+	size_t parked = 0;      // moved off screen to their group
+};
+
+const RuleStats& GroupsRuleStats();
+
+// For when the command thread has nothing else to do: takes the window
+// snapshot the next command would, with every view resolved and closed
+// windows left out, and works out the moves of rotating the whole stack
+// either way. The next command starts from that instead of asking explorer,
+// so a group switch goes straight to moving. Dropped, and the command takes
+// its own snapshot, when the desktop cache saw a change since or windows were
+// opened or closed. While they keep being dropped most calls ready nothing,
+// until one is used again. Needs the desktop cache; nothing is readied with a
+// desktop per group, those switches don't move the group's windows.
+void GroupsPrefetch();
+
+struct PrefetchStats
+{
+	size_t taken = 0;    // prefetches made
+	size_t used = 0;     // commands that started from one
+	size_t stale = 0;    // dropped for a change
+	size_t plans = 0;    // switches that moved by a prefetched plan
+	size_t skipped = 0;  // idle chances let go while prefetches keep going stale
+};
+
+const PrefetchStats& GroupsPrefetchStats();
+
+DesktopCache& GroupsDesktopCache();
+ViewCache& GroupsViewCache();
+WindowFilter& GroupsWindowFilter();
+
+enum class MoveResult
+{
+	Moved,
+	AlreadyThere,  // on the target, or on every desktop
+	Skipped,       // our own window
+	NoView,        // explorer doesn't manage it, or it is gone
+	Failed,        // MoveViewToDesktop failed, see hr
+};
+
+struct MoveOutcome
+{
+	HWND hwnd;
+	MoveResult result;
+	HRESULT hr;
+};
+
+// Moves a batch of windows to one desktop. The target and the views are
+// resolved once for the batch and windows already in place are dropped before
+// any call is made. Outside a command the windows are only snapshotted when
+// the caches are missing one's view. With a move pool the rest are moved in
+// parallel. Appends one outcome per window, in order; fails only when the
+// target desktop can't be found.
+HRESULT MoveWindowsToDesktop(std::span<const HWND> wins, const GUID& target, std::vector<MoveOutcome>& results);
+
+// What the last group switch did. A switch shows the new group's windows,
+// hides the old one's, then tries the moves that failed once more. When some
+// still fail every window it did move is moved back and a rotation of the
+// stack is undone, so the screen and the stack agree again. With a desktop
+// per group only the group's windows that were elsewhere are moved, and it
+// is the SwitchDesktop failing that undoes the rotation.
+struct SwitchReport
+{
+	bool committed = true;
+	size_t retried = 0;                // moves tried again
+	std::vector<MoveOutcome> outcomes; // one per window of the plan, as the last try left it
+	std::vector<MoveOutcome> rollback; // the moves putting windows back
+
+	void Clear();
+};
+
+const SwitchReport& GroupsLastSwitch();
+
+void MoveToScratch(HWND hWin, BOOL track = FALSE);
+void MoveToCurrent(HWND hWin);
+void MoveBackFromOther();
+void MoveAllToOther();
+// These two take no monitor and span every screen: the windows they move are
+// all the ones off the current desktop, whichever monitor they were left on
+void MoveSwap();
+void RestoreScratched();
+
+void MoveDesktop(int dir);
+void NextDesktop();
+void PrevDesktop();
+void SwitchToAnchorDesktop();
+
+// The group commands work on the stack of monitor, see GroupsInit
+void ShowTopGroup(HMONITOR monitor = nullptr);
+void MoveGroup(int dir, HMONITOR monitor = nullptr);
+void NextGroup();
+void PrevGroup();
+void NewGroup(HMONITOR monitor = nullptr);
+void DeleteGroup(HMONITOR monitor = nullptr);
+
+// A new group on top of monitor's stack made from two others, named after
+// them ("Build+Debug", "Build&Debug", "Build-Debug") and shown. The top group
+// is captured first, like NewGroup does. Membership is worked out on the
+// groups' bitsets.
+GroupId CombineGroups(SetOp op, GroupId a, GroupId b, HMONITOR monitor = nullptr);
+
+// CombineGroups on the top group of monitor's stack and the one under it
+void CombineTopGroups(SetOp op, HMONITOR monitor = nullptr);
+
+// FALSE when another group has the name
+BOOL RenameGroup(GroupId id, const std::wstring& name);
+
+// Takes back the last command that changed the groups or moved windows: the
+// stack, names and members are put back as they were and only the windows
+// that command moved are moved back. Desktop switches aren't recorded.
+// FALSE when there is nothing to undo.
+BOOL UndoCommand();
+
+// Does the last undone command again, the same way. A new command drops
+// whatever could still be redone.
+BOOL RedoCommand();
+
+size_t UndoDepth();
+size_t RedoDepth();
@@ -0,0 +1,181 @@
+#include "groupset.h"
+
+#include <algorithm>
+#include <bit>
+
+std::uint32_t WindowIndex::Add(HWND hWin)
+{
+	auto [it, added] = m_Slots.try_emplace(hWin, (std::uint32_t)m_Windows.size());
+	if (added)
+		m_Windows.push_back(hWin);
+	return (*it).second;
+}
+
+std::uint32_t WindowIndex::Find(HWND hWin) const
+{
+	auto it = m_Slots.find(hWin);
+	return it == m_Slots.end() ? None : (*it).second;
+}
+
+void WindowIndex::Clear()
+{
+	m_Windows.clear();
+	m_Slots.clear();
+}
+
+void GroupSet::Set(std::uint32_t slot)
+{
+	size_t word = slot / 64;
+	if (word >= m_Words.size())
+		m_Words.resize(word + 1, 0);
+	m_Words[word] |= std::uint64_t(1) << (slot % 64);
+}
+
+void GroupSet::Reset(std::uint32_t slot)
+{
+	size_t word = slot / 64;
+	if (word < m_Words.size())
+		m_Words[word] &= ~(std::uint64_t(1) << (slot % 64));
+}
+
+bool GroupSet::Empty() const
+{
+	return std::all_of(m_Words.begin(), m_Words.end(), [](std::uint64_t w) { return w == 0; });
+}
+
+size_t GroupSet::Count() const
+{
+	size_t count = 0;
+	for (auto w : m_Words)
+		count += std::popcount(w);
+	return count;
+}
+
+GroupSet& GroupSet::operator|=(const GroupSet& other)
+{
+	if (m_Words.size() < other.m_Words.size())
+		m_Words.resize(other.m_Words.size(), 0);
+	for (size_t i = 0; i < other.m_Words.size(); i++)
+		m_Words[i] |= other.m_Words[i];
+	return *this;
+}
+
+GroupSet& GroupSet::operator&=(const GroupSet& other)
+{
+	if (m_Words.size() > other.m_Words.size())
+		m_Words.resize(other.m_Words.size());
+	for (size_t i = 0; i < m_Words.size(); i++)
+		m_Words[i] &= other.m_Words[i];
+	return *this;
+}
+
+GroupSet& GroupSet::operator-=(const GroupSet& other)
+{
+	size_t n = std::min(m_Words.size(), other.m_Words.size());
+	for (size_t i = 0; i < n; i++)
+		m_Words[i] &= ~other.m_Words[i];
+	return *this;
+}
+
+bool GroupSet::operator==(const GroupSet& other) const
+{
+	// trailing zero words don't count
+	size_t n = std::max(m_Words.size(), other.m_Words.size());
+	for (size_t i = 0; i < n; i++)
+	{
+		auto a = i < m_Words.size() ? m_Words[i] : 0;
+		auto b = i < other.m_Words.size() ? other.m_Words[i] : 0;
+		if (a != b)
+			return false;
+	}
+	return true;
+}
+
+void WindowGroup::Clear()
+{
+	windows.clear();
+	slots.clear();
+	set.Clear();
+	positions.clear();
+}
+
+void WindowGroup::Assign(std::span<const HWND> wins, WindowIndex& index)
+{
+	Clear();
+	windows.reserve(wins.size());
+	slots.reserve(wins.size());
+	for (auto hWin : wins)
+		Add(hWin, index.Add(hWin));
+}
+
+void WindowGroup::Add(HWND hWin, std::uint32_t slot)
+{
+	windows.push_back(hWin);
+	slots.push_back(slot);
+	set.Set(slot);
+
+	if (positions.empty())
+		return;
+	if (slot >= positions.size())
+		positions.resize(slot + 1, WindowIndex::None);
+	positions[slot] = (std::uint32_t)(slots.size() - 1);
+}
+
+bool WindowGroup::Remove(std::uint32_t slot)
+{
+	if (!set.Test(slot))
+		return false;
+
+	if (positions.empty())
+	{
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			if (slots[i] >= positions.size())
+				positions.resize(slots[i] + 1, WindowIndex::None);
+			positions[slots[i]] = (std::uint32_t)i;
+		}
+	}
+
+	std::uint32_t pos = positions[slot];
+	windows[pos] = windows.back();
+	slots[pos] = slots.back();
+	positions[slots[pos]] = pos;
+	positions[slot] = WindowIndex::None;
+	windows.pop_back();
+	slots.pop_back();
+	set.Reset(slot);
+	return true;
+}
+
+void CombineWindowGroups(SetOp op, const WindowGroup& a, const WindowGroup& b, WindowGroup& out)
+{
+	out.Clear();
+
+	out.set = a.set;
+	switch (op)
+	{
+	case SetOp::Union: out.set |= b.set; break;
+	case SetOp::Intersect: out.set &= b.set; break;
+	case SetOp::Difference: out.set -= b.set; break;
+	}
+
+	// the order comes from walking the groups, membership from the set
+	for (size_t i = 0; i < a.windows.size(); i++)
+	{
+		if (!out.set.Test(a.slots[i]))
+			continue;
+		out.windows.push_back(a.windows[i]);
+		out.slots.push_back(a.slots[i]);
+	}
+
+	if (op == SetOp::Union)
+	{
+		for (size_t i = 0; i < b.windows.size(); i++)
+		{
+			if (a.set.Test(b.slots[i]))
+				continue;
+			out.windows.push_back(b.windows[i]);
+			out.slots.push_back(b.slots[i]);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "platform.h"
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Every window any group has held gets a small dense slot, so a group's
+// membership can be a bitset and combining or comparing groups works a 64
+// windows per word.
+class WindowIndex
+{
+public:
+	static constexpr std::uint32_t None = ~0u;
+
+	// The window's slot, a new one the first time it is seen
+	std::uint32_t Add(HWND hWin);
+	std::uint32_t Find(HWND hWin) const;
+	HWND At(std::uint32_t slot) const { return m_Windows[slot]; }
+
+	size_t Size() const { return m_Windows.size(); }
+	void Clear();
+
+private:
+	std::vector<HWND> m_Windows;
+	std::unordered_map<HWND, std::uint32_t> m_Slots;
+};
+
+class GroupSet
+{
+public:
+	void Set(std::uint32_t slot);
+	void Reset(std::uint32_t slot);
+	bool Test(std::uint32_t slot) const
+	{
+		size_t word = slot / 64;
+		return word < m_Words.size() && (m_Words[word] >> (slot % 64)) & 1;
+	}
+
+	bool Empty() const;
+	size_t Count() const;
+	void Clear() { m_Words.clear(); }
+
+	// a = a | b, a & b and a & ~b, a word at a time
+	GroupSet& operator|=(const GroupSet& other);
+	GroupSet& operator&=(const GroupSet& other);
+	GroupSet& operator-=(const GroupSet& other);
+
+	bool operator==(const GroupSet& other) const;
+
+	// Bit i of word i / 64 is slot i, the last words may be missing when zero
+	std::span<const std::uint64_t> Words() const { return m_Words; }
+
+private:
+	std::vector<std::uint64_t> m_Words;
+};
+
+// A group's windows in their order, each with its slot, and the same windows
+// as a set
+struct WindowGroup
+{
+	std::vector<HWND> windows;
+	std::vector<std::uint32_t> slots;
+	GroupSet set;
+
+	// Where each slot is in windows, by slot, None for the ones not in the
+	// group. Built by the first Remove since the last Assign, kept by Add.
+	std::vector<std::uint32_t> positions;
+
+	void Clear();
+	void Assign(std::span<const HWND> wins, WindowIndex& index);
+	void Add(HWND hWin, std::uint32_t slot);
+
+	// The last window takes the removed one's place, so the order is only
+	// the one given to Assign and Add until the first removal
+	bool Remove(std::uint32_t slot);
+};
+
+enum class SetOp
+{
+	Union,      // a | b, a's windows first
+	Intersect,  // a & b, in a's order
+	Difference, // a & ~b, in a's order
+};
+
+void CombineWindowGroups(SetOp op, const WindowGroup& a, const WindowGroup& b, WindowGroup& out);
@@ -0,0 +1,372 @@
+#include "groupstore.h"
+#include "trace.h"
+
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	constexpr std::uint32_t StoreMagic = 0x53534757; // "WGSS"
+	constexpr std::uint16_t StoreVersion = 2;
+
+	// Everything is 8 byte aligned so the mapping can be read in place
+	struct StoreHeader
+	{
+		std::uint32_t magic;
+		std::uint16_t version;
+		std::uint16_t charSize;     // wchar_t differs between platforms
+		std::uint32_t groupCount;
+		std::uint32_t memberCount;
+		std::uint64_t textChars;
+		std::uint64_t checksum;     // of everything after the header
+	};
+
+	struct StoreGroup
+	{
+		StoredText name;
+		std::uint32_t firstMember;
+		std::uint32_t memberCount;
+	};
+
+	static_assert(sizeof(StoreHeader) == 32);
+	static_assert(sizeof(StoreGroup) == 16);
+	static_assert(sizeof(StoredWindow) == 48);
+
+	size_t GroupsOffset()
+	{
+		return sizeof(StoreHeader);
+	}
+
+	size_t MembersOffset(const StoreHeader& header)
+	{
+		return GroupsOffset() + header.groupCount * sizeof(StoreGroup);
+	}
+
+	size_t TextOffset(const StoreHeader& header)
+	{
+		return MembersOffset(header) + header.memberCount * sizeof(StoredWindow);
+	}
+
+	// FNV-1a over 8 byte words, the tail a byte at a time
+	std::uint64_t Checksum(const std::byte* data, size_t size)
+	{
+		constexpr std::uint64_t Prime = 0x100000001b3ull;
+		std::uint64_t hash = 0xcbf29ce484222325ull;
+
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * Prime;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ (std::uint64_t)data[i]) * Prime;
+
+		return hash;
+	}
+
+	template<typename T>
+	void Append(std::vector<std::byte>& out, const T* items, size_t count)
+	{
+		auto bytes = reinterpret_cast<const std::byte*>(items);
+		out.insert(out.end(), bytes, bytes + count * sizeof(T));
+	}
+
+	// Writes the file and waits until it is on disk, so renaming it over the
+	// old one can't leave a truncated file after a crash
+	bool WriteDurably(const std::filesystem::path& file, std::span<const std::byte> head, std::span<const std::byte> body)
+	{
+#ifdef _WIN32
+		HANDLE out = CreateFileW(file.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (out == INVALID_HANDLE_VALUE)
+			return false;
+
+		bool ok = true;
+		for (auto part : { head, body })
+		{
+			DWORD written = 0;
+			ok = ok && WriteFile(out, part.data(), (DWORD)part.size(), &written, NULL) && written == part.size();
+		}
+		ok = ok && FlushFileBuffers(out);
+		CloseHandle(out);
+		return ok;
+#else
+		int out = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (out < 0)
+			return false;
+
+		bool ok = true;
+		for (auto part : { head, body })
+		{
+			for (size_t done = 0; ok && done < part.size();)
+			{
+				ssize_t written = write(out, part.data() + done, part.size() - done);
+				ok = written > 0;
+				done += ok ? (size_t)written : 0;
+			}
+		}
+		ok = ok && fsync(out) == 0;
+		close(out);
+		return ok;
+#endif
+	}
+
+	// Windows of the same app share their app strings, titles are mostly
+	// unique and just appended
+	struct TextPool
+	{
+		std::wstring text;
+		std::unordered_map<std::wstring, StoredText> added;
+
+		StoredText Append(std::wstring_view add)
+		{
+			StoredText stored{ (std::uint32_t)text.size(), (std::uint32_t)add.size() };
+			text += add;
+			return stored;
+		}
+
+		StoredText Add(const std::wstring& add)
+		{
+			auto [it, inserted] = added.try_emplace(add, StoredText{ (std::uint32_t)text.size(), (std::uint32_t)add.size() });
+			if (inserted)
+				text += add;
+			return (*it).second;
+		}
+	};
+
+	bool InBounds(const StoredText& text, std::uint64_t chars)
+	{
+		return (std::uint64_t)text.offset + text.length <= chars;
+	}
+}
+
+bool GroupStoreWrite(const char* file, std::span<const GroupStoreEntry> entries,
+	const FnWindowKey& key, const FnWindowIdentity& identity)
+{
+	TRACE_SCOPE("GroupStoreWrite");
+
+	StoreHeader header{};
+	header.magic = StoreMagic;
+	header.version = StoreVersion;
+	header.charSize = sizeof(wchar_t);
+	header.groupCount = (std::uint32_t)entries.size();
+
+	std::vector<StoreGroup> groups;
+	std::vector<StoredWindow> windows;
+	TextPool text;
+	groups.reserve(entries.size());
+
+	for (const auto& entry : entries)
+	{
+		StoreGroup group{};
+		group.name = text.Append(entry.name);
+		group.firstMember = (std::uint32_t)windows.size();
+
+		if (auto wins = entry.members)
+		{
+			for (auto hWin : *wins)
+			{
+				StoredWindow win{};
+				win.hwnd = (std::uint64_t)(std::uintptr_t)hWin;
+				win.key = key ? key(hWin) : 0;
+				if (auto id = identity ? identity(hWin) : nullptr)
+				{
+					win.appId = text.Add(id->appId);
+					win.image = text.Add(id->image);
+					win.className = text.Add(id->className);
+					win.title = text.Append(id->title);
+				}
+				windows.push_back(win);
+			}
+		}
+
+		group.memberCount = (std::uint32_t)(windows.size() - group.firstMember);
+		groups.push_back(group);
+	}
+
+	header.memberCount = (std::uint32_t)windows.size();
+	header.textChars = text.text.size();
+
+	std::vector<std::byte> body;
+	Append(body, groups.data(), groups.size());
+	Append(body, windows.data(), windows.size());
+	Append(body, text.text.data(), text.text.size());
+	header.checksum = Checksum(body.data(), body.size());
+
+	std::filesystem::path path(file);
+	std::filesystem::path temp(path);
+	temp += ".tmp";
+
+	std::error_code ec;
+	if (!WriteDurably(temp, std::as_bytes(std::span(&header, 1)), body))
+	{
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+	std::filesystem::rename(temp, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+	return true;
+}
+
+GroupStoreView::~GroupStoreView()
+{
+	Close();
+}
+
+bool GroupStoreView::Open(const char* file)
+{
+	TRACE_SCOPE("GroupStoreView::Open");
+
+	Close();
+
+#ifdef _WIN32
+	m_File = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_File == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart < (LONGLONG)sizeof(StoreHeader))
+	{
+		Close();
+		return false;
+	}
+	m_Size = (size_t)size.QuadPart;
+
+	m_Mapping = CreateFileMapping(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_Mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_Base = static_cast<const std::byte*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_File = open(file, O_RDONLY | O_CLOEXEC);
+	if (m_File < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(m_File, &st) != 0 || st.st_size < (off_t)sizeof(StoreHeader))
+	{
+		Close();
+		return false;
+	}
+	m_Size = (size_t)st.st_size;
+
+	void* base = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+	m_Base = base == MAP_FAILED ? nullptr : static_cast<const std::byte*>(base);
+#endif
+
+	if (!m_Base || !Validate())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void GroupStoreView::Close()
+{
+#ifdef _WIN32
+	if (m_Base)
+		UnmapViewOfFile(m_Base);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+	if (m_File != INVALID_HANDLE_VALUE)
+		CloseHandle(m_File);
+	m_Mapping = NULL;
+	m_File = INVALID_HANDLE_VALUE;
+#else
+	if (m_Base)
+		munmap(const_cast<std::byte*>(m_Base), m_Size);
+	if (m_File >= 0)
+		close(m_File);
+	m_File = -1;
+#endif
+
+	m_Base = nullptr;
+	m_Text = nullptr;
+	m_Size = 0;
+	m_Groups = 0;
+}
+
+bool GroupStoreView::Validate()
+{
+	const auto& header = *reinterpret_cast<const StoreHeader*>(m_Base);
+
+	if (header.magic != StoreMagic || header.version != StoreVersion || header.charSize != sizeof(wchar_t))
+		return false;
+
+	if (TextOffset(header) + header.textChars * sizeof(wchar_t) != m_Size)
+		return false;
+
+	if (Checksum(m_Base + sizeof(StoreHeader), m_Size - sizeof(StoreHeader)) != header.checksum)
+		return false;
+
+	auto groups = reinterpret_cast<const StoreGroup*>(m_Base + GroupsOffset());
+	for (size_t i = 0; i < header.groupCount; i++)
+	{
+		const auto& group = groups[i];
+		if (!InBounds(group.name, header.textChars))
+			return false;
+		if ((std::uint64_t)group.firstMember + group.memberCount > header.memberCount)
+			return false;
+	}
+
+	auto windows = reinterpret_cast<const StoredWindow*>(m_Base + MembersOffset(header));
+	for (size_t i = 0; i < header.memberCount; i++)
+	{
+		const auto& win = windows[i];
+		if (!InBounds(win.appId, header.textChars) || !InBounds(win.image, header.textChars) ||
+			!InBounds(win.className, header.textChars) || !InBounds(win.title, header.textChars))
+			return false;
+	}
+
+	m_Text = reinterpret_cast<const wchar_t*>(m_Base + TextOffset(header));
+	m_Groups = header.groupCount;
+	return true;
+}
+
+StoredGroup GroupStoreView::Group(size_t idx) const
+{
+	const auto& header = *reinterpret_cast<const StoreHeader*>(m_Base);
+	const auto& group = reinterpret_cast<const StoreGroup*>(m_Base + GroupsOffset())[idx];
+	auto windows = reinterpret_cast<const StoredWindow*>(m_Base + MembersOffset(header));
+
+	return {
+		Text(group.name),
+		std::span<const StoredWindow>(windows + group.firstMember, group.memberCount),
+	};
+}
+
+std::wstring_view GroupStoreView::Text(const StoredText& text) const
+{
+	return std::wstring_view(m_Text + text.offset, text.length);
+}
+
+WindowIdentity GroupStoreView::Identity(const StoredWindow& win) const
+{
+	return WindowIdentity{
+		std::wstring(Text(win.appId)),
+		std::wstring(Text(win.image)),
+		std::wstring(Text(win.className)),
+		std::wstring(Text(win.title)),
+	};
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "platform.h"
+#include "windowidentity.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The group stack on disk. A flat file of fixed size records: a header, one
+// record per group (top first), every member and then all the text, so a
+// mapping of it is read in place with nothing to parse. Written to a
+// temporary and renamed over the old file, a crash leaves one or the other.
+
+// A string in the text at the end of the file, in chars
+struct StoredText
+{
+	std::uint32_t offset;
+	std::uint32_t length;
+};
+
+struct StoredWindow
+{
+	std::uint64_t hwnd;
+	std::uint64_t key;  // from FnWindowKey when saved, 0 when there was none
+	StoredText appId;   // the WindowIdentity, all empty when there was none
+	StoredText image;
+	StoredText className;
+	StoredText title;
+};
+
+// Anything cheap that tells a window apart from a later one given the same
+// handle, 0 when unknown
+using FnWindowKey = std::function<std::uint64_t(HWND hWin)>;
+
+// What the window is for when its handle is gone, null when unknown
+using FnWindowIdentity = std::function<const WindowIdentity*(HWND hWin)>;
+
+struct StoredGroup
+{
+	std::wstring_view name;
+	std::span<const StoredWindow> members;
+};
+
+struct GroupStoreEntry
+{
+	std::wstring_view name;
+	const std::vector<HWND>* members;  // null for none
+};
+
+// Replaces file with the groups in order, top first
+bool GroupStoreWrite(const char* file, std::span<const GroupStoreEntry> groups,
+	const FnWindowKey& key, const FnWindowIdentity& identity);
+
+// Read only mapping of a file GroupStoreWrite wrote. Open checks the header,
+// the bounds of every record and the checksum; after that the accessors point
+// straight into the mapping and stay valid until Close.
+class GroupStoreView
+{
+public:
+	GroupStoreView() = default;
+	~GroupStoreView();
+
+	GroupStoreView(const GroupStoreView&) = delete;
+	GroupStoreView& operator=(const GroupStoreView&) = delete;
+
+	bool Open(const char* file);
+	void Close();
+
+	size_t GroupCount() const { return m_Groups; }
+	StoredGroup Group(size_t idx) const;
+	std::wstring_view Text(const StoredText& text) const;
+	WindowIdentity Identity(const StoredWindow& win) const;
+
+private:
+	bool Validate();
+
+	const wchar_t* m_Text = nullptr;
+	const std::byte* m_Base = nullptr;
+	size_t m_Size = 0;
+	size_t m_Groups = 0;
+
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = NULL;
+#else
+	int m_File = -1;
+#endif
+};
@@ -1,6 +1,7 @@
 #include "itemview.h"
 
 #include "ResourceMine.h"
+#include "trace.h"
 
 #include <strsafe.h>
 #include <CommCtrl.h>
@@ -15,7 +16,7 @@ constexpr int TextLimit = 80;
 struct ItemViewData
 {
     HWND hWnd;
-    std::vector<std::wstring> mItems;
+    ListModel mModel;
     FnRenamed onRename;
 
     ItemViewData(HWND wnd, FnRenamed&& rename)
@@ -28,135 +29,6 @@ namespace {
     std::vector<std::shared_ptr<ItemViewData>> mViews;
 
     std::unordered_map<int,std::weak_ptr<ItemViewData>> mViewIds;
-
-    UINT GetLVItemState(HWND hwnd, int i, UINT mask)
-    {
-        return ListView_GetItemState(hwnd, i, mask);
-    }
-
-    void GetLVItemText(HWND hwnd, int iItem, int iSubItem, LPTSTR pszText, int cchTextMax)
-    {
-        ListView_GetItemText(hwnd, iItem, iSubItem, pszText, cchTextMax);
-    }
-
-    void SetLVItemText(HWND hwnd, int i, int iSubItem, LPTSTR pszText)
-    {
-        ListView_SetItemText(hwnd, i, iSubItem, pszText);
-    }
-
-
-    BOOL GetLVItem(HWND hListView, UINT mask, int iItem, int iSubItem,
-        LPLVITEM pitem, UINT stateMask)
-    {
-        pitem->mask = mask;
-        pitem->stateMask = stateMask;
-        pitem->iItem = iItem;
-        pitem->iSubItem = iSubItem;
-        return ListView_GetItem(hListView, pitem);
-    }
-
-
-    int GetHeaderItemCount(HWND hwndHD)
-    {
-        return Header_GetItemCount(hwndHD);
-    }
-
-    HWND GetLVHeaderControl(HWND hListView)
-    {
-        return ListView_GetHeader(hListView);
-    }
-
-    int GetLVColumnsCount(HWND hListView)
-    {
-        return (GetHeaderItemCount(GetLVHeaderControl(hListView)));
-    }
-
-    void SwapLVItems(HWND hListView, int iItem1, int iItem2)
-    {
-        constexpr size_t LOCAL_BUFFER_SIZE = 4096;
-        LVITEM lvi1{}, lvi2{};
-
-        UINT uMask = LVIF_TEXT | LVIF_IMAGE | LVIF_INDENT | LVIF_PARAM | LVIF_STATE;
-
-        std::vector<TCHAR> szBuffer1;
-        szBuffer1.resize(LOCAL_BUFFER_SIZE + 1);
-
-        std::vector<TCHAR> szBuffer2;
-        szBuffer2.resize(LOCAL_BUFFER_SIZE + 1);
-
-        lvi1.pszText = szBuffer1.data();
-        lvi2.pszText = szBuffer2.data();
-        lvi1.cchTextMax = (int)szBuffer1.size();
-        lvi2.cchTextMax = (int)szBuffer2.size();
-
-        BOOL bResult1 = GetLVItem(hListView, uMask, iItem1, 0, &lvi1, (UINT)-1);
-        BOOL bResult2 = GetLVItem(hListView, uMask, iItem2, 0, &lvi2, (UINT)-1);
-
-        if (bResult1 && bResult2)
-        {
-            lvi1.iItem = iItem2;
-            lvi2.iItem = iItem1;
-            lvi1.mask = uMask;
-            lvi2.mask = uMask;
-            lvi1.stateMask = (UINT)-1;
-            lvi2.stateMask = (UINT)-1;
-            //swap the items
-            ListView_SetItem(hListView, &lvi1);
-            ListView_SetItem(hListView, &lvi2);
-
-            int iColCount = GetLVColumnsCount(hListView);
-            //Loop for swapping each column in the items.
-            for (int iIndex = 1; iIndex < iColCount; iIndex++)
-            {
-                szBuffer1[0] = '\0';
-                szBuffer2[0] = '\0';
-                GetLVItemText(hListView, iItem1, iIndex,
-                    szBuffer1.data(), LOCAL_BUFFER_SIZE);
-                GetLVItemText(hListView, iItem2, iIndex,
-                    szBuffer2.data(), LOCAL_BUFFER_SIZE);
-                SetLVItemText(hListView, iItem2, iIndex, szBuffer1.data());
-                SetLVItemText(hListView, iItem1, iIndex, szBuffer2.data());
-            }
-        }
-    }
-
-    void RotateUp(HWND hListView)
-    {
-        int iCount = ListView_GetItemCount(hListView);
-
-        for (int iIndex = 1; iIndex < iCount; iIndex++)
-            SwapLVItems(hListView, iIndex, iIndex - 1);
-    }
-
-    void RotateDown(HWND hListView)
-    {
-        int iCount = ListView_GetItemCount(hListView);
-
-        for (int iIndex = iCount - 1; iIndex >= 0; iIndex--)
-            SwapLVItems(hListView, iIndex, iIndex + 1);
-    }
-
-    //Move up the selected items
-    void MoveLVSelectedItemsUp(HWND hListView)
-    {
-        int iCount = ListView_GetItemCount(hListView);
-
-        for (int iIndex = 1; iIndex < iCount; iIndex++)
-            if (GetLVItemState(hListView, iIndex, LVIS_SELECTED) != 0)
-                SwapLVItems(hListView, iIndex, iIndex - 1);
-
-    }
-
-    //Move down the selected items
-    void MoveLVSelectedItemsDown(HWND hListView)
-    {
-        int iCount = ListView_GetItemCount(hListView);
-
-        for (int iIndex = iCount - 1; iIndex >= 0; iIndex--)
-            if (GetLVItemState(hListView, iIndex, LVIS_SELECTED) != 0)
-                SwapLVItems(hListView, iIndex, iIndex + 1);
-
-    }
 }
 
 int ViewNext()
@@ -185,66 +57,6 @@ HWND ListViewGetHwnd(IVHandle h)
     return ptr->hWnd;
 }
 
-void ListViewGetItems(IVHandle h, std::vector<std::wstring>& items)
-{
-    if (h.expired())
-        return;
-    auto ptr = h.lock();
-
-    std::copy((*ptr).mItems.begin(), (*ptr).mItems.end(), items.end());
-}
-
-BOOL ListViewRotateUp(IVHandle h)
-{
-    if (h.expired())
-        return FALSE;
-
-    auto ptr = h.lock();
-    if (ptr->mItems.empty())
-        return FALSE;
-
-    if (ptr->mItems.size() == 1)
-        return TRUE;
-
-    RotateUp(ptr->hWnd);
-
-    std::rotate(ptr->mItems.begin(), ptr->mItems.begin() + 1, ptr->mItems.end());
-
-    return TRUE;
-}
-
-BOOL ListViewRotateDown(IVHandle h)
-{
-    if (h.expired())
-        return FALSE;
-
-    auto ptr = h.lock();
-    if (ptr->mItems.empty())
-        return FALSE;
-
-    if (ptr->mItems.size() == 1)
-        return TRUE;
-
-    RotateDown(ptr->hWnd);
-
-    std::rotate(ptr->mItems.begin(), ptr->mItems.end() - 1, ptr->mItems.end());
-
-    return TRUE;
-}
-
-BOOL ListViewGetTop(IVHandle h, std::wstring& name)
-{
-    if (h.expired())
-        return FALSE;
-
-    auto ptr = h.lock();
-    if (ptr->mItems.empty())
-        return FALSE;
-
-    name = ptr->mItems[0];
-    return TRUE;
-}
-
 IVHandle ListViewCreate(HWND hwndParent, HINSTANCE hInst, FnRenamed&& rename)
 {
     INITCOMMONCONTROLSEX icex;           // Structure for control initialization.
@@ -258,9 +70,10 @@ IVHandle ListViewCreate(HWND hwndParent, HINSTANCE hInst, FnRenamed&& rename)
     int nViewId = ViewNext();
 
     // Create the list-view window in report view with label editing enabled.
+    // The items are owner data, asked for by row from the ListModel.
     HWND hWndListView = CreateWindow(WC_LISTVIEW,
         L"",
-        WS_VISIBLE | WS_CHILD | WS_BORDER | LVS_REPORT | LVS_EDITLABELS | WS_EX_CLIENTEDGE,
+        WS_VISIBLE | WS_CHILD | WS_BORDER | LVS_REPORT | LVS_EDITLABELS | LVS_OWNERDATA | WS_EX_CLIENTEDGE,
         0, 0,
         rcClient.right - rcClient.left,
         rcClient.bottom - rcClient.top,
@@ -294,84 +107,43 @@ IVHandle ListViewCreate(HWND hwndParent, HINSTANCE hInst, FnRenamed&& rename)
     return handle;
 }
 
-BOOL ListViewDelItemTop(IVHandle h, std::wstring& deleted)
+BOOL ListViewSetItems(IVHandle h, const std::vector<ListItem>& items)
 {
+    TRACE_SCOPE("ListViewSetItems");
+
     if (h.expired())
         return FALSE;
 
     auto ptr = h.lock();
 
-    if (ptr->mItems.empty())
-        return FALSE;
-
     HWND hWnd = (*ptr).hWnd;
 
-    if (!ListView_DeleteItem(hWnd, 0))
+    switch ((*ptr).mModel.Update(items))
     {
-        return FALSE;
+    case ListModel::Change::None:
+        return TRUE;
+    case ListModel::Change::Rotated:
+        // every row shows another item now, the count stays
+        return InvalidateRect(hWnd, NULL, FALSE);
+    case ListModel::Change::Replaced:
+    default:
+        // repaints everything unless told not to
+        ListView_SetItemCountEx(hWnd, (int)(*ptr).mModel.Size(), LVSICF_NOSCROLL);
+        return TRUE;
     }
-
-    deleted = ptr->mItems[0];
-
-    ptr->mItems.erase(ptr->mItems.begin());
-    return TRUE;
 }
 
-BOOL ListViewAddItemTop(IVHandle h, const std::wstring& text)
+BOOL ListViewRotate(IVHandle h, int steps)
 {
-    if (h.expired())
-        return FALSE;
-
-    auto ptr = h.lock();
-
-    HWND hWnd = (*ptr).hWnd;
+    TRACE_SCOPE("ListViewRotate");
 
-    LV_ITEM lvI;
-    lvI.mask = LVIF_TEXT | /*LVIF_IMAGE | LVIF_PARAM | */ LVIF_STATE;
-    lvI.state = 0;
-    lvI.stateMask = 0;
-
-    lvI.iItem = 0;
-    lvI.iSubItem = 0;
-    lvI.pszText = LPSTR_TEXTCALLBACK;
-    lvI.cchTextMax = TextLimit;
-
-    (*ptr).mItems.insert((*ptr).mItems.begin(), text);
-
-    if (ListView_InsertItem(hWnd, &lvI) == -1)
-        return FALSE;
-
-    return TRUE;
-}
-
-BOOL ListViewAddSecondItem(IVHandle h, const std::wstring& text)
-{
     if (h.expired())
         return FALSE;
 
     auto ptr = h.lock();
 
-    if (ptr->mItems.empty())
-        return FALSE;
-
-    HWND hWnd = (*ptr).hWnd;
-
-    LV_ITEM lvI;
-    lvI.mask = LVIF_TEXT | /*LVIF_IMAGE | LVIF_PARAM | */ LVIF_STATE;
-    lvI.state = 0;
-    lvI.stateMask = 0;
-
-    lvI.iItem = 1;
-    lvI.iSubItem = 0;
-    lvI.pszText = LPSTR_TEXTCALLBACK;
-    lvI.cchTextMax = TextLimit;
-
-    (*ptr).mItems.insert((*ptr).mItems.begin() + 1, text);
-
-    if (ListView_InsertItem(hWnd, &lvI) == -1)
-        return FALSE;
-
-    return TRUE;
+    (*ptr).mModel.Rotate(steps);
+    return InvalidateRect((*ptr).hWnd, NULL, FALSE);
 }
 
 LRESULT ListViewNotifyHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
@@ -392,21 +164,17 @@ LRESULT ListViewNotifyHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam
     {
     case LVN_GETDISPINFO:
     {
-        std::wstring& name = data.mItems[pLvdi->item.iItem];
-        switch (pLvdi->item.iSubItem)
-        {
-        case 0:     // Address
-            pLvdi->item.pszText = name.data();
-            break;
-        default:
+        if (pLvdi->item.iItem < 0 || (size_t)pLvdi->item.iItem >= data.mModel.Size())
             break;
-        }
+
+        const std::wstring& name = data.mModel.At(pLvdi->item.iItem).name;
+        if (pLvdi->item.iSubItem == 0 && (pLvdi->item.mask & LVIF_TEXT))
+            StringCchCopy(pLvdi->item.pszText, pLvdi->item.cchTextMax, name.c_str());
     }
     break;
 
     case LVN_BEGINLABELEDIT:
     {
-        std::wstring& name = data.mItems[pLvdi->item.iItem];
         HWND hWndEdit;
 
         // Get the handle to the edit box.
@@ -418,47 +186,31 @@ LRESULT ListViewNotifyHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam
 
     case LVN_ENDLABELEDIT:
     {
-        std::wstring& name = data.mItems[pLvdi->item.iItem];
         // Save the new label information
         if ((pLvdi->item.iItem != -1) &&
+            ((size_t)pLvdi->item.iItem < data.mModel.Size()) &&
             (pLvdi->item.pszText != NULL))
         {
+            size_t row = (size_t)pLvdi->item.iItem;
+
             size_t len = 0;
             if (SUCCEEDED(StringCchLength(pLvdi->item.pszText, TextLimit, &len)))
             {
-                std::wstring oldName = name;
-
-                std::wstring newName;
-                newName.resize(len + 1);
-
-                name.clear();
-
-                std::copy(pLvdi->item.pszText, pLvdi->item.pszText + len, newName.begin());
+                std::wstring newName(pLvdi->item.pszText, len);
 
-                if (std::ranges::find(data.mItems, newName) != std::end(data.mItems))
-                {
-                    name = oldName;
-                    ListView_SetItemText(data.hWnd, pLvdi->item.iItem, 0, name.data());
+                // the row asks the model again, a refused name never shows
+                if (newName == data.mModel.At(row).name || !data.mModel.Rename(row, newName))
                     return FALSE;
-                }
 
-                name = newName;
+                const ListItem& item = data.mModel.At(row);
+                data.onRename(item.id, item.name);
 
-                data.onRename(oldName, name);
-
-                ListView_SetItemText(data.hWnd, pLvdi->item.iItem, 0, name.data());
+                ListView_RedrawItems(data.hWnd, pLvdi->item.iItem, pLvdi->item.iItem);
 
                 return TRUE;
             }
         }
     }
-    break;
-    case LVN_INSERTITEM:
-    {
-        ListView_RedrawItems(data.hWnd, 0, data.mItems[pLvdi->item.iItem].size());
-        UpdateWindow(data.hWnd);
-        UpdateWindow(hWnd); /* the parent window */
-    }
     break;
         /*
     case LVN_COLUMNCLICK:
@@ -475,4 +227,4 @@ LRESULT ListViewNotifyHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam
     }
 
     return 1L;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -6,24 +6,25 @@
 #include <memory>
 #include <functional>
 
+#include "listmodel.h"
+
 struct ItemViewData;
 
 using IVHandle = std::weak_ptr<ItemViewData>;
 
-using FnRenamed = std::function<void(const std::wstring& oldName, const std::wstring& newName)>;
+using FnRenamed = std::function<void(GroupId id, const std::wstring& newName)>;
 
 IVHandle ListViewCreate(HWND hwndParent, HINSTANCE hInst, FnRenamed&& rename);
 
 HWND ListViewGetHwnd(IVHandle);
-void ListViewGetItems(IVHandle, std::vector<std::wstring>& items);
 
 LRESULT ListViewNotifyHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
-BOOL ListViewAddItemTop(IVHandle h, const std::wstring& text);
-BOOL ListViewAddSecondItem(IVHandle h, const std::wstring& text);
-BOOL ListViewDelItemTop(IVHandle h, std::wstring& deleted);
-
 
-BOOL ListViewRotateUp(IVHandle h);
-BOOL ListViewRotateDown(IVHandle h);
+// Shows a list that is kept somewhere else. The list view is an owner data
+// one over a ListModel: a rotation of what it shows only moves the model's
+// head and repaints, anything else resets the item count.
+BOOL ListViewSetItems(IVHandle h, const std::vector<ListItem>& items);
 
-BOOL ListViewGetTop(IVHandle h, std::wstring& name);
\ No newline at end of file
+// The list last set rotated by steps, RotateUp ones: only the model's head
+// moves and the rows repaint
+BOOL ListViewRotate(IVHandle h, int steps);
\ No newline at end of file
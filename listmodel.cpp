@@ -0,0 +1,72 @@
+#include "listmodel.h"
+
+ListModel::Change ListModel::Update(const std::vector<ListItem>& items)
+{
+	size_t n = m_Items.size();
+	if (n != items.size() || n == 0)
+	{
+		if (n == 0 && items.empty())
+			return Change::None;
+		Assign(items);
+		return Change::Replaced;
+	}
+
+	// ids are unique, where the new top sits is the only rotation to try
+	size_t shift = 0;
+	while (shift < n && At(shift).id != items[0].id)
+		shift++;
+
+	if (shift < n)
+	{
+		size_t row = 0;
+		while (row < n && At((shift + row) % n) == items[row])
+			row++;
+
+		if (row == n)
+		{
+			if (shift == 0)
+				return Change::None;
+			m_Head = Slot(shift);
+			return Change::Rotated;
+		}
+	}
+
+	Assign(items);
+	return Change::Replaced;
+}
+
+void ListModel::Rotate(int steps)
+{
+	if (m_Items.empty())
+		return;
+
+	int n = (int)m_Items.size();
+	steps %= n;
+	if (steps < 0)
+		steps += n;
+	m_Head = Slot((size_t)steps);
+}
+
+bool ListModel::Rename(size_t row, const std::wstring& name)
+{
+	auto& item = m_Items[Slot(row)];
+	if (item.name == name)
+		return true;
+	if (m_Names.contains(name))
+		return false;
+
+	m_Names.erase(item.name);
+	m_Names.insert(name);
+	item.name = name;
+	return true;
+}
+
+void ListModel::Assign(const std::vector<ListItem>& items)
+{
+	m_Items = items;
+	m_Head = 0;
+
+	m_Names.clear();
+	for (const auto& item : m_Items)
+		m_Names.insert(item.name);
+}
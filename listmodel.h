@@ -0,0 +1,52 @@
+#pragma once
+
+#include "groupnames.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// A group as the list shows it
+struct ListItem
+{
+	GroupId id;
+	std::wstring name;
+
+	bool operator==(const ListItem&) const = default;
+};
+
+// The group stack behind the owner data list view: the items sit in a ring
+// and row 0 is wherever the head is, so a rotation of the stack only moves
+// the head. Kept apart from the window so it can be driven without one.
+class ListModel
+{
+public:
+	enum class Change
+	{
+		None,
+		Rotated, // same items, the head moved
+		Replaced,
+	};
+
+	size_t Size() const { return m_Items.size(); }
+	const ListItem& At(size_t row) const { return m_Items[Slot(row)]; }
+
+	// Brings the model to a new stack, top first. A stack that is this one
+	// rotated only moves the head.
+	Change Update(const std::vector<ListItem>& items);
+
+	// Row 0 moves to the bottom for positive steps, like IGroupList::RotateUp
+	void Rotate(int steps);
+
+	// false when another group has the name, renaming to the same name is fine
+	bool Rename(size_t row, const std::wstring& name);
+	bool NameTaken(const std::wstring& name) const { return m_Names.contains(name); }
+
+private:
+	size_t Slot(size_t row) const { return (m_Head + row) % m_Items.size(); }
+	void Assign(const std::vector<ListItem>& items);
+
+	std::vector<ListItem> m_Items;
+	size_t m_Head = 0;
+	std::unordered_set<std::wstring> m_Names;  // for refusing a name that is taken
+};
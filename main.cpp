@@ -2,19 +2,26 @@
 #include <strsafe.h>
 #include <assert.h>
 #include <vector>
-#include <unordered_map>
-#include <algorithm>
-#include <iterator>
+#include <memory>
 #include <functional>
 #include <utility>
-#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <string>
 
 #include <inttypes.h>
 
 #include "ResourceMine.h"
 
 #include "itemview.h"
-#include "virtdesktop2.h"
+#include "comshell.h"
+#include "commandqueue.h"
+#include "groups.h"
+#include "movepool.h"
+#include "trace.h"
+#include "worker.h"
 
 #include <iostream>
 
@@ -33,6 +40,16 @@ enum class Cmd
 	PrevGroup,
 	NewGroup,
 	DeleteGroup,
+	DumpTrace,
+	UnionGroups,
+	IntersectGroups,
+	SubtractGroups,
+	Undo,
+	Redo,
+	NextScreenGroup,
+	PrevScreenGroup,
+	NewScreenGroup,
+	DeleteScreenGroup,
 };
 
 struct scope_guard
@@ -97,502 +114,325 @@ void ShowLastError(LPCTSTR lpszFunction)
   LocalFree(lpDisplayBuf);
 }
 
-namespace std {
-	template<> struct hash<GUID>
-	{
-		size_t operator()(const GUID& guid) const noexcept {
-			const std::uint64_t* p = reinterpret_cast<const std::uint64_t*>(&guid);
-			std::hash<std::uint64_t> hash;
-			return hash(p[0]) ^ hash(p[1]);
-		}
-	};
-}
-
 namespace {
-	constexpr size_t MaxMoveHistory = 15;
-
-	std::unordered_map<std::wstring, std::vector<HWND>> m_Groups;
-
-	std::vector<HWND> m_Moved;
+	// Full re-enumeration, notifications keep the desktop cache current in between
+	constexpr UINT_PTR ResyncTimer = 1;
+	constexpr UINT ResyncIntervalMs = 30 * 1000;
+
+	// New windows are sorted into the groups the rules name this soon after
+	// they show, unless a command takes them in first
+	constexpr UINT_PTR TrackTimer = 2;
+	constexpr UINT TrackIntervalMs = 500;
+
+	// The state file is written this long after a command at the latest, and
+	// only while no other command waits; a burst of hotkeys is saved once
+	constexpr UINT_PTR SaveTimer = 3;
+	constexpr UINT SaveIntervalMs = 2 * 1000;
+
+	// Posted back by the worker, pointers in lParam are ours to delete
+	constexpr UINT WM_GROUPS_REPORT = WM_APP + 1;   // std::wstring*
+	constexpr UINT WM_GROUPS_PROGRESS = WM_APP + 2; // wParam moved so far, lParam of how many
+	constexpr UINT WM_GROUPS_CHANGED = WM_APP + 3;  // std::vector<ListItem>*, the group stack
+	constexpr UINT WM_GROUPS_ROTATED = WM_APP + 4;  // wParam RotateUp steps of the stack last sent
 
 	HWND m_hWnd;
 	IVHandle m_hList;
 
-	IServiceProvider* pServiceProvider = NULL;
-	IApplicationViewCollection* viewCollection = NULL;
-	IVirtualDesktopManager* pDesktopManager = NULL;
-	IVirtualDesktopManagerInternal* pDesktopManagerInternal = NULL;
-
 	HINSTANCE mHInstance;
-}
-
-void MoveToScratch(HWND hWin, BOOL track = FALSE);
-void MoveToCurrent(HWND hWin);
-
 
-size_t WrapIdx(size_t curIdx, size_t max, int dir)
-{
-	int idx = ((int)curIdx) + dir;
-	while (idx < 0) { idx += (int)max; }
-	while (idx >= max) { idx -= (int)max; }
-	return (size_t)idx;
-}
+	// Every command runs on the worker, so a long switch never stalls the
+	// message loop. The shell, the group state and the group stack belong to the
+	// worker thread; the list view only shows a copy of the stack.
+	CommandWorker m_Worker;
+	ComShellWait m_WorkerWait;
 
-void MoveDesktop(int dir)
-{
-	IVirtualDesktop* current = nullptr;
-	if (!SUCCEEDED(pDesktopManagerInternal->GetCurrentDesktop(&current))) return;
-	GUID currentId{ 0 };
-	if (!SUCCEEDED(current->GetID(&currentId))) return;
+	std::unique_ptr<ComShell> m_Shell;
+	VectorGroupList m_GroupList;
 
-	IObjectArray* pObjectArray = nullptr;
-	if (!SUCCEEDED(pDesktopManagerInternal->GetDesktops(&pObjectArray))) return;
-	UINT count = 0;
-	if (!SUCCEEDED(pObjectArray->GetCount(&count))) return;
+	// -desktops gives every group a desktop of its own instead of parking
+	// the ones not shown on the scratch desktop
+	GroupsOptions m_GroupsOpts;
 
-	std::vector<IVirtualDesktop*> desktops;
+	// Threads the moves of one batch are spread over, each in the MTA with a
+	// shell of its own. 0 keeps every move on the worker.
+	constexpr UINT MoveThreads = 4;
+	MovePool m_MovePool;
 
-	IVirtualDesktop* pCur = nullptr;
-	UINT curIdx = 0;
-	for (UINT i = 0; i < count; i++)
+	template<typename T>
+	void PostOwned(UINT msg, T* data)
 	{
-		if (FAILED(pObjectArray->GetAt(i, __uuidof(IVirtualDesktop), (void**)&pCur)))
-			continue;
-		GUID id = { 0 };
-		if (FAILED(pCur->GetID(&id)))
-			continue;
-
-		desktops.push_back(pCur);
-		if (id == currentId)
-		{
-			curIdx = i;
-		}
+		if (!PostMessage(m_hWnd, msg, 0, (LPARAM)data))
+			delete data;
 	}
 
-	IVirtualDesktop* pTarget = NULL;
-
-	pTarget = desktops[WrapIdx(curIdx, desktops.size(), dir)];
-
-	pDesktopManagerInternal->SwitchDesktop(pTarget);
-}
-
-void NextDesktop()
-{
-	MoveDesktop(1);
-}
+	// The groups as of the last command, read back on the next start. Only the
+	// stack spanning every monitor is kept, a monitor handle means nothing to
+	// the next session.
+	constexpr const char* StateFile = "wingroups-groups.bin";
 
-void PrevDesktop()
-{
-	MoveDesktop(-1);
-}
-
-BOOL CALLBACK EnumCurrent(HWND hwnd, LPARAM lparam)
-{
-	BOOL onDesk = FALSE;
-	if (SUCCEEDED(pDesktopManager->IsWindowOnCurrentVirtualDesktop(hwnd, &onDesk)))
-	{
-		if (!onDesk)
-			return TRUE;
-
-		std::vector<HWND>& wins = *(std::vector<HWND>*)lparam;
-
-		wins.push_back(hwnd);
-	}
-
-	return TRUE;
-}
-
-BOOL CALLBACK EnumNotCurrent(HWND hwnd, LPARAM lparam)
-{
-	BOOL onDesk = FALSE;
-	if (SUCCEEDED(pDesktopManager->IsWindowOnCurrentVirtualDesktop(hwnd, &onDesk)))
+	// A handle only gets reused by another window after this one closed, the
+	// owning process and the window class tell the two apart
+	std::uint64_t WindowKey(HWND hWin)
 	{
-		if (onDesk)
-			return TRUE;
-
-		std::vector<HWND>& wins = *(std::vector<HWND>*)lparam;
-
-		wins.push_back(hwnd);
+		DWORD pid = 0;
+		GetWindowThreadProcessId(hWin, &pid);
+		ATOM cls = (ATOM)GetClassLongPtr(hWin, GCW_ATOM);
+		return ((std::uint64_t)pid << 32) | cls;
 	}
 
-	return TRUE;
-}
-
-std::wstring NextGroupName()
-{
-	static int agroupidx = 0;
-
-	std::wstring ret;
-
-	while (ret.empty() || m_Groups.find(ret) != m_Groups.end())
-	{
-		std::wstringstream str;
-		str << TEXT("AutoGroup") << (++agroupidx);
-		ret = str.str();
-	}
-
-	return ret;
-}
-
-void ShowTopGroup()
-{
-	std::wstring name;
-	auto success = ListViewGetTop(m_hList, name);
-	assert(success);
-
-	auto it = m_Groups.find(name);
-	assert(it != m_Groups.end());
-
-	std::vector<HWND> currentWin;
+	// The list view shows the stack the last group hotkey went to, null for
+	// the one spanning every monitor
+	std::atomic<HMONITOR> m_ListMonitor{ nullptr };
 
-	EnumWindows(EnumCurrent, (LPARAM)&currentWin);
-
-	std::vector<HWND>& showWin = (*it).second;
-
-	for (const auto& hwnd : currentWin)
+	// The group stack with names, for the list view
+	std::vector<ListItem>* ListItems()
 	{
-		if (std::ranges::find(showWin, hwnd) == showWin.end())
-			MoveToScratch(hwnd);
-	}
-
-	for (const auto& hwnd : showWin)
-	{
-		if (std::ranges::find(currentWin, hwnd) == currentWin.end())
-			MoveToCurrent(hwnd);
-	}
-}
+		std::vector<GroupId> order;
+		GetGroupStack(m_ListMonitor, order);
 
-void MoveGroup(int dir)
-{
-	// all top level windows go into the current window
-	std::wstring name;
-	if (!ListViewGetTop(m_hList, name))
-	{
-		name = NextGroupName();
-		ListViewAddItemTop(m_hList, name);
+		auto items = new std::vector<ListItem>();
+		items->reserve(order.size());
+		for (auto id : order)
+			items->push_back({ id, GroupName(id) });
+		return items;
 	}
 
-	auto it = m_Groups.find(name);
+	// The stack the list view was last sent and its marks then. Worker only.
+	bool m_ListSent = false;
+	HMONITOR m_SentMonitor = nullptr;
+	GroupStackMarks m_SentMarks;
 
-	if (m_Groups.find(name) == m_Groups.end())
+	// Brings the list view up to date after a command: the steps of a
+	// rotation, which only move its head, the whole stack for anything else
+	void PostListChange()
 	{
-		auto added = m_Groups.emplace(
-			std::piecewise_construct,
-			std::forward_as_tuple(name),
-			std::forward_as_tuple<std::vector<HWND>>({})
-		);
-
-		assert(added.second);
-		it = added.first;
-	}
-
-	(*it).second.clear();
-
-	EnumWindows(EnumCurrent, (LPARAM) & ((*it).second));
-
-	if (m_Groups.size() < 2) // nothing to rotate to
-		return;
-
-	for (;dir > 0; --dir)
-		if (!ListViewRotateUp(m_hList))
-		{
-			MessageBox(NULL, TEXT("Failed to rotate Lists"), NULL, MB_OK | MB_ICONERROR);
-			return;
-		}
+		HMONITOR monitor = m_ListMonitor;
+		GroupStackMarks marks = GroupsStackMarks(monitor);
 
-	for (;dir < 0; ++dir)
-		if (!ListViewRotateDown(m_hList))
+		if (m_ListSent && monitor == m_SentMonitor && marks.edits == m_SentMarks.edits)
 		{
-			MessageBox(NULL, TEXT("Failed to rotate Lists"), NULL, MB_OK | MB_ICONERROR);
-			return;
+			auto steps = marks.rotated - m_SentMarks.rotated;
+			if (steps && !PostMessage(m_hWnd, WM_GROUPS_ROTATED, (WPARAM)(int)steps, 0))
+			{
+				// lost, the next command sends the whole stack
+				m_ListSent = false;
+				return;
+			}
 		}
+		else
+			PostOwned(WM_GROUPS_CHANGED, ListItems());
 
-	name.clear();
-	if (!ListViewGetTop(m_hList, name))
-	{
-		MessageBox(NULL, TEXT("Failed to get top after rotate Lists"), NULL, MB_OK | MB_ICONERROR);
-		return;
+		m_ListSent = true;
+		m_SentMonitor = monitor;
+		m_SentMarks = marks;
 	}
 
-	auto itG = m_Groups.find(name);
-	if (itG == m_Groups.end())
+	// The screen the window in front is on, its stack is the one the
+	// CTRL+ALT group hotkeys work on. Nearest, as the shell places windows,
+	// or a window half off screen would pick another stack than its group's.
+	HMONITOR ForegroundMonitor()
 	{
-		MessageBox(NULL, TEXT("Groups out of sync"), NULL, MB_OK | MB_ICONERROR);
-		return;
+		return MonitorFromWindow(GetForegroundWindow(), MONITOR_DEFAULTTONEAREST);
 	}
 
-	if (!(*itG).second.empty())
+	// Readies the next switch while nothing else is waiting, a job posted
+	// after this one finds the worker busy and the prefetch dropped anyway
+	void PrefetchWhenIdle()
 	{
-		for (const auto& hwnd : (*it).second)
-		{
-			if (std::ranges::find( (*itG).second, hwnd) == (*itG).second.end())
-				MoveToScratch(hwnd);
-		}
-
-		for (const auto& hwnd : (*itG).second)
-		{
-			if (std::ranges::find((*it).second, hwnd) == (*it).second.end())
-				MoveToCurrent(hwnd);
-		}
+		m_Worker.Post([]() {
+			if (m_Worker.Pending() == 0)
+				GroupsPrefetch();
+		});
 	}
 
-	// in the case of the target group being empty we'll keep the same windows
-}
+	// Set by every command, cleared once the state file has it. Worker only.
+	bool m_SaveDirty = false;
 
-void NextGroup()
-{
-	MoveGroup(1);
-}
-
-void PrevGroup()
-{
-	MoveGroup(-1);
-}
-
-void DeleteGroup()
-{
-	std::wstring name;
-
-	if (!ListViewDelItemTop(m_hList, name))
+	void SaveIfDirty()
 	{
-		MessageBox(NULL, TEXT("No group to delete"), NULL, MB_OK | MB_ICONERROR);
-		return;
+		if (!m_SaveDirty)
+			return;
+		m_SaveDirty = false;
+		GroupsSave(StateFile, m_GroupList.mItems, WindowKey);
 	}
 
-	auto it = m_Groups.find(name);
-	assert(it != m_Groups.end());
-	m_Groups.erase(it);
-
-	ShowTopGroup();
-}
-
-void NewGroup()
-{
-	// Capture current
-	if (!m_Groups.empty())
+	// Writing the file and asking explorer about unsaved windows stays off the
+	// hotkey path, a command waiting puts the save off to the next tick
+	void SaveWhenIdle()
 	{
-		std::wstring top;
-		auto success = ListViewGetTop(m_hList, top);
-		assert(success);
-
-		auto& windows = m_Groups[top];
-		windows.clear();
-
-		EnumWindows(EnumCurrent, (LPARAM)&windows);
+		m_Worker.Post([]() {
+			if (m_Worker.Pending() == 0)
+				SaveIfDirty();
+		});
 	}
 
-	// Make new
-	auto name = NextGroupName();
-	if (!ListViewAddItemTop(m_hList, name))
+	// Queues a command, the list view is brought up to date once it ran
+	void RunCommand(std::function<void()>&& cmd)
 	{
-		MessageBox(NULL, TEXT("Failed to allocate new group"), NULL, MB_OK | MB_ICONERROR);
-		return;
+		m_Worker.Post([cmd = std::move(cmd)]() {
+			cmd();
+			PostListChange();
+			m_SaveDirty = true;
+		});
+		PrefetchWhenIdle();
 	}
 
-	auto added = m_Groups.emplace(
-		std::piecewise_construct,
-		std::forward_as_tuple(name),
-		std::forward_as_tuple<std::vector<HWND>>({})
-	);
+	// Read once at start, one rule a line as ParseWindowRules takes them
+	constexpr const char* RulesFile = "wingroups-rules.txt";
 
-	assert(added.second);
-}
-
-void MoveWinToDesktop(HWND hWin, IVirtualDesktop* pTarget)
-{
-	IApplicationView* app = NULL;
-	if (!SUCCEEDED(viewCollection->GetViewForHwnd(hWin, &app))) return;
-	if (!SUCCEEDED(pDesktopManagerInternal->MoveViewToDesktop(app, pTarget))) return;
-}
-
-void RestoreScratched()
-{
-	IVirtualDesktop* current = nullptr;
-	if (!SUCCEEDED(pDesktopManagerInternal->GetCurrentDesktop(&current))) return;
-	GUID currentId{ 0 };
-	if (!SUCCEEDED(current->GetID(&currentId))) return;
-
-	std::vector<HWND> list;
-
-	EnumWindows(EnumNotCurrent, (LPARAM)&list);
-
-	for (const auto& item : list)
+	void LoadRules()
 	{
-		MoveToCurrent(item);
-	}
-}
-
-void MoveToCurrent(HWND hWin)
-{
-	if (hWin == m_hWnd) return;
-
-	BOOL onDesk = FALSE;
-	if (!SUCCEEDED(pDesktopManager->IsWindowOnCurrentVirtualDesktop(hWin, &onDesk))) return;
-	if (onDesk) return;
-
-	IVirtualDesktop* current = nullptr;
-	if (!SUCCEEDED(pDesktopManagerInternal->GetCurrentDesktop(&current))) return;
-	GUID currentId{ 0 };
-	if (!SUCCEEDED(current->GetID(&currentId))) return;
-
-	IApplicationView* app = NULL;
-	if (!SUCCEEDED(viewCollection->GetViewForHwnd(hWin, &app))) return;
-	if (!SUCCEEDED(pDesktopManagerInternal->MoveViewToDesktop(app, current))) return;
-}
+		std::ifstream in(RulesFile, std::ios::binary);
+		if (!in)
+			return;
 
-void MoveBackFromOther()
-{
-	if (m_Moved.empty())
-		return;
-	MoveToCurrent(*m_Moved.end() - 1);
-	m_Moved.erase(m_Moved.end() - 1);
-}
+		std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		int length = MultiByteToWideChar(CP_UTF8, 0, bytes.data(), (int)bytes.size(), nullptr, 0);
+		std::wstring text(length, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, bytes.data(), (int)bytes.size(), text.data(), length);
 
-void MoveAllToOther()
-{
-	std::vector<HWND> list;
-	EnumWindows(EnumCurrent, (LPARAM)&list);
-	for (const auto& win : list)
-	{
-		MoveToScratch(win, FALSE);
+		std::vector<WindowRule> rules;
+		size_t bad = 0;
+		if (!ParseWindowRules(text, rules, &bad))
+			PostOwned(WM_GROUPS_REPORT, new std::wstring(L"wingroups-rules.txt: line " + std::to_wstring(bad) + L" is not a rule"));
+		GroupsSetRules(rules);
 	}
-}
 
-void MoveToScratch(HWND hWin, BOOL track)
-{
-	if (hWin == m_hWnd) return; // ignore ourself
-	//if (m_Desktops.size() < 2) return; // if we don't have enough desktops
+	// Hotkeys wait here until the worker gets to them
+	CommandQueue m_Commands;
 
-	IVirtualDesktop* current = nullptr;
-	if (!SUCCEEDED(pDesktopManagerInternal->GetCurrentDesktop(&current))) return;
-	GUID currentId{ 0 };
-	if (!SUCCEEDED(current->GetID(&currentId))) return;
+	// Written by ALT+S, and on exit when started with -trace
+	constexpr const char* TraceFile = "wingroups-trace.json";
 
-	IObjectArray* pObjectArray = nullptr;
-	if (!SUCCEEDED(pDesktopManagerInternal->GetDesktops(&pObjectArray))) return;
-	UINT count = 0;
-	if (!SUCCEEDED(pObjectArray->GetCount(&count))) return;
-
-	IVirtualDesktop* pTarget = nullptr;
-	for (UINT i = 0; i < count; i++)
+	// First press starts tracing, the ones after write out what the ring holds
+	void DumpTrace()
 	{
-		if (FAILED(pObjectArray->GetAt(i, __uuidof(IVirtualDesktop), (void**)&pTarget)))
-			continue;
-		GUID id = { 0 };
-		if (SUCCEEDED(pTarget->GetID(&id)) && id == currentId)
-			continue;
-		break;
-	}
-
-	if (!pTarget) return;
+		if (!TraceEnabled())
+		{
+			TraceEnable(true);
+			return;
+		}
 
-	IApplicationView* app = NULL;
-	if (!SUCCEEDED(viewCollection->GetViewForHwnd(hWin, &app))) return;
-	if (!SUCCEEDED(pDesktopManagerInternal->MoveViewToDesktop(app, pTarget))) return;
+		if (!TraceWriteChromeFile(TraceFile))
+			MessageBox(NULL, TEXT("Failed writing wingroups-trace.json"), NULL, MB_OK | MB_ICONERROR);
+	}
 
-	if (track)
+	void QueueHotKey(WPARAM id)
 	{
-		while (m_Moved.size() > MaxMoveHistory)
-			m_Moved.erase(m_Moved.begin());
-
-		m_Moved.push_back(hWin);
-	}
-}
+		QueuedCommand cmd{ Command::MoveAway };
 
-void MoveSwap()
-{
-	std::vector<HWND> current;
-	EnumWindows(EnumCurrent, (LPARAM)&current);
+		switch ((Cmd)id)
+		{
+			case Cmd::MoveAway:
+			{
+				// which window is meant is decided now, not when the worker gets to it
+				cmd.hwnd = GetForegroundWindow();
+			} break;
+			case Cmd::MoveAllAway: cmd = { Command::MoveAllAway }; break;
+			case Cmd::MoveBack: cmd = { Command::MoveBack }; break;
+			case Cmd::MoveSwap: cmd = { Command::MoveSwap }; break;
+			case Cmd::RestoreTo: cmd = { Command::RestoreTo }; break;
+			case Cmd::NextDesktop: cmd = { Command::Desktop, 1 }; break;
+			case Cmd::PrevDesktop: cmd = { Command::Desktop, -1 }; break;
+			case Cmd::NextGroup: cmd = { Command::Group, 1 }; break;
+			case Cmd::PrevGroup: cmd = { Command::Group, -1 }; break;
+			case Cmd::NewGroup: cmd = { Command::NewGroup }; break;
+			case Cmd::DeleteGroup: cmd = { Command::DeleteGroup }; break;
+			case Cmd::UnionGroups: cmd = { Command::UnionGroups }; break;
+			case Cmd::IntersectGroups: cmd = { Command::IntersectGroups }; break;
+			case Cmd::SubtractGroups: cmd = { Command::SubtractGroups }; break;
+			case Cmd::Undo: cmd = { Command::Undo }; break;
+			case Cmd::Redo: cmd = { Command::Redo }; break;
+			case Cmd::NextScreenGroup: cmd = { Command::Group, 1, nullptr, ForegroundMonitor() }; break;
+			case Cmd::PrevScreenGroup: cmd = { Command::Group, -1, nullptr, ForegroundMonitor() }; break;
+			case Cmd::NewScreenGroup: cmd = { Command::NewGroup, 0, nullptr, ForegroundMonitor() }; break;
+			case Cmd::DeleteScreenGroup: cmd = { Command::DeleteGroup, 0, nullptr, ForegroundMonitor() }; break;
+			case Cmd::DumpTrace:
+			{
+				DumpTrace();
+			} return;
+			default:
+				return;
+		}
 
-	std::vector<HWND> notcurrent;
-	EnumWindows(EnumNotCurrent, (LPARAM)&notcurrent);
+		switch (cmd.cmd)
+		{
+			case Command::Group:
+			case Command::NewGroup:
+			case Command::DeleteGroup:
+			case Command::UnionGroups:
+			case Command::IntersectGroups:
+			case Command::SubtractGroups:
+				m_ListMonitor = cmd.monitor;
+				break;
+			default:
+				break;
+		}
 
-	for (const auto& hwnd : current)
-	{
-		MoveToScratch(hwnd);
+		if (m_Commands.Push(cmd))
+			RunCommand([]() { DrainCommands(m_Commands); });
 	}
 
-	for (const auto& hwnd : notcurrent)
+	// The list view already refused names it shows, a refusal here is put
+	// right by the list that follows the command
+	void OnRenameGroup(GroupId id, const std::wstring& newName)
 	{
-		MoveToCurrent(hwnd);
+		RunCommand([id, newName]() {
+			RenameGroup(id, newName);
+		});
 	}
 }
 
 void DestoryScratchDesktop()
 {
-	if (pDesktopManagerInternal)
-	{
-		pDesktopManagerInternal->Release();
-		pDesktopManagerInternal = NULL;
-	}
-	if (pDesktopManager)
-	{
-		pDesktopManager->Release();
-		pDesktopManager = NULL;
-	}
-	if (viewCollection)
-	{
-		viewCollection->Release();
-		viewCollection = NULL;
-	}
-	if (pServiceProvider)
-	{
-		pServiceProvider->Release();
-		pServiceProvider = NULL;
-	}
-	CoUninitialize();
+	m_Worker.Stop();
 }
 
 bool CreateScratchDesktop(HWND hWin)
 {
-	HRESULT hr;
-
-	hr = ::CoInitialize(NULL);
-	if (!SUCCEEDED(hr))
-	{
-		return false;
-	}
-
-	scope_guard guard([]() {DestoryScratchDesktop();});
-
-	if (!SUCCEEDED(::CoCreateInstance(CLSID_ImmersiveShell, NULL, CLSCTX_LOCAL_SERVER, __uuidof(IServiceProvider), (PVOID*)&pServiceProvider)))
-	{
-		return false;
-	}
-
-	if (!SUCCEEDED(pServiceProvider->QueryService(__uuidof(IApplicationViewCollection), &viewCollection)))
-	{
-		return false;
-	}
-
-	if (!SUCCEEDED(pServiceProvider->QueryService(__uuidof(IVirtualDesktopManager), &pDesktopManager)))
-	{
-		return false;
-	}
-
-	if (!SUCCEEDED(pServiceProvider->QueryService(CLSID_VirtualDesktopManagerInternal, __uuidof(IVirtualDesktopManagerInternal), (PVOID*)&pDesktopManagerInternal)))
-	{
-		return false;
-	}
-
-	if (hr != S_OK)
-	{
-		return false;
-	}
+	// Made on the worker thread so the shell lives in the worker's apartment
+	return m_Worker.Start([hWin]() {
+		TraceThreadName("commands");
 
-	guard.Dismiss();
-
-	return true;
-}
+		auto shell = std::make_unique<ComShell>();
+		if (!shell->Init())
+		{
+			return false;
+		}
 
-void OnRename(const std::wstring& oldName, const std::wstring& newName)
-{
-	auto it = m_Groups.find(oldName);
-	assert(it != m_Groups.end());
-	auto newIt = m_Groups.find(newName);
-	assert(newIt == m_Groups.end());
-	m_Groups[newName] = std::move((*it).second);
-	m_Groups.erase(it);
+		m_Shell = std::move(shell);
+
+		GroupsInit(m_Shell.get(), &m_GroupList, hWin, [](const wchar_t* msg) {
+			PostOwned(WM_GROUPS_REPORT, new std::wstring(msg));
+		}, m_GroupsOpts);
+
+		if (GroupsLoad(StateFile, WindowKey))
+			PostListChange();
+		LoadRules();
+
+		GroupsSetProgress([](size_t done, size_t total) {
+			PostMessage(m_hWnd, WM_GROUPS_PROGRESS, (WPARAM)done, (LPARAM)total);
+		});
+
+		m_MovePool.Start(MoveThreads, []() -> IShellBackend* {
+			TraceThreadName("move pool");
+
+			auto shell = std::make_unique<ComShell>();
+			if (!shell->Init(COINIT_MULTITHREADED))
+				return nullptr;
+			return shell.release();
+		}, [](IShellBackend* shell) {
+			delete shell;
+		});
+		GroupsSetMovePool(&m_MovePool);
+
+		return true;
+	}, []() {
+		SaveIfDirty();
+		GroupsShutdown();
+		m_MovePool.Stop();
+		m_Shell.reset();
+	}, &m_WorkerWait);
 }
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -601,7 +441,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	{
 		case WM_CREATE:
 		{
-			m_hList = ListViewCreate(hWnd, mHInstance, OnRename);
+			m_hList = ListViewCreate(hWnd, mHInstance, OnRenameGroup);
 			if (!ListViewGetHwnd(m_hList))
 				MessageBox(NULL, TEXT("Listview not created!"), NULL, MB_OK);
 		} break;
@@ -627,6 +467,55 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 					return 0;
 			}
 		} break;
+		case WM_TIMER:
+		{
+			if (wParam == ResyncTimer)
+			{
+				m_Worker.Post(GroupsResync);
+				PrefetchWhenIdle();
+				return 0;
+			}
+			if (wParam == TrackTimer)
+			{
+				m_Worker.Post([]() {
+					if (GroupsTrackWindows())
+						m_SaveDirty = true;
+				});
+				return 0;
+			}
+			if (wParam == SaveTimer)
+			{
+				SaveWhenIdle();
+				return 0;
+			}
+		} break;
+		case WM_GROUPS_REPORT:
+		{
+			std::unique_ptr<std::wstring> text((std::wstring*)lParam);
+			MessageBox(NULL, text->c_str(), NULL, MB_OK | MB_ICONERROR);
+			return 0;
+		}
+		case WM_GROUPS_PROGRESS:
+		{
+			TCHAR title[64];
+			if (wParam < (WPARAM)lParam)
+				StringCchPrintf(title, ARRAYSIZE(title), TEXT("Win Groups %zu/%zu"), (size_t)wParam, (size_t)lParam);
+			else
+				StringCchCopy(title, ARRAYSIZE(title), TEXT("Win Groups"));
+			SetWindowText(hWnd, title);
+			return 0;
+		}
+		case WM_GROUPS_CHANGED:
+		{
+			std::unique_ptr<std::vector<ListItem>> items((std::vector<ListItem>*)lParam);
+			ListViewSetItems(m_hList, *items);
+			return 0;
+		}
+		case WM_GROUPS_ROTATED:
+		{
+			ListViewRotate(m_hList, (int)wParam);
+			return 0;
+		}
 		case WM_CLOSE:
 		{
 			DestroyWindow(hWnd);
@@ -640,45 +529,6 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
-void SwitchToAnchorDesktop()
-{
-	GUID anchorDesk = { 0 };
-
-	if (FAILED(pDesktopManager->GetWindowDesktopId(m_hWnd, &anchorDesk)))
-		return;
-
-	IVirtualDesktop* pCur = nullptr;
-	GUID id = { 0 };
-	if (FAILED(pDesktopManagerInternal->GetCurrentDesktop(&pCur)))
-		return;
-	if (FAILED(pCur->GetID(&id)))
-		return;
-
-	if (anchorDesk == id)
-		return;
-
-	IObjectArray* pObjectArray = nullptr;
-	if (FAILED(pDesktopManagerInternal->GetDesktops(&pObjectArray))) return;
-	UINT count = 0;
-	if (FAILED(pObjectArray->GetCount(&count))) return;
-
-	std::vector<IVirtualDesktop*> desktops;
-
-	for (UINT i = 0; i < count; i++)
-	{
-		if (FAILED(pObjectArray->GetAt(i, __uuidof(IVirtualDesktop), (void**)&pCur)))
-			continue;
-		if (FAILED(pCur->GetID(&id)))
-			continue;
-
-		if (anchorDesk == id)
-		{
-			pDesktopManagerInternal->SwitchDesktop(pCur);
-			break;
-		}
-	}
-}
-
 void BindHotKeys()
 {
 	UnregisterHotKey(NULL, (UINT)Cmd::MoveAllAway);
@@ -692,6 +542,16 @@ void BindHotKeys()
 	UnregisterHotKey(NULL, (UINT)Cmd::PrevGroup);
 	UnregisterHotKey(NULL, (UINT)Cmd::NewGroup);
 	UnregisterHotKey(NULL, (UINT)Cmd::DeleteGroup);
+	UnregisterHotKey(NULL, (UINT)Cmd::DumpTrace);
+	UnregisterHotKey(NULL, (UINT)Cmd::UnionGroups);
+	UnregisterHotKey(NULL, (UINT)Cmd::IntersectGroups);
+	UnregisterHotKey(NULL, (UINT)Cmd::SubtractGroups);
+	UnregisterHotKey(NULL, (UINT)Cmd::Undo);
+	UnregisterHotKey(NULL, (UINT)Cmd::Redo);
+	UnregisterHotKey(NULL, (UINT)Cmd::NextScreenGroup);
+	UnregisterHotKey(NULL, (UINT)Cmd::PrevScreenGroup);
+	UnregisterHotKey(NULL, (UINT)Cmd::NewScreenGroup);
+	UnregisterHotKey(NULL, (UINT)Cmd::DeleteScreenGroup);
 
 	RegisterHotKey(NULL, (UINT)Cmd::MoveAllAway, MOD_ALT | MOD_NOREPEAT, 'Q');
 	RegisterHotKey(NULL, (UINT)Cmd::MoveAway, MOD_ALT | MOD_NOREPEAT, 'X');
@@ -704,6 +564,16 @@ void BindHotKeys()
 	RegisterHotKey(NULL, (UINT)Cmd::PrevGroup, MOD_ALT | MOD_NOREPEAT, '2');
 	RegisterHotKey(NULL, (UINT)Cmd::NewGroup, MOD_ALT | MOD_NOREPEAT, 'T');
 	RegisterHotKey(NULL, (UINT)Cmd::DeleteGroup, MOD_ALT | MOD_NOREPEAT, 'D');
+	RegisterHotKey(NULL, (UINT)Cmd::DumpTrace, MOD_ALT | MOD_NOREPEAT, 'S');
+	RegisterHotKey(NULL, (UINT)Cmd::UnionGroups, MOD_ALT | MOD_NOREPEAT, 'U');
+	RegisterHotKey(NULL, (UINT)Cmd::IntersectGroups, MOD_ALT | MOD_NOREPEAT, 'I');
+	RegisterHotKey(NULL, (UINT)Cmd::SubtractGroups, MOD_ALT | MOD_NOREPEAT, 'M');
+	RegisterHotKey(NULL, (UINT)Cmd::Undo, MOD_ALT | MOD_NOREPEAT, VK_BACK);
+	RegisterHotKey(NULL, (UINT)Cmd::Redo, MOD_ALT | MOD_SHIFT | MOD_NOREPEAT, VK_BACK);
+	RegisterHotKey(NULL, (UINT)Cmd::NextScreenGroup, MOD_CONTROL | MOD_ALT | MOD_NOREPEAT, '1');
+	RegisterHotKey(NULL, (UINT)Cmd::PrevScreenGroup, MOD_CONTROL | MOD_ALT | MOD_NOREPEAT, '2');
+	RegisterHotKey(NULL, (UINT)Cmd::NewScreenGroup, MOD_CONTROL | MOD_ALT | MOD_NOREPEAT, 'T');
+	RegisterHotKey(NULL, (UINT)Cmd::DeleteScreenGroup, MOD_CONTROL | MOD_ALT | MOD_NOREPEAT, 'D');
 }
 
 int WINAPI WinMain(HINSTANCE _In_ hInstance, HINSTANCE _In_opt_ hPrev, LPSTR _In_ lpCmdLine, int _In_ nCmdShow)
@@ -740,6 +610,12 @@ int WINAPI WinMain(HINSTANCE _In_ hInstance, HINSTANCE _In_opt_ hPrev, LPSTR _In
 		return 0;
 	}
 
+	TraceThreadName("ui");
+	if (lpCmdLine && strstr(lpCmdLine, "-trace"))
+		TraceEnable(true);
+	if (lpCmdLine && strstr(lpCmdLine, "-desktops"))
+		m_GroupsOpts.desktopPerGroup = true;
+
 	m_hWnd = hWnd;
 
 	hAccelerators = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDR_ACCELERATOR));
@@ -756,61 +632,25 @@ int WINAPI WinMain(HINSTANCE _In_ hInstance, HINSTANCE _In_opt_ hPrev, LPSTR _In
 
 	BindHotKeys();
 
+	SetTimer(hWnd, ResyncTimer, ResyncIntervalMs, NULL);
+	SetTimer(hWnd, TrackTimer, TrackIntervalMs, NULL);
+	SetTimer(hWnd, SaveTimer, SaveIntervalMs, NULL);
+
 	ShowWindow(hWnd, nCmdShow);
 
 	while (GetMessage(&msg, NULL, 0, 0) > 0)
 	{
 		if (msg.message == WM_HOTKEY)
 		{
-			switch ((Cmd)msg.wParam)
-			{
-				case Cmd::MoveAway:
-				{
-					MoveToScratch(GetForegroundWindow(), TRUE);
-				} break;
-				case Cmd::MoveAllAway:
-				{
-					MoveAllToOther();
-				} break;
-				case Cmd::MoveBack:
-				{
-					MoveBackFromOther();
-				} break;
-				case Cmd::MoveSwap:
-				{
-					MoveSwap();
-				} break;
-				case Cmd::RestoreTo:
-				{
-					RestoreScratched();
-				} break;
-				case Cmd::NextDesktop:
-				{
-					NextDesktop();
-				} break;
-				case Cmd::PrevDesktop:
-				{
-					PrevDesktop();
-				} break;
-				case Cmd::NextGroup:
-				{
-					SwitchToAnchorDesktop();
-					NextGroup();
-				} break;
-				case Cmd::PrevGroup:
-				{
-					SwitchToAnchorDesktop();
-					PrevGroup();
-				} break;
-				case Cmd::NewGroup:
-				{
-					NewGroup();
-				} break;
-				case Cmd::DeleteGroup:
-				{
-					DeleteGroup();
-				} break;
-			}
+			TRACE_SCOPE("WM_HOTKEY");
+
+			QueueHotKey(msg.wParam);
+
+			// take in every hotkey already waiting, so rotations pressed in a
+			// burst are folded together before the worker plans anything
+			MSG more;
+			while (PeekMessage(&more, NULL, WM_HOTKEY, WM_HOTKEY, PM_REMOVE))
+				QueueHotKey(more.wParam);
 
 			continue;
 		}
@@ -823,6 +663,9 @@ int WINAPI WinMain(HINSTANCE _In_ hInstance, HINSTANCE _In_opt_ hPrev, LPSTR _In
 		TranslateMessage(&msg);
 		DispatchMessage(&msg);
 	}
-	
+
+	if (TraceEnabled())
+		TraceWriteChromeFile(TraceFile);
+
 	return (int)msg.wParam;
 }
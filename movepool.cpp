@@ -0,0 +1,166 @@
+#include "movepool.h"
+#include "comptr.h"
+#include "desktopregistry.h"
+#include "trace.h"
+
+namespace {
+	// shared is the caller's view going in, the one looked up here coming out
+	MoveOutcome MoveOne(IShellBackend* shell, DesktopRegistry& desktops, HWND hwnd, const GUID& target, SharedView& shared)
+	{
+		MoveOutcome out{ hwnd, MoveResult::Moved, S_OK };
+
+		bool given = shared != nullptr;
+		com_ptr<IApplicationView> view;
+		out.hr = given ? shell->TakeView(shared, view.Put()) : shell->GetViewForHwnd(hwnd, view.Put());
+		shared = nullptr;
+		if (FAILED(out.hr))
+		{
+			out.result = MoveResult::NoView;
+			return out;
+		}
+
+		int idx = desktops.IndexOf(target);
+		if (idx == DesktopRegistry::None && desktops.Refresh(shell, nullptr))
+			idx = desktops.IndexOf(target);
+
+		if (idx == DesktopRegistry::None)
+		{
+			out.result = MoveResult::Failed;
+			out.hr = E_INVALIDARG;
+		}
+		else if (FAILED(out.hr = shell->MoveViewToDesktop(view.Get(), desktops.At(idx))))
+			out.result = MoveResult::Failed;
+		else if (!given && FAILED(shell->ShareView(view.Get(), &shared)))
+			shared = nullptr;
+
+		return out;
+	}
+}
+
+MovePool::~MovePool()
+{
+	Stop();
+}
+
+UINT MovePool::Start(UINT threads, FnEnter&& enter, FnLeave&& leave)
+{
+	Stop();
+
+	m_Enter = std::move(enter);
+	m_Leave = std::move(leave);
+	m_Stop = false;
+	m_Entered = 0;
+	m_Ready = 0;
+
+	for (UINT i = 0; i < threads; i++)
+	{
+		m_Threads.emplace_back([this]() {
+			IShellBackend* shell = m_Enter();
+			{
+				std::lock_guard<std::mutex> lock(m_Lock);
+				++m_Entered;
+				if (shell)
+					++m_Ready;
+			}
+			m_Signal.notify_all();
+
+			if (!shell)
+				return;
+
+			Loop(shell);
+
+			if (m_Leave)
+				m_Leave(shell);
+		});
+	}
+
+	std::unique_lock<std::mutex> lock(m_Lock);
+	m_Signal.wait(lock, [&]() { return m_Entered == threads; });
+	return m_Ready;
+}
+
+void MovePool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stop = true;
+	}
+	m_Signal.notify_all();
+
+	for (auto& thread : m_Threads)
+		thread.join();
+
+	m_Threads.clear();
+	m_Ready = 0;
+}
+
+void MovePool::Move(std::span<const HWND> wins, std::span<SharedView> views, const GUID& target, std::span<MoveOutcome> out, const FnProgress& progress)
+{
+	TRACE_SCOPE("MovePool::Move");
+
+	if (wins.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	m_Wins = wins;
+	m_Views = views;
+	m_Out = out;
+	m_Target = target;
+	m_Progress = &progress;
+	m_Next = 0;
+	m_Finished = 0;
+	++m_Batch;
+
+	m_Signal.notify_all();
+
+	// every thread that took part has let go of the batch before it is cleared
+	m_Signal.wait(lock, [&]() { return m_Finished == wins.size() && m_Active == 0; });
+
+	m_Wins = {};
+	m_Views = {};
+	m_Out = {};
+	m_Progress = nullptr;
+}
+
+void MovePool::Loop(IShellBackend* shell)
+{
+	DesktopRegistry desktops;
+	desktops.Refresh(shell, nullptr);
+
+	size_t seen = 0;
+
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	for (;;)
+	{
+		m_Signal.wait(lock, [&]() { return m_Stop || m_Batch != seen; });
+		if (m_Stop)
+			break;
+
+		seen = m_Batch;
+		++m_Active;
+
+		while (m_Next < m_Wins.size())
+		{
+			size_t idx = m_Next++;
+			HWND hwnd = m_Wins[idx];
+			SharedView& shared = m_Views[idx];
+			GUID target = m_Target;
+
+			// nobody else touches this window's entry until the batch is done
+			lock.unlock();
+			MoveOutcome result = MoveOne(shell, desktops, hwnd, target, shared);
+			lock.lock();
+
+			m_Out[idx] = result;
+			++m_Finished;
+
+			if (*m_Progress)
+				(*m_Progress)(m_Finished, m_Wins.size());
+		}
+
+		--m_Active;
+		m_Signal.notify_all();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "groups.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// A bounded set of threads making MoveViewToDesktop calls side by side. Every
+// thread has its own shell, made on that thread (an MTA on windows), and its
+// own desktops. Views come over shared (IShellBackend::ShareView) from the
+// caller's cache; a thread only looks up the view of a window the caller
+// didn't have, and shares it back.
+class MovePool
+{
+public:
+	// enter runs on each new thread and hands back its shell, or null to sit
+	// out; leave gets the shell back when the thread ends
+	using FnEnter = std::function<IShellBackend*()>;
+	using FnLeave = std::function<void(IShellBackend*)>;
+
+	MovePool() = default;
+	~MovePool();
+
+	MovePool(const MovePool&) = delete;
+	MovePool& operator=(const MovePool&) = delete;
+
+	// At most threads threads, returns how many got a shell
+	UINT Start(UINT threads, FnEnter&& enter, FnLeave&& leave);
+	void Stop();
+
+	UINT Threads() const { return m_Ready; }
+
+	// Moves every window to target and returns when all are done, one outcome
+	// per window in out, in order. progress is called from the pool threads.
+	// views has one entry per window: a view shared by the caller, which the
+	// pool takes, or null for the pool to look it up. Those it found and
+	// moved come back shared in their place, for the caller to take or drop.
+	void Move(std::span<const HWND> wins, std::span<SharedView> views, const GUID& target, std::span<MoveOutcome> out, const FnProgress& progress = nullptr);
+
+private:
+	void Loop(IShellBackend* shell);
+
+	std::vector<std::thread> m_Threads;
+	FnEnter m_Enter;
+	FnLeave m_Leave;
+	UINT m_Ready = 0;
+
+	std::mutex m_Lock;
+	std::condition_variable m_Signal;
+	UINT m_Entered = 0;
+	bool m_Stop = false;
+
+	// the batch being moved, threads take windows from it by index
+	size_t m_Batch = 0;
+	std::span<const HWND> m_Wins;
+	std::span<SharedView> m_Views;
+	std::span<MoveOutcome> m_Out;
+	GUID m_Target{};
+	const FnProgress* m_Progress = nullptr;
+	size_t m_Next = 0;
+	size_t m_Finished = 0;
+	UINT m_Active = 0;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+// The group logic is written against the Win32/COM vocabulary. On windows this
+// pulls in the real headers, everywhere else it supplies just enough of the
+// types (and the slice of the shell interfaces the group logic calls) to build
+// the core and the simulated shell.
+
+#include <cstdint>
+#include <functional>
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <dwmapi.h>
+#include "virtdesktop2.h"
+
+#else
+
+#include <cstring>
+#include <cwchar>
+
+using BOOL = int;
+using UINT = unsigned int;
+using ULONG = unsigned long;
+using DWORD = std::uint32_t;
+using HRESULT = std::int32_t;
+using LPARAM = std::intptr_t;
+using WPARAM = std::uintptr_t;
+using TCHAR = wchar_t;
+using LPCTSTR = const wchar_t*;
+using PWSTR = wchar_t*;
+using PCWSTR = const wchar_t*;
+
+struct HWND__;
+using HWND = HWND__*;
+
+struct HMONITOR__;
+using HMONITOR = HMONITOR__*;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define TEXT(s) L##s
+
+#define CALLBACK
+#define STDMETHODCALLTYPE
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_ACCESSDENIED ((HRESULT)0x80070005L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define WS_CHILD 0x40000000L
+
+#define WS_EX_TOOLWINDOW 0x00000080L
+#define WS_EX_APPWINDOW 0x00040000L
+#define WS_EX_NOACTIVATE 0x08000000L
+
+#define DWM_CLOAKED_APP 0x00000001
+#define DWM_CLOAKED_SHELL 0x00000002
+#define DWM_CLOAKED_INHERITED 0x00000004
+
+struct GUID
+{
+	std::uint32_t Data1;
+	std::uint16_t Data2;
+	std::uint16_t Data3;
+	std::uint8_t Data4[8];
+};
+
+using REFGUID = const GUID&;
+using REFIID = const GUID&;
+
+inline bool operator==(const GUID& a, const GUID& b)
+{
+	return std::memcmp(&a, &b, sizeof(GUID)) == 0;
+}
+
+inline bool operator!=(const GUID& a, const GUID& b)
+{
+	return !(a == b);
+}
+
+struct IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+};
+
+// Subset of IApplicationView from virtdesktop2.h
+struct IApplicationView : public IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE GetThumbnailWindow(HWND* hwnd) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetAppUserModelId(PWSTR* id) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetVirtualDesktopId(GUID* id) = 0;
+};
+
+// Subset of IVirtualDesktop from virtdesktop2.h
+struct IVirtualDesktop : public IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE IsViewVisible(IApplicationView* pView, int* pfVisible) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetID(GUID* pGuid) = 0;
+};
+
+// Same layout as virtdesktop2.h
+struct IVirtualDesktopNotification : public IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE VirtualDesktopCreated(IVirtualDesktop* pDesktop) = 0;
+	virtual HRESULT STDMETHODCALLTYPE VirtualDesktopDestroyBegin(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback) = 0;
+	virtual HRESULT STDMETHODCALLTYPE VirtualDesktopDestroyFailed(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback) = 0;
+	virtual HRESULT STDMETHODCALLTYPE VirtualDesktopDestroyed(IVirtualDesktop* pDesktopDestroyed, IVirtualDesktop* pDesktopFallback) = 0;
+	virtual HRESULT STDMETHODCALLTYPE ViewVirtualDesktopChanged(IApplicationView* pView) = 0;
+	virtual HRESULT STDMETHODCALLTYPE CurrentVirtualDesktopChanged(IVirtualDesktop* pDesktopOld, IVirtualDesktop* pDesktopNew) = 0;
+};
+
+inline constexpr GUID IID_IUnknown = {
+	0x00000000, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+
+inline constexpr GUID IID_IVirtualDesktopNotification = {
+	0xC179334C, 0x4295, 0x40D3, { 0xBE, 0xA1, 0xC6, 0x54, 0xD9, 0x65, 0x60, 0x5A } };
+
+#endif
+
+namespace std {
+	template<> struct hash<GUID>
+	{
+		size_t operator()(const GUID& guid) const noexcept {
+			const std::uint64_t* p = reinterpret_cast<const std::uint64_t*>(&guid);
+			std::hash<std::uint64_t> hash;
+			return hash(p[0]) ^ hash(p[1]);
+		}
+	};
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "platform.h"
+
+#include <string>
+#include <vector>
+
+// What a window is apart from its handle, everything a restarted application
+// gives its new window again
+struct WindowTraits
+{
+	std::wstring appId;      // IApplicationView::GetAppUserModelId
+	std::wstring image;      // full path of the process image
+	std::wstring className;
+	std::wstring title;
+};
+
+// What user32 and DWM know about a window, all of it answered in process.
+// Nothing past visible is filled in for a hidden window.
+struct WindowBasics
+{
+	bool visible = false;   // IsWindowVisible
+	DWORD style = 0;        // GWL_STYLE
+	DWORD exStyle = 0;      // GWL_EXSTYLE
+	HWND owner = nullptr;   // GW_OWNER
+	DWORD cloaked = 0;      // DWMWA_CLOAKED, DWM_CLOAKED_SHELL for another virtual desktop's
+	int width = 0;          // GetWindowRect
+	int height = 0;
+	std::wstring className;
+};
+
+enum class WindowEvent
+{
+	Created,
+	Destroyed,
+	Shown,
+	Hidden,
+};
+
+// Told about windows coming and going, on the thread that owns the shell.
+// Handles can be of any window, top level or not, ours to ignore if we don't
+// know it.
+struct IWindowEventSink
+{
+	virtual ~IWindowEventSink() = default;
+
+	virtual void WindowChanged(WindowEvent event, HWND hWin) = 0;
+};
+
+// A view on its way from one thread's shell to another's, see ShareView
+using SharedView = void*;
+
+// Every call the group logic makes into explorer goes through here, so the same
+// code runs against the live shell (comshell.cpp) or the simulator (simshell.cpp).
+//
+// Follows COM rules: interfaces handed out are AddRef'd for the caller.
+struct IShellBackend
+{
+	virtual ~IShellBackend() = default;
+
+	// EnumWindows, top level windows in z-order
+	virtual void EnumTopLevelWindows(std::vector<HWND>& wins) = 0;
+
+	// AppUserModelId from the window's view, the rest from user32 and the
+	// owning process. Fails for windows explorer doesn't show.
+	virtual HRESULT GetWindowTraits(HWND hWin, WindowTraits& traits) = 0;
+
+	// MonitorFromWindow, the nearest monitor for a window that is on none
+	virtual HRESULT GetWindowMonitor(HWND hWin, HMONITOR* monitor) = 0;
+
+	// user32 and dwmapi only, nothing crosses into explorer. basics is reused
+	// from window to window, the class name keeps its buffer.
+	virtual HRESULT GetWindowBasics(HWND hWin, WindowBasics& basics) = 0;
+
+	// IVirtualDesktopManager
+	virtual HRESULT IsWindowOnCurrentVirtualDesktop(HWND hWin, BOOL* onDesk) = 0;
+	virtual HRESULT GetWindowDesktopId(HWND hWin, GUID* desktopId) = 0;
+
+	// IVirtualDesktopManagerInternal
+	virtual HRESULT GetCurrentDesktop(IVirtualDesktop** desktop) = 0;
+	virtual HRESULT GetDesktops(std::vector<IVirtualDesktop*>& desktops) = 0;
+	virtual HRESULT SwitchDesktop(IVirtualDesktop* desktop) = 0;
+	virtual HRESULT CreateDesktop(IVirtualDesktop** desktop) = 0;  // CreateDesktopW, added last
+	virtual HRESULT MoveViewToDesktop(IApplicationView* view, IVirtualDesktop* desktop) = 0;
+
+	// IApplicationViewCollection
+	virtual HRESULT GetViewForHwnd(HWND hWin, IApplicationView** view) = 0;
+	virtual HRESULT GetViewsByZOrder(std::vector<IApplicationView*>& views) = 0;
+
+	// A view held on this thread made usable on another thread: marshaled,
+	// so the other apartment gets its own proxy to explorer without asking
+	// for the window's view again. Every shared view is taken once, by the
+	// shell of the thread that uses it, or dropped.
+	virtual HRESULT ShareView(IApplicationView* view, SharedView* shared) = 0;
+	virtual HRESULT TakeView(SharedView shared, IApplicationView** view) = 0;
+	virtual void DropView(SharedView shared) = 0;
+
+	// IVirtualDesktopNotificationService
+	virtual HRESULT RegisterForNotifications(IVirtualDesktopNotification* sink, DWORD* cookie) = 0;
+	virtual HRESULT UnregisterForNotifications(DWORD cookie) = 0;
+
+	// SetWinEventHook(EVENT_OBJECT_CREATE..EVENT_OBJECT_HIDE), sinks aren't AddRef'd
+	virtual HRESULT RegisterForWindowEvents(IWindowEventSink* sink, DWORD* cookie) = 0;
+	virtual HRESULT UnregisterForWindowEvents(DWORD cookie) = 0;
+};
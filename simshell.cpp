@@ -0,0 +1,771 @@
+#include "simshell.h"
+#include "trace.h"
+
+#include <thread>
+
+class SimShell::Desktop : public IVirtualDesktop
+{
+public:
+	Desktop(SimShell* owner, UINT idx)
+		: shell(owner)
+		, index(idx)
+	{
+		id = GUID{ 0x5157D000u + idx, 0x5157, 0xD35C, { 0, 0, 0, 0, 0, 0, 0, (std::uint8_t)idx } };
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObject) override
+	{
+		if (ppvObject) *ppvObject = nullptr;
+		return E_NOINTERFACE;
+	}
+	// Lifetime belongs to the shell, the count is only kept so leaks can be observed
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++refs; }
+	ULONG STDMETHODCALLTYPE Release() override { return --refs; }
+
+	HRESULT STDMETHODCALLTYPE IsViewVisible(IApplicationView* pView, int* pfVisible) override;
+
+	HRESULT STDMETHODCALLTYPE GetID(GUID* pGuid) override
+	{
+		shell->Charge(SimCall::DesktopGetID);
+		if (!pGuid) return E_POINTER;
+		*pGuid = id;
+		return S_OK;
+	}
+
+	SimShell* shell;
+	UINT index;
+	GUID id;
+	std::atomic<ULONG> refs = 0;
+};
+
+class SimShell::View : public IApplicationView
+{
+public:
+	View(SimShell* owner, HWND wnd)
+		: shell(owner)
+		, hwnd(wnd)
+	{}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObject) override
+	{
+		if (ppvObject) *ppvObject = nullptr;
+		return E_NOINTERFACE;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++refs; }
+	ULONG STDMETHODCALLTYPE Release() override { return --refs; }
+
+	HRESULT STDMETHODCALLTYPE GetThumbnailWindow(HWND* pHwnd) override
+	{
+		shell->Charge(SimCall::ViewGetThumbnailWindow);
+		if (!pHwnd) return E_POINTER;
+		*pHwnd = hwnd;
+		return S_OK;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetAppUserModelId(PWSTR* id) override
+	{
+		if (id) *id = nullptr;
+		return E_NOTIMPL;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetVirtualDesktopId(GUID* id) override
+	{
+		shell->Charge(SimCall::ViewGetDesktopId);
+		std::lock_guard<std::mutex> lock(shell->state);
+		auto win = shell->Find(hwnd);
+		if (!win) return E_INVALIDARG;
+		*id = shell->desktops[win->desktop]->id;
+		return S_OK;
+	}
+
+	SimShell* shell;
+	HWND hwnd;
+	std::atomic<ULONG> refs = 0;
+};
+
+HRESULT STDMETHODCALLTYPE SimShell::Desktop::IsViewVisible(IApplicationView* pView, int* pfVisible)
+{
+	shell->Charge(SimCall::DesktopIsViewVisible);
+	if (!pView || !pfVisible) return E_POINTER;
+	std::lock_guard<std::mutex> lock(shell->state);
+	auto win = shell->Find(static_cast<View*>(pView)->hwnd);
+	if (!win) return E_INVALIDARG;
+	*pfVisible = win->desktop == index;
+	return S_OK;
+}
+
+namespace {
+	// CallName for the tracer, which only takes narrow names
+	const char* TraceName(SimCall call)
+	{
+		static const char* names[(size_t)SimCall::Count] = {
+			"EnumWindows",
+			"IsWindowOnCurrentVirtualDesktop",
+			"GetWindowDesktopId",
+			"GetCurrentDesktop",
+			"GetDesktops",
+			"SwitchDesktop",
+			"CreateDesktop",
+			"MoveViewToDesktop",
+			"GetViewForHwnd",
+			"GetViewsByZOrder",
+			"GetWindowTraits",
+			"MonitorFromWindow",
+			"IVirtualDesktop::GetID",
+			"IVirtualDesktop::IsViewVisible",
+			"IApplicationView::GetThumbnailWindow",
+			"IApplicationView::GetVirtualDesktopId",
+			"GetWindowBasics",
+		};
+		return (size_t)call < (size_t)SimCall::Count ? names[(size_t)call] : "?";
+	}
+}
+
+SimShell::SimShell(const SimShellOptions& opts)
+	: latency(opts.callLatency)
+	, monitors(opts.monitors ? opts.monitors : 1)
+{
+	if (opts.servers)
+		servers = std::make_unique<std::counting_semaphore<>>(opts.servers);
+
+	UINT count = opts.desktops ? opts.desktops : 1;
+	for (UINT i = 0; i < count; i++)
+		desktops.push_back(std::make_unique<Desktop>(this, i));
+
+	for (UINT i = 0; i < opts.hiddenWindows; i++)
+		AddHiddenWindow();
+
+	for (UINT i = 0; i < opts.windows; i++)
+		AddWindow(current, i % monitors);
+}
+
+SimShell::~SimShell() = default;
+
+HRESULT SimShell::Charge(SimCall call)
+{
+	size_t idx = calls[(size_t)call]++;
+
+	// user32 answers those in process, they are only counted
+	if (latency.count() > 0 && call != SimCall::MonitorFromWindow && call != SimCall::GetWindowBasics)
+	{
+		TraceScope trace(TraceName(call));
+
+		// explorer only has so many threads serving calls, the rest wait their turn
+		if (servers)
+			servers->acquire();
+		std::this_thread::sleep_for(latency);
+		if (servers)
+			servers->release();
+	}
+
+	if (!failing)
+		return S_OK;
+
+	std::lock_guard<std::mutex> lock(state);
+	for (const auto& failure : failures)
+	{
+		if (failure.call == call && failure.index == idx)
+			return failure.hr;
+	}
+	return S_OK;
+}
+
+SimShell::Window* SimShell::Find(HWND hWin)
+{
+	auto it = index.find(hWin);
+	if (it == index.end() || !windows[(*it).second].alive)
+		return nullptr;
+	return &windows[(*it).second];
+}
+
+const SimShell::Window* SimShell::Find(HWND hWin) const
+{
+	return const_cast<SimShell*>(this)->Find(hWin);
+}
+
+void SimShell::EnumTopLevelWindows(std::vector<HWND>& wins)
+{
+	Charge(SimCall::EnumWindows);
+	std::lock_guard<std::mutex> lock(state);
+	for (const auto& win : windows)
+	{
+		if (win.alive)
+			wins.push_back(win.hwnd);
+	}
+}
+
+HRESULT SimShell::IsWindowOnCurrentVirtualDesktop(HWND hWin, BOOL* onDesk)
+{
+	if (HRESULT hr = Charge(SimCall::IsWindowOnCurrentVirtualDesktop); FAILED(hr))
+		return hr;
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win) return E_INVALIDARG;
+	// explorer answers yes for windows it doesn't manage
+	*onDesk = !win->view || win->desktop == current;
+	return S_OK;
+}
+
+HRESULT SimShell::GetWindowDesktopId(HWND hWin, GUID* desktopId)
+{
+	if (HRESULT hr = Charge(SimCall::GetWindowDesktopId); FAILED(hr))
+		return hr;
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win) return E_INVALIDARG;
+	*desktopId = win->view ? desktops[win->desktop]->id : GUID{};
+	return S_OK;
+}
+
+HRESULT SimShell::GetCurrentDesktop(IVirtualDesktop** desktop)
+{
+	if (HRESULT hr = Charge(SimCall::GetCurrentDesktop); FAILED(hr))
+		return hr;
+	if (!desktop) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	*desktop = desktops[current].get();
+	(*desktop)->AddRef();
+	return S_OK;
+}
+
+HRESULT SimShell::GetDesktops(std::vector<IVirtualDesktop*>& out)
+{
+	if (HRESULT hr = Charge(SimCall::GetDesktops); FAILED(hr))
+		return hr;
+	std::lock_guard<std::mutex> lock(state);
+	for (auto& desktop : desktops)
+	{
+		desktop->AddRef();
+		out.push_back(desktop.get());
+	}
+	return S_OK;
+}
+
+HRESULT SimShell::SwitchDesktop(IVirtualDesktop* desktop)
+{
+	if (HRESULT hr = Charge(SimCall::SwitchDesktop); FAILED(hr))
+		return hr;
+	if (!desktop) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	UINT from = current;
+	current = static_cast<Desktop*>(desktop)->index;
+	if (from != current)
+		Raise(Event{ Event::Kind::CurrentChanged, nullptr, from, current });
+	return S_OK;
+}
+
+HRESULT SimShell::CreateDesktop(IVirtualDesktop** desktop)
+{
+	if (HRESULT hr = Charge(SimCall::CreateDesktop); FAILED(hr))
+		return hr;
+	if (!desktop) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	UINT idx = (UINT)desktops.size();
+	desktops.push_back(std::make_unique<Desktop>(this, idx));
+	*desktop = desktops.back().get();
+	(*desktop)->AddRef();
+	Raise(Event{ Event::Kind::DesktopCreated, nullptr, idx, idx });
+	return S_OK;
+}
+
+HRESULT SimShell::MoveViewToDesktop(IApplicationView* view, IVirtualDesktop* desktop)
+{
+	if (HRESULT hr = Charge(SimCall::MoveViewToDesktop); FAILED(hr))
+		return hr;
+	if (!view || !desktop) return E_POINTER;
+
+	std::unique_lock<std::mutex> lock(state);
+	auto win = Find(static_cast<View*>(view)->hwnd);
+	if (!win) return E_INVALIDARG;
+	if (FAILED(win->moveFailure)) return win->moveFailure;
+	UINT from = win->desktop;
+	win->desktop = static_cast<Desktop*>(desktop)->index;
+	if (from != win->desktop)
+		Raise(Event{ Event::Kind::ViewChanged, win->hwnd, from, win->desktop });
+
+	HWND hwnd = win->hwnd;
+	UINT to = win->desktop;
+	auto observer = moved;
+	lock.unlock();
+
+	if (observer)
+		observer(hwnd, to);
+	return S_OK;
+}
+
+HRESULT SimShell::GetViewForHwnd(HWND hWin, IApplicationView** view)
+{
+	if (HRESULT hr = Charge(SimCall::GetViewForHwnd); FAILED(hr))
+		return hr;
+	if (!view) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win || !win->view || !win->shown)
+	{
+		*view = nullptr;
+		return E_INVALIDARG;
+	}
+	*view = win->view.get();
+	(*view)->AddRef();
+	return S_OK;
+}
+
+HRESULT SimShell::GetViewsByZOrder(std::vector<IApplicationView*>& views)
+{
+	if (HRESULT hr = Charge(SimCall::GetViewsByZOrder); FAILED(hr))
+		return hr;
+	std::lock_guard<std::mutex> lock(state);
+	for (auto& win : windows)
+	{
+		if (!win.alive || !win.view || !win.shown)
+			continue;
+		win.view->AddRef();
+		views.push_back(win.view.get());
+	}
+	return S_OK;
+}
+
+// Everything is in one process, the view itself carries over. Not a call
+// into explorer, so not counted.
+HRESULT SimShell::ShareView(IApplicationView* view, SharedView* shared)
+{
+	if (!view || !shared) return E_POINTER;
+	view->AddRef();
+	*shared = view;
+	return S_OK;
+}
+
+HRESULT SimShell::TakeView(SharedView shared, IApplicationView** view)
+{
+	if (!shared || !view) return E_POINTER;
+	*view = static_cast<IApplicationView*>(shared);
+	return S_OK;
+}
+
+void SimShell::DropView(SharedView shared)
+{
+	if (shared)
+		static_cast<IApplicationView*>(shared)->Release();
+}
+
+HWND SimShell::Add(UINT desktop, bool visible, UINT monitor)
+{
+	HWND hwnd = reinterpret_cast<HWND>(nextHandle);
+	nextHandle += 4;
+
+	if (desktop >= desktops.size())
+		desktop = current;
+	if (monitor >= monitors)
+		monitor = 0;
+
+	size_t n = windows.size();
+	WindowTraits traits;
+	traits.appId = L"Sim.App" + std::to_wstring(n % 13);
+	traits.image = L"C:\\Sim\\app" + std::to_wstring(n % 13) + L".exe";
+	traits.className = L"SimWindow";
+	traits.title = L"Document " + std::to_wstring(n);
+
+	index[hwnd] = n;
+	windows.push_back(Window{ hwnd, desktop, true, visible ? std::make_unique<View>(this, hwnd) : nullptr, std::move(traits) });
+	windows.back().monitor = monitor;
+	windows.back().basics.visible = visible;
+	windows.back().basics.width = 1024;
+	windows.back().basics.height = 768;
+
+	Raise(Event{ Event::Kind::Window, hwnd, 0, 0, WindowEvent::Created });
+	if (visible)
+		Raise(Event{ Event::Kind::Window, hwnd, 0, 0, WindowEvent::Shown });
+	return hwnd;
+}
+
+HWND SimShell::AddWindow(UINT desktop, UINT monitor)
+{
+	std::lock_guard<std::mutex> lock(state);
+	return Add(desktop, true, monitor);
+}
+
+HWND SimShell::AddHiddenWindow()
+{
+	std::lock_guard<std::mutex> lock(state);
+	return Add(current, false);
+}
+
+bool SimShell::CloseWindow(HWND hWin)
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win) return false;
+	win->alive = false;
+	Raise(Event{ Event::Kind::Window, hWin, 0, 0, WindowEvent::Destroyed });
+	return true;
+}
+
+HWND SimShell::ReopenWindow(HWND hWin)
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win || !win->view) return nullptr;
+	win->alive = false;
+	Raise(Event{ Event::Kind::Window, hWin, 0, 0, WindowEvent::Destroyed });
+
+	UINT desktop = win->desktop;
+	UINT monitor = win->monitor;
+	WindowTraits traits = win->traits;
+
+	WindowBasics basics = win->basics;
+
+	HWND hwnd = Add(desktop, true, monitor);
+	windows.back().traits = std::move(traits);
+	windows.back().basics = basics;
+	return hwnd;
+}
+
+void SimShell::SetWindowTraits(HWND hWin, const WindowTraits& traits)
+{
+	std::lock_guard<std::mutex> lock(state);
+	if (auto win = Find(hWin))
+		win->traits = traits;
+}
+
+void SimShell::SetWindowShown(HWND hWin, bool shown)
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win || win->shown == shown)
+		return;
+	win->shown = shown;
+	Raise(Event{ Event::Kind::Window, hWin, 0, 0, shown ? WindowEvent::Shown : WindowEvent::Hidden });
+}
+
+void SimShell::SetWindowMonitor(HWND hWin, UINT monitor)
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (win && monitor < monitors)
+		win->monitor = monitor;
+}
+
+HRESULT SimShell::GetWindowMonitor(HWND hWin, HMONITOR* monitor)
+{
+	if (HRESULT hr = Charge(SimCall::MonitorFromWindow); FAILED(hr))
+		return hr;
+	if (!monitor) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win) return E_INVALIDARG;
+	*monitor = Monitor(win->monitor);
+	return S_OK;
+}
+
+void SimShell::SetWindowBasics(HWND hWin, const WindowBasics& basics)
+{
+	std::lock_guard<std::mutex> lock(state);
+	if (auto win = Find(hWin))
+		win->basics = basics;
+}
+
+HRESULT SimShell::GetWindowBasics(HWND hWin, WindowBasics& basics)
+{
+	if (HRESULT hr = Charge(SimCall::GetWindowBasics); FAILED(hr))
+		return hr;
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win) return E_INVALIDARG;
+
+	basics.visible = win->basics.visible && win->shown;
+	if (!basics.visible)
+		return S_OK;
+
+	basics.style = win->basics.style;
+	basics.exStyle = win->basics.exStyle;
+	basics.owner = win->basics.owner;
+	basics.cloaked = win->basics.cloaked;
+	basics.width = win->basics.width;
+	basics.height = win->basics.height;
+	basics.className = win->traits.className;
+	return S_OK;
+}
+
+HRESULT SimShell::GetWindowTraits(HWND hWin, WindowTraits& traits)
+{
+	if (HRESULT hr = Charge(SimCall::GetWindowTraits); FAILED(hr))
+		return hr;
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win || !win->view) return E_INVALIDARG;
+	traits = win->traits;
+	return S_OK;
+}
+
+HRESULT SimShell::RegisterForNotifications(IVirtualDesktopNotification* sink, DWORD* cookie)
+{
+	if (!sink || !cookie) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	sink->AddRef();
+	*cookie = nextCookie++;
+	sinks.emplace_back(*cookie, sink);
+	return S_OK;
+}
+
+HRESULT SimShell::UnregisterForNotifications(DWORD cookie)
+{
+	std::lock_guard<std::mutex> lock(state);
+	for (auto it = sinks.begin(); it != sinks.end(); ++it)
+	{
+		if ((*it).first == cookie)
+		{
+			(*it).second->Release();
+			sinks.erase(it);
+			return S_OK;
+		}
+	}
+	return E_INVALIDARG;
+}
+
+HRESULT SimShell::RegisterForWindowEvents(IWindowEventSink* sink, DWORD* cookie)
+{
+	if (!sink || !cookie) return E_POINTER;
+	std::lock_guard<std::mutex> lock(state);
+	*cookie = nextCookie++;
+	windowSinks.emplace_back(*cookie, sink);
+	return S_OK;
+}
+
+HRESULT SimShell::UnregisterForWindowEvents(DWORD cookie)
+{
+	std::lock_guard<std::mutex> lock(state);
+	for (auto it = windowSinks.begin(); it != windowSinks.end(); ++it)
+	{
+		if ((*it).first == cookie)
+		{
+			windowSinks.erase(it);
+			return S_OK;
+		}
+	}
+	return E_INVALIDARG;
+}
+
+void SimShell::Raise(const Event& ev)
+{
+	bool heard = ev.kind == Event::Kind::Window ? !windowSinks.empty() : !sinks.empty();
+	if (notify && heard)
+		pending.push_back(ev);
+}
+
+size_t SimShell::PumpNotifications()
+{
+	// the sinks call back into us, so they run unlocked on a copy
+	std::vector<Event> events;
+	std::vector<View*> views;
+	std::vector<std::pair<Desktop*, Desktop*>> ends; // from and to, desktops can be added meanwhile
+	std::vector<std::pair<DWORD, IVirtualDesktopNotification*>> targets;
+	std::vector<std::pair<DWORD, IWindowEventSink*>> windowTargets;
+	{
+		std::lock_guard<std::mutex> lock(state);
+		events = std::move(pending);
+		pending.clear();
+		targets = sinks;
+		windowTargets = windowSinks;
+		for (const auto& ev : events)
+		{
+			auto win = ev.kind == Event::Kind::ViewChanged ? Find(ev.hwnd) : nullptr;
+			views.push_back(win ? win->view.get() : nullptr);
+			ends.emplace_back(desktops[ev.from].get(), desktops[ev.to].get());
+		}
+	}
+
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const auto& ev = events[i];
+		if (ev.kind == Event::Kind::Window)
+		{
+			for (auto& sink : windowTargets)
+				sink.second->WindowChanged(ev.window, ev.hwnd);
+			continue;
+		}
+
+		for (auto& sink : targets)
+		{
+			switch (ev.kind)
+			{
+			case Event::Kind::ViewChanged:
+			{
+				if (views[i])
+					sink.second->ViewVirtualDesktopChanged(views[i]);
+			} break;
+			case Event::Kind::CurrentChanged:
+			{
+				sink.second->CurrentVirtualDesktopChanged(ends[i].first, ends[i].second);
+			} break;
+			case Event::Kind::DesktopCreated:
+			{
+				sink.second->VirtualDesktopCreated(ends[i].second);
+			} break;
+			case Event::Kind::Window:
+				break;
+			}
+		}
+	}
+
+	return events.size();
+}
+
+void SimShell::SetNotificationsEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(state);
+	notify = enabled;
+	if (!notify)
+		pending.clear();
+}
+
+void SimShell::SetCurrentDesktop(UINT desktop)
+{
+	std::lock_guard<std::mutex> lock(state);
+	if (desktop >= desktops.size() || desktop == current)
+		return;
+	UINT from = current;
+	current = desktop;
+	Raise(Event{ Event::Kind::CurrentChanged, nullptr, from, current });
+}
+
+void SimShell::MoveWindowTo(HWND hWin, UINT desktop)
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	if (!win || !win->view || desktop >= desktops.size() || desktop == win->desktop)
+		return;
+	UINT from = win->desktop;
+	win->desktop = desktop;
+	Raise(Event{ Event::Kind::ViewChanged, hWin, from, desktop });
+}
+
+void SimShell::FailCall(SimCall call, size_t index, HRESULT hr)
+{
+	std::lock_guard<std::mutex> lock(state);
+	failures.push_back({ call, index, hr });
+	failing = true;
+}
+
+void SimShell::FailMoves(HWND hWin, HRESULT hr)
+{
+	std::lock_guard<std::mutex> lock(state);
+	if (auto win = Find(hWin))
+		win->moveFailure = hr;
+}
+
+void SimShell::ClearFailures()
+{
+	std::lock_guard<std::mutex> lock(state);
+	failures.clear();
+	failing = false;
+	for (auto& win : windows)
+		win.moveFailure = S_OK;
+}
+
+void SimShell::SetCallLatency(std::chrono::microseconds l)
+{
+	latency = l;
+}
+
+void SimShell::OnMove(std::function<void(HWND hWin, UINT desktop)>&& observer)
+{
+	std::lock_guard<std::mutex> lock(state);
+	moved = std::move(observer);
+}
+
+size_t SimShell::DesktopCount() const
+{
+	std::lock_guard<std::mutex> lock(state);
+	return desktops.size();
+}
+
+size_t SimShell::WindowCount() const
+{
+	std::lock_guard<std::mutex> lock(state);
+	return windows.size();
+}
+
+HWND SimShell::WindowAt(size_t idx) const
+{
+	std::lock_guard<std::mutex> lock(state);
+	return idx < windows.size() ? windows[idx].hwnd : nullptr;
+}
+
+int SimShell::WindowDesktop(HWND hWin) const
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	return win && win->view ? (int)win->desktop : -1;
+}
+
+int SimShell::WindowMonitor(HWND hWin) const
+{
+	std::lock_guard<std::mutex> lock(state);
+	auto win = Find(hWin);
+	return win ? (int)win->monitor : -1;
+}
+
+size_t SimShell::MonitorCount() const
+{
+	return monitors;
+}
+
+HMONITOR SimShell::Monitor(UINT monitor) const
+{
+	// never null, null stands for no monitor in the group logic
+	return reinterpret_cast<HMONITOR>((std::uintptr_t)(monitor + 1) << 4);
+}
+
+UINT SimShell::CurrentDesktop() const
+{
+	std::lock_guard<std::mutex> lock(state);
+	return current;
+}
+
+GUID SimShell::DesktopId(UINT desktop) const
+{
+	std::lock_guard<std::mutex> lock(state);
+	return desktops[desktop]->id;
+}
+
+size_t SimShell::CallCount(SimCall call) const
+{
+	return calls[(size_t)call];
+}
+
+size_t SimShell::TotalCalls() const
+{
+	size_t total = 0;
+	for (const auto& c : calls) total += c;
+	return total;
+}
+
+void SimShell::ResetCalls()
+{
+	for (auto& c : calls) c = 0;
+}
+
+const wchar_t* SimShell::CallName(SimCall call)
+{
+	switch (call)
+	{
+	case SimCall::EnumWindows: return L"EnumWindows";
+	case SimCall::IsWindowOnCurrentVirtualDesktop: return L"IsWindowOnCurrentVirtualDesktop";
+	case SimCall::GetWindowDesktopId: return L"GetWindowDesktopId";
+	case SimCall::GetCurrentDesktop: return L"GetCurrentDesktop";
+	case SimCall::GetDesktops: return L"GetDesktops";
+	case SimCall::SwitchDesktop: return L"SwitchDesktop";
+	case SimCall::CreateDesktop: return L"CreateDesktop";
+	case SimCall::MoveViewToDesktop: return L"MoveViewToDesktop";
+	case SimCall::GetViewForHwnd: return L"GetViewForHwnd";
+	case SimCall::GetViewsByZOrder: return L"GetViewsByZOrder";
+	case SimCall::GetWindowTraits: return L"GetWindowTraits";
+	case SimCall::MonitorFromWindow: return L"MonitorFromWindow";
+	case SimCall::DesktopGetID: return L"IVirtualDesktop::GetID";
+	case SimCall::DesktopIsViewVisible: return L"IVirtualDesktop::IsViewVisible";
+	case SimCall::ViewGetThumbnailWindow: return L"IApplicationView::GetThumbnailWindow";
+	case SimCall::ViewGetDesktopId: return L"IApplicationView::GetVirtualDesktopId";
+	case SimCall::GetWindowBasics: return L"GetWindowBasics";
+	default: return L"?";
+	}
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "shellbackend.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <unordered_map>
+#include <vector>
+
+// Every call that would cross into explorer on a live session.
+enum class SimCall
+{
+	EnumWindows,
+	IsWindowOnCurrentVirtualDesktop,
+	GetWindowDesktopId,
+	GetCurrentDesktop,
+	GetDesktops,
+	SwitchDesktop,
+	CreateDesktop,
+	MoveViewToDesktop,
+	GetViewForHwnd,
+	GetViewsByZOrder,
+	GetWindowTraits,
+	MonitorFromWindow,
+	DesktopGetID,
+	DesktopIsViewVisible,
+	ViewGetThumbnailWindow,
+	ViewGetDesktopId,
+	GetWindowBasics,
+	Count
+};
+
+struct SimShellOptions
+{
+	UINT desktops = 2;
+	UINT windows = 0;                       // placed on the current desktop, dealt out over the monitors
+	UINT monitors = 1;
+	UINT hiddenWindows = 0;                 // top level windows explorer has no view for
+	std::chrono::microseconds callLatency{ 0 }; // charged on every SimCall
+	UINT servers = 0;                       // calls served at once, 0 for no limit
+};
+
+// In memory stand-in for explorer: N desktops, M top level windows spread
+// over some monitors, and a counter plus a configurable delay on every
+// cross-process call. Calls may
+// come from any thread, the delays of concurrent calls overlap up to the
+// servers limit.
+class SimShell : public IShellBackend
+{
+public:
+	explicit SimShell(const SimShellOptions& opts);
+	~SimShell() override;
+
+	SimShell(const SimShell&) = delete;
+	SimShell& operator=(const SimShell&) = delete;
+
+	// IShellBackend
+	void EnumTopLevelWindows(std::vector<HWND>& wins) override;
+	HRESULT GetWindowTraits(HWND hWin, WindowTraits& traits) override;
+	HRESULT GetWindowMonitor(HWND hWin, HMONITOR* monitor) override;
+	HRESULT GetWindowBasics(HWND hWin, WindowBasics& basics) override;
+
+	HRESULT IsWindowOnCurrentVirtualDesktop(HWND hWin, BOOL* onDesk) override;
+	HRESULT GetWindowDesktopId(HWND hWin, GUID* desktopId) override;
+
+	HRESULT GetCurrentDesktop(IVirtualDesktop** desktop) override;
+	HRESULT GetDesktops(std::vector<IVirtualDesktop*>& desktops) override;
+	HRESULT SwitchDesktop(IVirtualDesktop* desktop) override;
+	HRESULT CreateDesktop(IVirtualDesktop** desktop) override;
+	HRESULT MoveViewToDesktop(IApplicationView* view, IVirtualDesktop* desktop) override;
+
+	HRESULT GetViewForHwnd(HWND hWin, IApplicationView** view) override;
+	HRESULT GetViewsByZOrder(std::vector<IApplicationView*>& views) override;
+
+	HRESULT ShareView(IApplicationView* view, SharedView* shared) override;
+	HRESULT TakeView(SharedView shared, IApplicationView** view) override;
+	void DropView(SharedView shared) override;
+
+	HRESULT RegisterForNotifications(IVirtualDesktopNotification* sink, DWORD* cookie) override;
+	HRESULT UnregisterForNotifications(DWORD cookie) override;
+
+	HRESULT RegisterForWindowEvents(IWindowEventSink* sink, DWORD* cookie) override;
+	HRESULT UnregisterForWindowEvents(DWORD cookie) override;
+
+	// Simulation control, none of these are counted as calls
+	HWND AddWindow(UINT desktop, UINT monitor = 0);
+	HWND AddHiddenWindow();
+	bool CloseWindow(HWND hWin);
+	// The application closing the window and opening it again, on the same
+	// desktop and with the same traits but a new handle
+	HWND ReopenWindow(HWND hWin);
+	// Windows start out as one of a handful of apps with a numbered title
+	void SetWindowTraits(HWND hWin, const WindowTraits& traits);
+	// The user dragging a window to another screen
+	void SetWindowMonitor(HWND hWin, UINT monitor);
+	// ShowWindow, SW_HIDE or SW_SHOW
+	void SetWindowShown(HWND hWin, bool shown);
+	// Styles, owner, cloaking and size. Windows start out as plain visible
+	// application windows, hidden ones as invisible; the class name is the
+	// traits', and a window SetWindowShown hid stays invisible.
+	void SetWindowBasics(HWND hWin, const WindowBasics& basics);
+	void SetCallLatency(std::chrono::microseconds latency);
+
+	// Explorer saying no. FailCall fails the index'th call of a kind, counted
+	// the way CallCount counts them; FailMoves fails every move of one window,
+	// the way an elevated one does. The failed call is still counted and
+	// charged.
+	void FailCall(SimCall call, size_t index, HRESULT hr = E_FAIL);
+	void FailMoves(HWND hWin, HRESULT hr = E_ACCESSDENIED);
+	void ClearFailures();
+
+	// Told about every successful MoveViewToDesktop, on the calling thread
+	void OnMove(std::function<void(HWND hWin, UINT desktop)>&& observer);
+
+	// What the user does outside of us, raise the same notifications explorer would
+	void SetCurrentDesktop(UINT desktop);
+	void MoveWindowTo(HWND hWin, UINT desktop);
+
+	// Notifications queue up like they do behind the message loop and are only
+	// delivered by PumpNotifications. Disabling them models dropped events.
+	size_t PumpNotifications();
+	void SetNotificationsEnabled(bool enabled);
+
+	size_t DesktopCount() const;
+	size_t WindowCount() const;
+	HWND WindowAt(size_t idx) const;
+	int WindowDesktop(HWND hWin) const; // -1 when the window is unknown, closed or hidden
+	int WindowMonitor(HWND hWin) const; // -1 when the window is unknown or closed
+	size_t MonitorCount() const;
+	HMONITOR Monitor(UINT monitor) const; // what GetWindowMonitor gives for it
+	UINT CurrentDesktop() const;
+	GUID DesktopId(UINT desktop) const;
+
+	size_t CallCount(SimCall call) const;
+	size_t TotalCalls() const;
+	void ResetCalls();
+
+	static const wchar_t* CallName(SimCall call);
+
+private:
+	class Desktop;
+	class View;
+
+	struct Window
+	{
+		HWND hwnd;
+		UINT desktop;
+		bool alive;
+		std::unique_ptr<View> view;         // null for hidden windows
+		WindowTraits traits;
+		HRESULT moveFailure = S_OK;
+		UINT monitor = 0;
+		bool shown = true;                  // hidden ones keep their view, explorer doesn't list it
+		WindowBasics basics;                // className unused, traits has it
+	};
+
+	struct Event
+	{
+		enum class Kind { ViewChanged, CurrentChanged, DesktopCreated, Window } kind;
+		HWND hwnd;
+		UINT from;
+		UINT to;
+		WindowEvent window = WindowEvent::Created;
+	};
+
+	// Counts and delays the call, then the failure injected for it if any
+	HRESULT Charge(SimCall call);
+	void Raise(const Event& ev);
+	HWND Add(UINT desktop, bool visible, UINT monitor = 0);
+	Window* Find(HWND hWin);
+	const Window* Find(HWND hWin) const;
+
+	std::chrono::microseconds latency;
+
+	std::vector<std::unique_ptr<Desktop>> desktops;
+	std::vector<Window> windows;
+	std::unordered_map<HWND, size_t> index;
+
+	UINT current = 0;
+	UINT monitors = 1;
+	std::uintptr_t nextHandle = 0x10000;
+
+	std::vector<std::pair<DWORD, IVirtualDesktopNotification*>> sinks;
+	std::vector<std::pair<DWORD, IWindowEventSink*>> windowSinks;
+	std::vector<Event> pending;
+	DWORD nextCookie = 1;
+	bool notify = true;
+
+	std::function<void(HWND, UINT)> moved;
+
+	struct Failure
+	{
+		SimCall call;
+		size_t index;
+		HRESULT hr;
+	};
+	std::vector<Failure> failures;
+	std::atomic<bool> failing{ false }; // failures isn't empty, checked before locking
+
+	// guards everything above, never held across a delay or a callback
+	mutable std::mutex state;
+	std::unique_ptr<std::counting_semaphore<>> servers;
+
+	std::atomic<size_t> calls[(size_t)SimCall::Count] = {};
+};
@@ -0,0 +1,130 @@
+#include "snapshot.h"
+#include "desktopcache.h"
+#include "trace.h"
+#include "viewcache.h"
+
+WindowSnapshot::~WindowSnapshot()
+{
+	Clear();
+}
+
+void WindowSnapshot::Clear()
+{
+	for (auto& entry : m_Entries)
+		entry.view->Release();
+
+	m_Entries.clear();
+	m_Index.clear();
+	m_Current = GUID{};
+}
+
+HRESULT WindowSnapshot::Capture(IShellBackend* shell, DesktopCache* cache, ViewCache* viewCache)
+{
+	TRACE_SCOPE("WindowSnapshot::Capture");
+
+	Clear();
+
+	HRESULT hr;
+	if (cache && cache->Active())
+	{
+		m_Current = cache->CurrentDesktopId();
+	}
+	else
+	{
+		cache = nullptr;
+
+		IVirtualDesktop* current = nullptr;
+		hr = shell->GetCurrentDesktop(&current);
+		if (FAILED(hr)) return hr;
+		hr = current->GetID(&m_Current);
+		current->Release();
+		if (FAILED(hr)) return hr;
+	}
+
+	std::vector<IApplicationView*> views;
+	hr = shell->GetViewsByZOrder(views);
+	if (FAILED(hr))
+	{
+		for (auto view : views)
+			view->Release();
+		return hr;
+	}
+
+	if (viewCache && !viewCache->Active())
+		viewCache = nullptr;
+
+	m_Entries.reserve(views.size());
+	m_Index.reserve(views.size());
+
+	for (auto view : views)
+	{
+		Entry entry{ nullptr, view, GUID{} };
+
+		if (viewCache)
+			entry.hwnd = viewCache->WindowOf(view);
+
+		if (!entry.hwnd)
+		{
+			if (FAILED(view->GetThumbnailWindow(&entry.hwnd)) || !entry.hwnd)
+			{
+				view->Release();
+				continue;
+			}
+			if (viewCache)
+				viewCache->Add(entry.hwnd, view);
+		}
+
+		HRESULT hrDesk = cache
+			? cache->GetWindowDesktopId(entry.hwnd, &entry.desktop)
+			: view->GetVirtualDesktopId(&entry.desktop);
+
+		if (FAILED(hrDesk) || !m_Index.emplace(entry.hwnd, m_Entries.size()).second)
+		{
+			view->Release();
+			continue;
+		}
+
+		m_Entries.push_back(entry);
+	}
+
+	return S_OK;
+}
+
+const WindowSnapshot::Entry* WindowSnapshot::Find(HWND hWin) const
+{
+	auto it = m_Index.find(hWin);
+	if (it == m_Index.end())
+		return nullptr;
+	return &m_Entries[(*it).second];
+}
+
+bool WindowSnapshot::IsOnCurrent(const Entry& entry) const
+{
+	// no desktop means it shows on all of them
+	return entry.desktop == m_Current || entry.desktop == GUID{};
+}
+
+void WindowSnapshot::Current(std::vector<HWND>& wins) const
+{
+	for (const auto& entry : m_Entries)
+	{
+		if (IsOnCurrent(entry))
+			wins.push_back(entry.hwnd);
+	}
+}
+
+void WindowSnapshot::NotCurrent(std::vector<HWND>& wins) const
+{
+	for (const auto& entry : m_Entries)
+	{
+		if (!IsOnCurrent(entry))
+			wins.push_back(entry.hwnd);
+	}
+}
+
+void WindowSnapshot::SetDesktop(HWND hWin, const GUID& desktopId)
+{
+	auto it = m_Index.find(hWin);
+	if (it != m_Index.end())
+		m_Entries[(*it).second].desktop = desktopId;
+}
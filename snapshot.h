@@ -0,0 +1,52 @@
+#pragma once
+
+#include "shellbackend.h"
+
+#include <unordered_map>
+#include <vector>
+
+class DesktopCache;
+class ViewCache;
+
+// Every switchable window with its view and desktop, taken with one
+// GetViewsByZOrder call at the start of a command and shared by everything the
+// command does, so nothing re-enumerates or looks a view up again.
+class WindowSnapshot
+{
+public:
+	struct Entry
+	{
+		HWND hwnd;
+		IApplicationView* view;
+		GUID desktop;
+	};
+
+	WindowSnapshot() = default;
+	~WindowSnapshot();
+
+	WindowSnapshot(const WindowSnapshot&) = delete;
+	WindowSnapshot& operator=(const WindowSnapshot&) = delete;
+
+	// Desktop ids come from the cache when there is one, and the windows of
+	// the views from the view cache, views it hasn't seen are added to it
+	HRESULT Capture(IShellBackend* shell, DesktopCache* cache, ViewCache* viewCache = nullptr);
+	void Clear();
+
+	const Entry* Find(HWND hWin) const;
+	bool IsOnCurrent(const Entry& entry) const;
+
+	// z-order, same as EnumWindows would give
+	void Current(std::vector<HWND>& wins) const;
+	void NotCurrent(std::vector<HWND>& wins) const;
+
+	// Keep the snapshot true after we move something
+	void SetDesktop(HWND hWin, const GUID& desktopId);
+
+	const GUID& CurrentDesktop() const { return m_Current; }
+	size_t Size() const { return m_Entries.size(); }
+
+private:
+	GUID m_Current{};
+	std::vector<Entry> m_Entries;
+	std::unordered_map<HWND, size_t> m_Index;
+};
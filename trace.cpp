@@ -0,0 +1,244 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace trace_detail {
+	std::atomic<bool> g_Enabled{ false };
+}
+
+namespace {
+	constexpr size_t Capacity = 1 << 15;
+	constexpr size_t Mask = Capacity - 1;
+
+	// seq is odd while the slot is being written, 2 * (index + 1) once it holds
+	// the span with that index
+	struct Slot
+	{
+		std::atomic<std::uint64_t> seq{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<std::uint64_t> start{ 0 };
+		std::atomic<std::uint64_t> end{ 0 };
+		std::atomic<std::uint32_t> tid{ 0 };
+		std::atomic<bool> counter{ false };  // end holds the value
+	};
+
+	struct Span
+	{
+		const char* name;
+		std::uint64_t start;
+		std::uint64_t end;
+		std::uint32_t tid;
+		bool counter;
+	};
+
+	// made on first enable and kept, a late writer may still be in it
+	std::atomic<Slot*> m_Ring{ nullptr };
+	std::atomic<std::uint64_t> m_Head{ 0 };
+
+	std::atomic<std::uint32_t> m_NextTid{ 1 };
+	thread_local std::uint32_t t_Tid = 0;
+
+	std::mutex m_NamesLock;
+	std::vector<std::pair<std::uint32_t, const char*>> m_Names;
+
+	std::uint32_t ThreadId()
+	{
+		if (!t_Tid)
+			t_Tid = m_NextTid.fetch_add(1, std::memory_order_relaxed);
+		return t_Tid;
+	}
+
+	void WriteString(std::ostream& out, const char* text)
+	{
+		out << '"';
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				out << '\\';
+			out << *c;
+		}
+		out << '"';
+	}
+}
+
+void TraceEnable(bool enable)
+{
+	if (enable && !m_Ring.load())
+	{
+		static std::unique_ptr<Slot[]> ring(new Slot[Capacity]);
+		m_Ring.store(ring.get());
+	}
+
+	trace_detail::g_Enabled.store(enable);
+}
+
+void TraceClear()
+{
+	Slot* ring = m_Ring.load();
+	if (!ring)
+		return;
+
+	for (size_t i = 0; i < Capacity; i++)
+		ring[i].seq.store(0, std::memory_order_relaxed);
+	m_Head.store(0);
+}
+
+size_t TraceCapacity()
+{
+	return Capacity;
+}
+
+void TraceThreadName(const char* name)
+{
+	auto tid = ThreadId();
+
+	std::lock_guard<std::mutex> lock(m_NamesLock);
+	for (auto& entry : m_Names)
+	{
+		if (entry.first == tid)
+		{
+			entry.second = name;
+			return;
+		}
+	}
+	m_Names.emplace_back(tid, name);
+}
+
+std::uint64_t TraceNow()
+{
+	return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+	void Record(const char* name, std::uint64_t start, std::uint64_t end, bool counter)
+	{
+		Slot* ring = m_Ring.load(std::memory_order_acquire);
+		if (!ring)
+			return;
+
+		std::uint64_t idx = m_Head.fetch_add(1, std::memory_order_relaxed);
+		Slot& slot = ring[idx & Mask];
+
+		slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.start.store(start, std::memory_order_relaxed);
+		slot.end.store(end, std::memory_order_relaxed);
+		slot.tid.store(ThreadId(), std::memory_order_relaxed);
+		slot.counter.store(counter, std::memory_order_relaxed);
+
+		slot.seq.store(2 * idx + 2, std::memory_order_release);
+	}
+}
+
+void TraceRecord(const char* name, std::uint64_t start, std::uint64_t end)
+{
+	Record(name, start, end, false);
+}
+
+void TraceCount(const char* name, std::uint64_t value)
+{
+	if (TraceEnabled())
+		Record(name, TraceNow(), value, true);
+}
+
+size_t TraceWriteChrome(std::ostream& out)
+{
+	std::vector<Span> spans;
+
+	if (Slot* ring = m_Ring.load())
+	{
+		spans.reserve(Capacity);
+		for (size_t i = 0; i < Capacity; i++)
+		{
+			Slot& slot = ring[i];
+
+			auto before = slot.seq.load(std::memory_order_acquire);
+			if (before == 0 || (before & 1))
+				continue;
+
+			Span span{
+				slot.name.load(std::memory_order_relaxed),
+				slot.start.load(std::memory_order_relaxed),
+				slot.end.load(std::memory_order_relaxed),
+				slot.tid.load(std::memory_order_relaxed),
+				slot.counter.load(std::memory_order_relaxed) };
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.seq.load(std::memory_order_relaxed) != before)
+				continue;
+
+			spans.push_back(span);
+		}
+	}
+
+	std::ranges::sort(spans, {}, &Span::start);
+
+	std::uint64_t base = spans.empty() ? 0 : spans.front().start;
+
+	auto flags = out.flags();
+	auto precision = out.precision(3);
+	out.setf(std::ios::fixed, std::ios::floatfield);
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(m_NamesLock);
+		for (const auto& entry : m_Names)
+		{
+			out << (first ? "\n" : ",\n");
+			first = false;
+			out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << entry.first << ",\"args\":{\"name\":";
+			WriteString(out, entry.second);
+			out << "}}";
+		}
+	}
+
+	for (const auto& span : spans)
+	{
+		out << (first ? "\n" : ",\n");
+		first = false;
+
+		if (span.counter)
+		{
+			out << "{\"ph\":\"C\",\"name\":";
+			WriteString(out, span.name);
+			out << ",\"pid\":1,\"tid\":" << span.tid
+				<< ",\"ts\":" << (double)(span.start - base) / 1000.0
+				<< ",\"args\":{\"value\":" << span.end << "}}";
+			continue;
+		}
+
+		out << "{\"ph\":\"X\",\"name\":";
+		WriteString(out, span.name);
+		out << ",\"pid\":1,\"tid\":" << span.tid
+			<< ",\"ts\":" << (double)(span.start - base) / 1000.0
+			<< ",\"dur\":" << (double)(span.end - span.start) / 1000.0 << "}";
+	}
+
+	out << "\n]}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+
+	return spans.size();
+}
+
+bool TraceWriteChromeFile(const char* path)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	TraceWriteChrome(out);
+	return (bool)out;
+}
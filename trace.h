@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Spans of time under static names, kept in a fixed ring shared by every
+// thread, so the most recent ones are always there to look at and older ones
+// are overwritten. Off until TraceEnable; a scope then costs one relaxed load.
+namespace trace_detail {
+	extern std::atomic<bool> g_Enabled;
+}
+
+inline bool TraceEnabled()
+{
+	return trace_detail::g_Enabled.load(std::memory_order_relaxed);
+}
+
+void TraceEnable(bool enable);
+void TraceClear();
+size_t TraceCapacity();
+
+// Shows up as the thread's name in the exported trace, name must outlive it
+void TraceThreadName(const char* name);
+
+// Nanoseconds on std::chrono::steady_clock, on every platform
+std::uint64_t TraceNow();
+
+// name must be a literal, or live as long as the trace does
+void TraceRecord(const char* name, std::uint64_t start, std::uint64_t end);
+
+// A value as of now, shown as a counter track under name. Same rules for
+// name; does nothing unless tracing is on.
+void TraceCount(const char* name, std::uint64_t value);
+
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name)
+		: m_Name(TraceEnabled() ? name : nullptr)
+		, m_Start(m_Name ? TraceNow() : 0)
+	{
+	}
+
+	~TraceScope()
+	{
+		if (m_Name)
+			TraceRecord(m_Name, m_Start, TraceNow());
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* m_Name;
+	std::uint64_t m_Start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+// What is in the ring as Chrome trace JSON, for chrome://tracing or Perfetto.
+// Safe while other threads keep tracing, spans being written are left out.
+size_t TraceWriteChrome(std::ostream& out);
+bool TraceWriteChromeFile(const char* path);
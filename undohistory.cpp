@@ -0,0 +1,77 @@
+#include "undohistory.h"
+
+#include <algorithm>
+
+void MoveLog::Moved(HWND hWin, const GUID& from, const GUID& to)
+{
+	m_Moves.push_back({ hWin, from, to });
+}
+
+void MoveLog::Take(std::vector<WindowMove>& moves)
+{
+	moves.clear();
+
+	// each window's moves side by side, still in the order they were made
+	m_Order.resize(m_Moves.size());
+	for (size_t i = 0; i < m_Order.size(); i++)
+		m_Order[i] = i;
+	std::sort(m_Order.begin(), m_Order.end(), [this](size_t a, size_t b) {
+		return m_Moves[a].hwnd != m_Moves[b].hwnd ? m_Moves[a].hwnd < m_Moves[b].hwnd : a < b;
+	});
+
+	// a window's first move takes its last destination, the later ones and
+	// moves that came back where they started are dropped
+	size_t kept = 0;
+	for (size_t i = 0; i < m_Order.size();)
+	{
+		auto& first = m_Moves[m_Order[i]];
+		for (i++; i < m_Order.size() && m_Moves[m_Order[i]].hwnd == first.hwnd; i++)
+		{
+			first.to = m_Moves[m_Order[i]].to;
+			m_Moves[m_Order[i]].hwnd = nullptr;
+		}
+
+		if (first.from == first.to)
+			first.hwnd = nullptr;
+		else
+			kept++;
+	}
+
+	moves.reserve(kept);
+	for (const auto& move : m_Moves)
+	{
+		if (move.hwnd)
+			moves.push_back(move);
+	}
+
+	m_Moves.clear();
+}
+
+void UndoHistory::Push(UndoEntry&& entry)
+{
+	m_Entries.resize(m_Done);
+	m_Entries.push_back(std::move(entry));
+	if (m_Entries.size() > m_Limit)
+		m_Entries.pop_front();
+	m_Done = m_Entries.size();
+}
+
+const UndoEntry* UndoHistory::Undo()
+{
+	if (!m_Done)
+		return nullptr;
+	return &m_Entries[--m_Done];
+}
+
+const UndoEntry* UndoHistory::Redo()
+{
+	if (m_Done == m_Entries.size())
+		return nullptr;
+	return &m_Entries[m_Done++];
+}
+
+void UndoHistory::Clear()
+{
+	m_Entries.clear();
+	m_Done = 0;
+}
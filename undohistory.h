@@ -0,0 +1,97 @@
+#pragma once
+
+#include "groupnames.h"
+#include "platform.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A group as a command left it. States share the records of every group a
+// command didn't touch, so keeping a state costs the groups it changed.
+struct GroupRecord
+{
+	std::wstring name;
+	std::vector<HWND> windows;
+};
+
+using GroupRecordPtr = std::shared_ptr<const GroupRecord>;
+
+// The group model at one point: the stacks, each top first, and a record by
+// id, null for ids not in use. Stack 0 is the one spanning every monitor, the
+// ones after it belong to a monitor each, in the order they were made. Kept
+// apart so a session without monitor stacks pays for one list a state.
+struct GroupsState
+{
+	std::vector<GroupId> order;
+	std::vector<std::vector<GroupId>> monitors;
+	std::vector<GroupRecordPtr> groups;
+	std::uint64_t serial = 0;  // a later state has a higher one
+
+	size_t StackCount() const { return monitors.size() + 1; }
+	const std::vector<GroupId>& Stack(size_t idx) const { return idx == 0 ? order : monitors[idx - 1]; }
+	std::vector<GroupId>& Stack(size_t idx) { return idx == 0 ? order : monitors[idx - 1]; }
+
+	const GroupRecord* Find(GroupId id) const { return id < groups.size() ? groups[id].get() : nullptr; }
+};
+
+using GroupsStatePtr = std::shared_ptr<const GroupsState>;
+
+// A window a command moved, from where it was before to where it ended up
+struct WindowMove
+{
+	HWND hwnd;
+	GUID from;
+	GUID to;
+};
+
+// The moves of one command as they are made. A window moved more than once
+// keeps where it started and where it ended, one that ended where it started
+// is left out. Meant to be reused, it keeps its buffers between commands.
+class MoveLog
+{
+public:
+	void Moved(HWND hWin, const GUID& from, const GUID& to);
+	bool Empty() const { return m_Moves.empty(); }
+	// The folded moves in the order each window was first moved, the log is
+	// left empty
+	void Take(std::vector<WindowMove>& moves);
+	void Clear() { m_Moves.clear(); }
+
+private:
+	std::vector<WindowMove> m_Moves;
+	std::vector<size_t> m_Order;
+};
+
+struct UndoEntry
+{
+	GroupsStatePtr before;
+	GroupsStatePtr after;
+	std::vector<WindowMove> moves;
+};
+
+// Linear undo: entries past the cursor can be redone until a new one is
+// pushed. The oldest is dropped once there are more than limit.
+class UndoHistory
+{
+public:
+	explicit UndoHistory(size_t limit = 64) : m_Limit(limit) {}
+
+	void Push(UndoEntry&& entry);
+
+	// The entry to take back or do again, null when there is none. The cursor
+	// has already moved past it.
+	const UndoEntry* Undo();
+	const UndoEntry* Redo();
+
+	size_t UndoCount() const { return m_Done; }
+	size_t RedoCount() const { return m_Entries.size() - m_Done; }
+	void Clear();
+
+private:
+	std::deque<UndoEntry> m_Entries;
+	size_t m_Done = 0;
+	size_t m_Limit;
+};
@@ -0,0 +1,149 @@
+#include "viewcache.h"
+#include "trace.h"
+
+#include <unordered_set>
+#include <vector>
+
+ViewCache::~ViewCache()
+{
+	Detach();
+}
+
+void ViewCache::Attach(IShellBackend* shell)
+{
+	Detach();
+
+	m_Shell = shell;
+	if (FAILED(shell->RegisterForWindowEvents(this, &m_Cookie)))
+		m_Cookie = 0;
+}
+
+void ViewCache::Detach()
+{
+	if (m_Shell && m_Cookie)
+		m_Shell->UnregisterForWindowEvents(m_Cookie);
+
+	m_Shell = nullptr;
+	m_Cookie = 0;
+	m_Windows.clear();
+	m_Views.clear();
+}
+
+HRESULT ViewCache::GetView(HWND hWin, IApplicationView** view)
+{
+	if (!view)
+		return E_POINTER;
+
+	auto it = m_Views.find(hWin);
+	if (it != m_Views.end())
+	{
+		++m_Stats.hits;
+		*view = com_ptr<IApplicationView>((*it).second).Detach();
+		return S_OK;
+	}
+
+	++m_Stats.misses;
+
+	com_ptr<IApplicationView> fresh;
+	HRESULT hr = m_Shell->GetViewForHwnd(hWin, fresh.Put());
+	if (FAILED(hr))
+	{
+		*view = nullptr;
+		return hr;
+	}
+
+	Add(hWin, fresh.Get());
+	*view = fresh.Detach();
+	return S_OK;
+}
+
+bool ViewCache::FindView(HWND hWin, IApplicationView** view)
+{
+	auto it = m_Views.find(hWin);
+	if (it == m_Views.end())
+	{
+		++m_Stats.misses;
+		*view = nullptr;
+		return false;
+	}
+
+	++m_Stats.hits;
+	*view = com_ptr<IApplicationView>((*it).second).Detach();
+	return true;
+}
+
+HWND ViewCache::WindowOf(IApplicationView* view)
+{
+	auto it = m_Windows.find(view);
+	if (it == m_Windows.end())
+	{
+		++m_Stats.misses;
+		return nullptr;
+	}
+	++m_Stats.hits;
+	return (*it).second;
+}
+
+void ViewCache::Add(HWND hWin, IApplicationView* view)
+{
+	if (!m_Shell || !view)
+		return;
+
+	auto& held = m_Views[hWin];
+	if (held.Get() == view)
+		return;
+
+	// a handle explorer reused, or a window it made a new view for
+	if (held)
+		m_Windows.erase(held.Get());
+	held = com_ptr<IApplicationView>::Copy(view);
+
+	// the view a window that is gone still had, it can't be asked any more
+	auto [it, added] = m_Windows.emplace(view, hWin);
+	if (!added)
+	{
+		m_Views.erase((*it).second);
+		(*it).second = hWin;
+	}
+}
+
+void ViewCache::Forget(HWND hWin)
+{
+	auto it = m_Views.find(hWin);
+	if (it == m_Views.end())
+		return;
+
+	m_Windows.erase((*it).second.Get());
+	m_Views.erase(it);
+	++m_Stats.evicted;
+}
+
+void ViewCache::Resync()
+{
+	TRACE_SCOPE("ViewCache::Resync");
+
+	if (!m_Shell || m_Views.empty())
+		return;
+
+	std::vector<HWND> all;
+	m_Shell->EnumTopLevelWindows(all);
+	std::unordered_set<HWND> alive(all.begin(), all.end());
+
+	for (auto it = m_Views.begin(); it != m_Views.end();)
+	{
+		if (alive.find((*it).first) == alive.end())
+		{
+			m_Windows.erase((*it).second.Get());
+			it = m_Views.erase(it);
+			++m_Stats.evicted;
+		}
+		else
+			++it;
+	}
+}
+
+void ViewCache::WindowChanged(WindowEvent event, HWND hWin)
+{
+	if (event == WindowEvent::Destroyed)
+		Forget(hWin);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "comptr.h"
+#include "shellbackend.h"
+
+#include <unordered_map>
+
+// Resident HWND -> IApplicationView map, so moving a window doesn't ask
+// explorer for its view every time, and the reverse for a snapshot to know
+// whose view it was handed without asking the view. Holds a reference on
+// every view in it. A window leaves when it is destroyed, when a call on its
+// view fails, or when Resync no longer finds it; the destroy events are the
+// only way to keep a reused handle from being given a dead window's view.
+//
+// Everything runs on the thread that owns the shell, same as the events.
+class ViewCache : public IWindowEventSink
+{
+public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evicted = 0;  // destroyed, failed or gone at a resync
+	};
+
+	ViewCache() = default;
+	~ViewCache() override;
+
+	ViewCache(const ViewCache&) = delete;
+	ViewCache& operator=(const ViewCache&) = delete;
+
+	// Registers for destroy events. Without them the cache still works, it
+	// just holds closed windows until a call on them fails or a resync.
+	void Attach(IShellBackend* shell);
+	void Detach();
+	bool Active() const { return m_Shell != nullptr; }
+	bool Watching() const { return m_Cookie != 0; }
+
+	// AddRef'd for the caller, same as GetViewForHwnd
+	HRESULT GetView(HWND hWin, IApplicationView** view);
+
+	// The same without asking explorer, false when the window isn't in it
+	bool FindView(HWND hWin, IApplicationView** view);
+	// Whether it is in it, not counted in the stats
+	bool Holds(HWND hWin) const { return m_Views.find(hWin) != m_Views.end(); }
+
+	// The window of a view we hold, null when it isn't one of ours
+	HWND WindowOf(IApplicationView* view);
+	void Add(HWND hWin, IApplicationView* view);
+
+	// A call on the window's view failed, or the window is gone
+	void Forget(HWND hWin);
+
+	// Drops every window EnumWindows no longer has
+	void Resync();
+
+	size_t Size() const { return m_Views.size(); }
+	const Stats& GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats = Stats(); }
+
+	// IWindowEventSink
+	void WindowChanged(WindowEvent event, HWND hWin) override;
+
+private:
+	IShellBackend* m_Shell = nullptr;
+	DWORD m_Cookie = 0;
+
+	std::unordered_map<HWND, com_ptr<IApplicationView>> m_Views;
+	std::unordered_map<IApplicationView*, HWND> m_Windows;
+
+	Stats m_Stats;
+};
@@ -0,0 +1,43 @@
+#include "windowevents.h"
+
+#include <bit>
+
+WindowEventQueue::WindowEventQueue(size_t capacity)
+	: m_Ring(std::bit_ceil(capacity < 2 ? size_t(2) : capacity))
+	, m_Mask(m_Ring.size() - 1)
+{
+}
+
+void WindowEventQueue::WindowChanged(WindowEvent event, HWND hWin)
+{
+	size_t head = m_Head.load(std::memory_order_relaxed);
+	if (head - m_Tail.load(std::memory_order_acquire) >= m_Ring.size())
+	{
+		m_Lost.fetch_add(1, std::memory_order_relaxed);
+		m_Overflow.store(true, std::memory_order_release);
+		return;
+	}
+
+	m_Ring[head & m_Mask] = Event{ event, hWin };
+	m_Head.store(head + 1, std::memory_order_release);
+}
+
+bool WindowEventQueue::Drain(std::vector<Event>& out)
+{
+	// taken first, an overflow after this shows up in the next drain
+	bool whole = !m_Overflow.exchange(false, std::memory_order_acquire);
+
+	size_t tail = m_Tail.load(std::memory_order_relaxed);
+	size_t head = m_Head.load(std::memory_order_acquire);
+	for (; tail != head; tail++)
+		out.push_back(m_Ring[tail & m_Mask]);
+	m_Tail.store(tail, std::memory_order_release);
+
+	return whole;
+}
+
+bool WindowEventQueue::Empty() const
+{
+	return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_relaxed)
+		&& !m_Overflow.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "shellbackend.h"
+
+#include <atomic>
+#include <vector>
+
+// Window events on their way from the hook to the group logic. The hook only
+// pushes into a bounded ring, it never blocks or allocates; the group logic
+// takes everything queued at once before its next command and works on the
+// batch. One thread pushes and one drains, they may be the same.
+//
+// A full ring drops the events that don't fit and remembers that it did, the
+// reader has to look at every window itself then.
+class WindowEventQueue : public IWindowEventSink
+{
+public:
+	struct Event
+	{
+		WindowEvent kind;
+		HWND hwnd;
+	};
+
+	// Rounded up to a power of two
+	explicit WindowEventQueue(size_t capacity = 4096);
+
+	WindowEventQueue(const WindowEventQueue&) = delete;
+	WindowEventQueue& operator=(const WindowEventQueue&) = delete;
+
+	// Appends what was queued to out, in order. false when some of it was
+	// lost since the last drain.
+	bool Drain(std::vector<Event>& out);
+
+	bool Empty() const;
+	size_t Capacity() const { return m_Ring.size(); }
+	size_t Lost() const { return m_Lost.load(std::memory_order_relaxed); }
+
+	// IWindowEventSink
+	void WindowChanged(WindowEvent event, HWND hWin) override;
+
+private:
+	std::vector<Event> m_Ring;
+	size_t m_Mask = 0;
+
+	// next to write and next to read, both only ever go up
+	std::atomic<size_t> m_Head{ 0 };
+	std::atomic<size_t> m_Tail{ 0 };
+
+	std::atomic<bool> m_Overflow{ false };
+	std::atomic<size_t> m_Lost{ 0 };
+};
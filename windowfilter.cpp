@@ -0,0 +1,103 @@
+#include "windowfilter.h"
+#include "trace.h"
+
+namespace {
+	// Counter tracks of the trace, one per stage
+	const char* const TraceNames[(size_t)WindowFilter::Stage::Count] = {
+		"filtered: gone",
+		"filtered: invisible",
+		"filtered: no size",
+		"filtered: tool window",
+		"filtered: owned",
+		"filtered: cloaked",
+		"filtered: class",
+	};
+}
+
+WindowFilter::WindowFilter(const WindowFilterOptions& opts)
+{
+	SetOptions(opts);
+}
+
+void WindowFilter::SetOptions(const WindowFilterOptions& opts)
+{
+	m_Opts = opts;
+	m_Classes.clear();
+	m_Classes.insert(opts.classes.begin(), opts.classes.end());
+}
+
+WindowFilter::Stage WindowFilter::Check(IShellBackend* shell, HWND hWin)
+{
+	if (FAILED(shell->GetWindowBasics(hWin, m_Basics)))
+		return Stage::Shell;
+
+	const auto& basics = m_Basics;
+	if (!basics.visible)
+		return m_Opts.visible ? Stage::Visible : Stage::Count;
+
+	if (m_Opts.size && (basics.width <= 0 || basics.height <= 0))
+		return Stage::Size;
+
+	// a child has no owner either, WS_EX_APPWINDOW doesn't make it top level
+	if (m_Opts.styles && (basics.style & WS_CHILD))
+		return Stage::Styles;
+
+	// what the taskbar and alt-tab go by
+	bool app = (basics.exStyle & WS_EX_APPWINDOW) != 0;
+	if (m_Opts.styles && !app && (basics.exStyle & (WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE)))
+		return Stage::Styles;
+	if (m_Opts.owner && !app && basics.owner)
+		return Stage::Owner;
+
+	if (m_Opts.cloaked && (basics.cloaked & (DWM_CLOAKED_APP | DWM_CLOAKED_INHERITED)))
+		return Stage::Cloaked;
+
+	if (!m_Classes.empty() && m_Classes.find(basics.className) != m_Classes.end())
+		return Stage::Class;
+
+	return Stage::Count;
+}
+
+bool WindowFilter::Passes(IShellBackend* shell, HWND hWin)
+{
+	++m_Stats.checked;
+
+	Stage stage = Check(shell, hWin);
+	if (stage == Stage::Count)
+	{
+		++m_Stats.passed;
+		return true;
+	}
+
+	++m_Stats.rejected[(size_t)stage];
+	return false;
+}
+
+void WindowFilter::Apply(IShellBackend* shell, std::vector<HWND>& wins)
+{
+	TRACE_SCOPE("WindowFilter::Apply");
+
+	Stats before = m_Stats;
+
+	std::erase_if(wins, [this, shell](HWND hWin) { return !Passes(shell, hWin); });
+
+	if (!TraceEnabled())
+		return;
+	for (size_t i = 0; i < (size_t)Stage::Count; i++)
+		TraceCount(TraceNames[i], m_Stats.rejected[i] - before.rejected[i]);
+}
+
+const char* WindowFilter::StageName(Stage stage)
+{
+	switch (stage)
+	{
+	case Stage::Shell: return "gone";
+	case Stage::Visible: return "invisible";
+	case Stage::Size: return "no size";
+	case Stage::Styles: return "tool window";
+	case Stage::Owner: return "owned";
+	case Stage::Cloaked: return "cloaked";
+	case Stage::Class: return "class";
+	default: return "?";
+	}
+}
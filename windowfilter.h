@@ -0,0 +1,80 @@
+#pragma once
+
+#include "shellbackend.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Which checks rule a window out before explorer is asked about it. Each is
+// one more thing user32 or DWM answers in process.
+struct WindowFilterOptions
+{
+	bool visible = true;  // not IsWindowVisible
+	bool size = true;     // no width or no height
+	bool styles = true;   // a child window, a tool or no-activate one unless WS_EX_APPWINDOW
+	bool owner = true;    // owned by another window, unless WS_EX_APPWINDOW
+	bool cloaked = true;  // cloaked by its app; the shell's cloak of another desktop's windows is kept
+
+	// Exact, case sensitive window class names
+	std::vector<std::wstring> classes = {
+		L"Progman",
+		L"WorkerW",
+		L"Shell_TrayWnd",
+		L"Shell_SecondaryTrayWnd",
+		L"Windows.UI.Core.CoreWindow",
+	};
+};
+
+// Narrows what EnumWindows gives down to the windows the switcher could show,
+// so the invisible, tool, owned and cloaked ones, which far outnumber them,
+// never cost a call into explorer. The checks run in the order of Stage, a
+// window stops at the first that rules it out and is counted there.
+class WindowFilter
+{
+public:
+	enum class Stage
+	{
+		Shell,    // GetWindowBasics failed, the window is gone
+		Visible,
+		Size,
+		Styles,
+		Owner,
+		Cloaked,
+		Class,
+		Count
+	};
+
+	struct Stats
+	{
+		size_t checked = 0;
+		size_t passed = 0;
+		size_t rejected[(size_t)Stage::Count] = {};
+	};
+
+	explicit WindowFilter(const WindowFilterOptions& opts = WindowFilterOptions());
+
+	WindowFilter(const WindowFilter&) = delete;
+	WindowFilter& operator=(const WindowFilter&) = delete;
+
+	void SetOptions(const WindowFilterOptions& opts);
+
+	bool Passes(IShellBackend* shell, HWND hWin);
+
+	// Leaves the windows that pass, in order. Puts how many each stage took
+	// out in the trace.
+	void Apply(IShellBackend* shell, std::vector<HWND>& wins);
+
+	const Stats& GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats = Stats(); }
+
+	static const char* StageName(Stage stage);
+
+private:
+	Stage Check(IShellBackend* shell, HWND hWin);
+
+	WindowFilterOptions m_Opts;
+	std::unordered_set<std::wstring> m_Classes;
+	WindowBasics m_Basics;  // reused, keeps the class name's buffer
+	Stats m_Stats;
+};
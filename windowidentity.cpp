@@ -0,0 +1,263 @@
+#include "windowidentity.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cwctype>
+
+namespace {
+	// Fewer shared title words than this and it is a different window
+	constexpr double MinTitleScore = 0.5;
+
+	// Windows looked at per miss, so a thousand terminals with the same words
+	// in their titles can't make matching quadratic
+	constexpr size_t MaxExamined = 256;
+
+	std::uint64_t Hash(std::wstring_view text, std::uint64_t hash = 0xcbf29ce484222325ull)
+	{
+		for (wchar_t c : text)
+			hash = (hash ^ (std::uint64_t)c) * 0x100000001b3ull;
+		// keeps "ab","c" apart from "a","bc"
+		return (hash ^ 0xff) * 0x100000001b3ull;
+	}
+
+	std::uint64_t AppKey(const WindowIdentity& id)
+	{
+		return Hash(id.className, Hash(id.image, Hash(id.appId)));
+	}
+
+	std::uint64_t ExactKey(const WindowIdentity& id)
+	{
+		return Hash(id.title, AppKey(id));
+	}
+
+	bool SameApp(const WindowIdentity& a, const WindowIdentity& b)
+	{
+		return a.appId == b.appId && a.image == b.image && a.className == b.className;
+	}
+
+	std::uint64_t WordKey(std::uint64_t app, std::uint64_t word)
+	{
+		return (app ^ word) * 0x9E3779B97F4A7C15ull;
+	}
+
+	// An empty title is one word of its own, so empty titles still find each other
+	void Words(std::wstring_view title, std::vector<std::uint64_t>& words)
+	{
+		words.clear();
+
+		size_t start = 0;
+		for (size_t i = 0; i <= title.size(); i++)
+		{
+			if (i < title.size() && std::iswalnum(title[i]))
+				continue;
+			if (i > start)
+				words.push_back(Hash(title.substr(start, i - start)));
+			start = i + 1;
+		}
+
+		if (words.empty())
+			words.push_back(Hash(L""));
+
+		std::sort(words.begin(), words.end());
+		words.erase(std::unique(words.begin(), words.end()), words.end());
+	}
+}
+
+std::wstring NormalizeTitle(std::wstring_view title)
+{
+	std::wstring out;
+	out.reserve(title.size());
+
+	bool space = true;  // drops leading spaces
+	for (wchar_t c : title)
+	{
+		// unsaved-changes markers editors put in front or behind
+		if (c == L'*' || c == L'\u25CF')
+			continue;
+
+		if (std::iswspace(c))
+		{
+			if (!space)
+				out += L' ';
+			space = true;
+			continue;
+		}
+		space = false;
+
+		out += (wchar_t)std::towlower(c);
+	}
+
+	if (!out.empty() && out.back() == L' ')
+		out.pop_back();
+
+	return out;
+}
+
+WindowIdentity MakeWindowIdentity(const WindowTraits& traits)
+{
+	WindowIdentity id;
+	id.appId = traits.appId;
+	id.className = traits.className;
+	id.title = NormalizeTitle(traits.title);
+
+	// the same app runs from a new directory after every update
+	auto slash = traits.image.find_last_of(L"\\/");
+	id.image = traits.image.substr(slash == std::wstring::npos ? 0 : slash + 1);
+	for (auto& c : id.image)
+		c = (wchar_t)std::towlower(c);
+
+	return id;
+}
+
+void WindowIdentityIndex::Clear()
+{
+	m_Windows.clear();
+	m_Exact.clear();
+	m_Words.clear();
+}
+
+void WindowIdentityIndex::Add(HWND hWin, WindowIdentity identity)
+{
+	auto idx = (std::uint32_t)m_Windows.size();
+
+	m_Exact[ExactKey(identity)].windows.push_back(idx);
+
+	Window win{ hWin, std::move(identity), {}, false };
+	Words(win.identity.title, win.words);
+
+	auto app = AppKey(win.identity);
+	for (auto word : win.words)
+		m_Words[WordKey(app, word)].push_back(idx);
+
+	m_Windows.push_back(std::move(win));
+}
+
+double WindowIdentityIndex::Score(const std::vector<std::uint64_t>& a, const std::vector<std::uint64_t>& b)
+{
+	size_t shared = 0;
+	for (size_t i = 0, j = 0; i < a.size() && j < b.size();)
+	{
+		if (a[i] == b[j])
+		{
+			++shared;
+			++i;
+			++j;
+		}
+		else if (a[i] < b[j])
+			++i;
+		else
+			++j;
+	}
+
+	return (double)shared / (double)(a.size() + b.size() - shared);
+}
+
+double WindowIdentityIndex::TitleScore(std::wstring_view a, std::wstring_view b)
+{
+	std::vector<std::uint64_t> wa, wb;
+	Words(a, wa);
+	Words(b, wb);
+	return Score(wa, wb);
+}
+
+void WindowIdentityIndex::Match(const std::vector<WindowIdentity>& wanted, std::vector<HWND>& found)
+{
+	TRACE_SCOPE("WindowIdentityIndex::Match");
+
+	found.assign(wanted.size(), nullptr);
+
+	// everything exact first, so scoring never takes a window an exact match
+	// further down wanted
+	for (size_t i = 0; i < wanted.size(); i++)
+	{
+		auto it = m_Exact.find(ExactKey(wanted[i]));
+		if (it == m_Exact.end())
+			continue;
+
+		auto& bucket = (*it).second;
+		for (size_t k = bucket.next; k < bucket.windows.size(); k++)
+		{
+			auto& win = m_Windows[bucket.windows[k]];
+			if (win.taken || !(win.identity == wanted[i]))
+				continue;
+
+			win.taken = true;
+			found[i] = win.hwnd;
+			if (k == bucket.next)
+				++bucket.next;
+			break;
+		}
+	}
+
+	std::vector<std::uint64_t> words;
+	std::vector<std::vector<std::uint32_t>*> postings;
+	std::vector<std::uint32_t> seen(m_Windows.size(), 0);
+	for (size_t i = 0; i < wanted.size(); i++)
+	{
+		if (found[i])
+			continue;
+
+		auto app = AppKey(wanted[i]);
+		Words(wanted[i].title, words);
+
+		postings.clear();
+		for (auto word : words)
+		{
+			auto it = m_Words.find(WordKey(app, word));
+			if (it != m_Words.end())
+				postings.push_back(&(*it).second);
+		}
+
+		// a rare word is as good as the title, a common one says little
+		std::sort(postings.begin(), postings.end(), [](auto a, auto b) { return a->size() < b->size(); });
+
+		Window* best = nullptr;
+		double bestScore = MinTitleScore;
+		size_t examined = 0;
+		for (size_t p = 0; p < postings.size(); p++)
+		{
+			// a window first met now shares at most the words left, its score
+			// can't beat one that is already better than their share
+			if (best && bestScore * (double)words.size() >= (double)(postings.size() - p))
+				break;
+
+			auto posting = postings[p];
+			for (size_t k = 0; k < posting->size();)
+			{
+				auto idx = (*posting)[k];
+				auto& win = m_Windows[idx];
+
+				// taken for good, out of the posting so it uses up no budget
+				// now or for a later miss
+				if (win.taken)
+				{
+					(*posting)[k] = posting->back();
+					posting->pop_back();
+					continue;
+				}
+				k++;
+
+				if (++examined > MaxExamined)
+					break;
+				if (seen[idx] == i + 1 || !SameApp(win.identity, wanted[i]))
+					continue;
+				seen[idx] = (std::uint32_t)(i + 1);
+
+				double score = Score(win.words, words);
+				if (score > bestScore || (score == bestScore && !best))
+				{
+					best = &win;
+					bestScore = score;
+				}
+			}
+			if (examined > MaxExamined)
+				break;
+		}
+
+		if (best)
+		{
+			best->taken = true;
+			found[i] = best->hwnd;
+		}
+	}
+}
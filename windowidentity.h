@@ -0,0 +1,70 @@
+#pragma once
+
+#include "shellbackend.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A window as it is saved with its group, in the form two runs of the same
+// application agree on: the image without its directory, lowercased, and the
+// title lowercased without the markers editors add for unsaved changes.
+// Counters in titles ("(3) Inbox") are left to the title score.
+struct WindowIdentity
+{
+	std::wstring appId;
+	std::wstring image;
+	std::wstring className;
+	std::wstring title;
+
+	bool operator==(const WindowIdentity&) const = default;
+};
+
+WindowIdentity MakeWindowIdentity(const WindowTraits& traits);
+
+// Lowercased, modified markers and extra spaces gone
+std::wstring NormalizeTitle(std::wstring_view title);
+
+// Live windows by identity, for finding which of them the saved members are
+// now. Exact identities are hashed. When nothing matches exactly, titles are
+// scored against windows of the same app (appId, image and class) that share
+// a title word with it, rarest word first, so matching is linear in the
+// windows plus a bounded scan per miss.
+class WindowIdentityIndex
+{
+public:
+	void Clear();
+	void Add(HWND hWin, WindowIdentity identity);
+	size_t Size() const { return m_Windows.size(); }
+
+	// The live window each wanted identity most likely is, null where nothing
+	// is close enough. No window is handed out twice: every exact match is
+	// made before any title is scored.
+	void Match(const std::vector<WindowIdentity>& wanted, std::vector<HWND>& found);
+
+	// Title similarity 0..1, shared words over all words
+	static double TitleScore(std::wstring_view a, std::wstring_view b);
+
+private:
+	struct Window
+	{
+		HWND hwnd;
+		WindowIdentity identity;
+		std::vector<std::uint64_t> words;  // hashed title words, sorted
+		bool taken;
+	};
+
+	struct Bucket
+	{
+		std::vector<std::uint32_t> windows;
+		size_t next = 0;                   // exact buckets are taken front to back
+	};
+
+	static double Score(const std::vector<std::uint64_t>& a, const std::vector<std::uint64_t>& b);
+
+	std::vector<Window> m_Windows;
+	std::unordered_map<std::uint64_t, Bucket> m_Exact;
+	std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> m_Words;  // app and title word, taken ones dropped as found
+};
@@ -0,0 +1,268 @@
+#include "windowrules.h"
+
+#include <algorithm>
+
+namespace {
+	wchar_t Fold(wchar_t c)
+	{
+		return c >= L'A' && c <= L'Z' ? wchar_t(c - L'A' + L'a') : c;
+	}
+
+	std::wstring_view Trim(std::wstring_view text)
+	{
+		size_t first = text.find_first_not_of(L" \t\r");
+		if (first == std::wstring_view::npos)
+			return {};
+		size_t last = text.find_last_not_of(L" \t\r");
+		return text.substr(first, last - first + 1);
+	}
+
+	bool FieldOf(std::wstring_view name, WindowRule::Field& field)
+	{
+		static const std::pair<std::wstring_view, WindowRule::Field> names[] = {
+			{ L"image", WindowRule::Field::Image },
+			{ L"class", WindowRule::Field::Class },
+			{ L"appid", WindowRule::Field::AppId },
+			{ L"title", WindowRule::Field::Title },
+		};
+		for (const auto& entry : names)
+		{
+			if (entry.first == name)
+			{
+				field = entry.second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// The pattern without its anchors, empty when nothing is left
+	std::wstring_view Unanchored(std::wstring_view pattern, bool& start, bool& end)
+	{
+		start = !pattern.empty() && pattern.front() == L'^';
+		if (start)
+			pattern.remove_prefix(1);
+		end = !pattern.empty() && pattern.back() == L'$';
+		if (end)
+			pattern.remove_suffix(1);
+		return pattern;
+	}
+}
+
+bool ParseWindowRules(std::wstring_view text, std::vector<WindowRule>& rules, size_t* badLine)
+{
+	size_t number = 0;
+	while (!text.empty())
+	{
+		size_t eol = text.find(L'\n');
+		std::wstring_view line = Trim(text.substr(0, eol));
+		text.remove_prefix(eol == std::wstring_view::npos ? text.size() : eol + 1);
+		++number;
+
+		if (line.empty() || line.front() == L'#')
+			continue;
+
+		WindowRule rule;
+		size_t space = line.find_first_of(L" \t");
+		size_t arrow = line.rfind(L"->");
+		bool start, end;
+		if (space == std::wstring_view::npos || arrow == std::wstring_view::npos || arrow < space
+			|| !FieldOf(line.substr(0, space), rule.field))
+		{
+			if (badLine)
+				*badLine = number;
+			return false;
+		}
+
+		std::wstring_view pattern = Trim(line.substr(space, arrow - space));
+		std::wstring_view group = Trim(line.substr(arrow + 2));
+		if (Unanchored(pattern, start, end).empty() || group.empty())
+		{
+			if (badLine)
+				*badLine = number;
+			return false;
+		}
+
+		rule.pattern = pattern;
+		rule.group = group;
+		rules.push_back(std::move(rule));
+	}
+	return true;
+}
+
+void WindowRules::Compile(std::span<const WindowRule> rules)
+{
+	Clear();
+	m_Rules.assign(rules.begin(), rules.end());
+
+	for (size_t i = 0; i < m_Rules.size(); i++)
+		m_Fields[(size_t)m_Rules[i].field].Add(m_Rules[i].pattern, (std::uint32_t)i);
+	for (auto& matcher : m_Fields)
+		matcher.Build();
+}
+
+void WindowRules::Clear()
+{
+	m_Rules.clear();
+	for (auto& matcher : m_Fields)
+		matcher.Clear();
+}
+
+size_t WindowRules::Match(const WindowTraits& traits) const
+{
+	using Field = WindowRule::Field;
+
+	size_t best = None;
+	m_Fields[(size_t)Field::Image].Match(traits.image, best);
+	m_Fields[(size_t)Field::Class].Match(traits.className, best);
+	m_Fields[(size_t)Field::AppId].Match(traits.appId, best);
+	m_Fields[(size_t)Field::Title].Match(traits.title, best);
+	return best;
+}
+
+std::uint32_t WindowRules::Matcher::ClassOf(wchar_t c) const
+{
+	c = Fold(c);
+	if ((std::uint32_t)c < m_Ascii.size())
+		return m_Ascii[c];
+
+	auto it = m_Wide.find(c);
+	return it == m_Wide.end() ? 0 : (*it).second;
+}
+
+std::uint32_t WindowRules::Matcher::MakeClass(wchar_t c)
+{
+	if (std::uint32_t known = ClassOf(c))
+		return known;
+
+	c = Fold(c);
+	if ((std::uint32_t)c < m_Ascii.size())
+		m_Ascii[c] = m_Classes;
+	else
+		m_Wide.emplace(c, m_Classes);
+	return m_Classes++;
+}
+
+void WindowRules::Matcher::Add(std::wstring_view pattern, std::uint32_t rule)
+{
+	bool start, end;
+	pattern = Unanchored(pattern, start, end);
+	if (pattern.empty())
+		return;
+
+	if (m_Trie.empty())
+	{
+		m_Trie.emplace_back();
+		m_Ends.emplace_back();
+	}
+
+	std::uint32_t state = 0;
+	for (wchar_t c : pattern)
+	{
+		std::uint32_t cls = MakeClass(c);
+		auto it = m_Trie[state].find(cls);
+		if (it != m_Trie[state].end())
+		{
+			state = (*it).second;
+			continue;
+		}
+
+		std::uint32_t child = (std::uint32_t)m_Trie.size();
+		m_Trie[state].emplace(cls, child);
+		m_Trie.emplace_back();
+		m_Ends.emplace_back();
+		state = child;
+	}
+
+	m_Ends[state].push_back(Output{ rule, (std::uint32_t)pattern.size(), start, end });
+}
+
+void WindowRules::Matcher::Build()
+{
+	if (m_Trie.empty())
+		return;
+
+	const std::uint32_t width = m_Classes;
+	const size_t states = m_Trie.size();
+
+	m_Next.assign(states * width, 0);
+	std::vector<std::uint32_t> fail(states, 0);
+	std::vector<std::vector<Output>> outs(states);
+
+	// breadth first, a state's failure is always shallower and done before it
+	std::vector<std::uint32_t> order;
+	order.reserve(states);
+	order.push_back(0);
+	outs[0] = m_Ends[0];
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		std::uint32_t state = order[i];
+		for (std::uint32_t cls = 0; cls < width; cls++)
+		{
+			auto it = m_Trie[state].find(cls);
+			if (it == m_Trie[state].end())
+			{
+				m_Next[state * width + cls] = state ? m_Next[fail[state] * width + cls] : 0;
+				continue;
+			}
+
+			std::uint32_t child = (*it).second;
+			fail[child] = state ? m_Next[fail[state] * width + cls] : 0;
+			m_Next[state * width + cls] = child;
+
+			// what ends here and every shorter suffix of it that is a pattern
+			outs[child] = m_Ends[child];
+			outs[child].insert(outs[child].end(), outs[fail[child]].begin(), outs[fail[child]].end());
+			order.push_back(child);
+		}
+	}
+
+	m_OutFirst.assign(states + 1, 0);
+	for (size_t state = 0; state < states; state++)
+	{
+		auto& out = outs[state];
+		std::sort(out.begin(), out.end(), [](const Output& a, const Output& b) { return a.rule < b.rule; });
+		m_OutFirst[state] = (std::uint32_t)m_Out.size();
+		m_Out.insert(m_Out.end(), out.begin(), out.end());
+	}
+	m_OutFirst[states] = (std::uint32_t)m_Out.size();
+
+	m_Trie.clear();
+	m_Ends.clear();
+}
+
+void WindowRules::Matcher::Clear()
+{
+	m_Trie.clear();
+	m_Ends.clear();
+	m_Ascii.fill(0);
+	m_Wide.clear();
+	m_Classes = 1;
+	m_Next.clear();
+	m_OutFirst.clear();
+	m_Out.clear();
+}
+
+void WindowRules::Matcher::Match(std::wstring_view text, size_t& best) const
+{
+	if (m_Next.empty())
+		return;
+
+	const std::uint32_t width = m_Classes;
+	std::uint32_t state = 0;
+	for (size_t i = 0; i < text.size() && best != 0; i++)
+	{
+		state = m_Next[state * width + ClassOf(text[i])];
+		for (std::uint32_t o = m_OutFirst[state]; o < m_OutFirst[state + 1]; o++)
+		{
+			const Output& out = m_Out[o];
+			if (out.rule >= best)
+				break;
+			if ((out.start && i + 1 != out.length) || (out.end && i + 1 != text.size()))
+				continue;
+			best = out.rule;
+			break;
+		}
+	}
+}
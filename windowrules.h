@@ -0,0 +1,98 @@
+#pragma once
+
+#include "shellbackend.h"
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Sends the windows whose traits match it to a named group. The pattern is
+// found anywhere in the field, ^ in front ties it to the start and $ at the
+// end to the end. ASCII letters match either case.
+struct WindowRule
+{
+	enum class Field
+	{
+		Image,  // full path of the process image
+		Class,
+		AppId,
+		Title,
+		Count
+	};
+
+	Field field = Field::Image;
+	std::wstring pattern;
+	std::wstring group;
+};
+
+// One rule a line, "field pattern -> group", the field one of image, class,
+// appid and title. Blank lines and ones starting with # are skipped. false
+// for the first line that isn't a rule, its number in badLine, and rules
+// keeps what was read before it.
+bool ParseWindowRules(std::wstring_view text, std::vector<WindowRule>& rules, size_t* badLine = nullptr);
+
+// The patterns of every rule compiled into one automaton a field, so a window
+// is classified in one pass over each of its traits however many rules there
+// are. The first rule that matches wins.
+class WindowRules
+{
+public:
+	static constexpr size_t None = ~size_t(0);
+
+	void Compile(std::span<const WindowRule> rules);
+	void Clear();
+
+	// The first rule matching the window, None when none does
+	size_t Match(const WindowTraits& traits) const;
+
+	bool Empty() const { return m_Rules.empty(); }
+	size_t Size() const { return m_Rules.size(); }
+	const WindowRule& Rule(size_t idx) const { return m_Rules[idx]; }
+
+private:
+	// Aho-Corasick over the characters the patterns use, with the failure
+	// links folded into a full transition table: one lookup a character, no
+	// backtracking. Every other character is class 0.
+	class Matcher
+	{
+	public:
+		void Add(std::wstring_view pattern, std::uint32_t rule);
+		void Build();
+		void Clear();
+		bool Empty() const { return m_Next.empty(); }
+
+		// Lowers best to the first rule whose pattern is in text
+		void Match(std::wstring_view text, size_t& best) const;
+
+	private:
+		struct Output
+		{
+			std::uint32_t rule;
+			std::uint32_t length;
+			bool start;  // ^
+			bool end;    // $
+		};
+
+		std::uint32_t ClassOf(wchar_t c) const;
+		std::uint32_t MakeClass(wchar_t c);
+
+		// built up by Add, turned into the table by Build
+		std::vector<std::unordered_map<std::uint32_t, std::uint32_t>> m_Trie;
+		std::vector<std::vector<Output>> m_Ends;
+
+		std::array<std::uint32_t, 128> m_Ascii{};
+		std::unordered_map<wchar_t, std::uint32_t> m_Wide;
+		std::uint32_t m_Classes = 1;
+
+		std::vector<std::uint32_t> m_Next;      // state * m_Classes + class
+		std::vector<std::uint32_t> m_OutFirst;  // a state's outputs, by rule, suffixes' included
+		std::vector<Output> m_Out;
+	};
+
+	std::vector<WindowRule> m_Rules;
+	Matcher m_Fields[(size_t)WindowRule::Field::Count];
+};
@@ -0,0 +1,105 @@
+#include "worker.h"
+
+#include <future>
+
+CommandWorker::~CommandWorker()
+{
+	Stop();
+}
+
+bool CommandWorker::Start(std::function<bool()>&& enter, std::function<void()>&& leave, IWorkerWait* wait)
+{
+	if (Running())
+		return false;
+
+	m_Wait = wait;
+	m_Leave = std::move(leave);
+	m_Stop = false;
+
+	std::promise<bool> started;
+	auto result = started.get_future();
+
+	m_Thread = std::thread([this, &started, enter = std::move(enter)]() {
+		bool ok = enter();
+		started.set_value(ok);
+		if (ok)
+			Loop();
+	});
+
+	if (!result.get())
+	{
+		m_Thread.join();
+		return false;
+	}
+
+	return true;
+}
+
+void CommandWorker::Stop()
+{
+	if (!Running())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stop = true;
+	}
+
+	if (m_Wait)
+		m_Wait->Wake();
+	else
+		m_Signal.notify_one();
+
+	m_Thread.join();
+}
+
+void CommandWorker::Post(Job&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Jobs.push_back(std::move(job));
+	}
+
+	if (m_Wait)
+		m_Wait->Wake();
+	else
+		m_Signal.notify_one();
+}
+
+size_t CommandWorker::Pending() const
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	return m_Jobs.size();
+}
+
+void CommandWorker::Loop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_Lock);
+
+			if (!m_Wait)
+				m_Signal.wait(lock, [this]() { return m_Stop || !m_Jobs.empty(); });
+
+			if (m_Jobs.empty())
+			{
+				if (m_Stop)
+					break;
+
+				lock.unlock();
+				m_Wait->Wait();
+				continue;
+			}
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+
+		job();
+	}
+
+	if (m_Leave)
+		m_Leave();
+}
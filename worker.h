@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// How the worker thread sleeps while its queue is empty. A COM STA has to keep
+// dispatching messages while it waits or explorer's notifications never
+// arrive; without one the worker just blocks.
+struct IWorkerWait
+{
+	virtual ~IWorkerWait() = default;
+
+	// Worker thread. Returns after Wake, or after handling something else the
+	// thread was sent. A Wake that comes before Wait must still end it.
+	virtual void Wait() = 0;
+	// Any thread
+	virtual void Wake() = 0;
+};
+
+// A thread that owns the shell and the group state. The UI thread queues
+// commands and goes straight back to its message loop; commands run one at a
+// time in the order they were posted, and anything the UI needs to hear about
+// is posted back by the command itself.
+class CommandWorker
+{
+public:
+	using Job = std::function<void()>;
+
+	CommandWorker() = default;
+	~CommandWorker();
+
+	CommandWorker(const CommandWorker&) = delete;
+	CommandWorker& operator=(const CommandWorker&) = delete;
+
+	// enter runs first on the new thread to set it up (COM, the shell), Start
+	// waits for it and returns what it returned. leave runs last, on Stop.
+	bool Start(std::function<bool()>&& enter, std::function<void()>&& leave, IWorkerWait* wait = nullptr);
+
+	// Finishes what is already queued, then leave, then joins
+	void Stop();
+
+	void Post(Job&& job);
+
+	size_t Pending() const;
+	bool Running() const { return m_Thread.joinable(); }
+
+private:
+	void Loop();
+
+	std::thread m_Thread;
+	IWorkerWait* m_Wait = nullptr;
+	std::function<void()> m_Leave;
+
+	mutable std::mutex m_Lock;
+	std::condition_variable m_Signal;
+	std::deque<Job> m_Jobs;
+	bool m_Stop = false;
+};